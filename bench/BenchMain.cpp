@@ -0,0 +1,572 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "BatchRenderer.h"
+#include "Palette.h"
+#include "ScanGenerator.h"
+#include "TreeLayout.h"
+#include "TreeModel.h"
+#include "TreeReader.h"
+#include "TreeRenderer.h"
+
+namespace {
+
+// Largest resident set of the process so far, 0 where unsupported.
+quint64 peakRssBytes() {
+#ifdef Q_OS_UNIX
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef Q_OS_MACOS
+  return static_cast<quint64>(usage.ru_maxrss);
+#else
+  return static_cast<quint64>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+double timed(const std::function<void()> &phase) {
+  QElapsedTimer timer;
+  timer.start();
+  phase();
+  return static_cast<double>(timer.nsecsElapsed()) / 1e9;
+}
+
+// Phase results with their throughput, in the order they ran.
+class Report {
+public:
+  void add(const QString &name, double seconds, quint64 items,
+           quint64 bytes = 0) {
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), name);
+    result.insert(QStringLiteral("seconds"), seconds);
+    result.insert(QStringLiteral("items"), static_cast<qint64>(items));
+    result.insert(QStringLiteral("itemsPerSecond"),
+                  seconds > 0 ? static_cast<double>(items) / seconds : 0.0);
+    if (bytes > 0) {
+      result.insert(QStringLiteral("bytes"), static_cast<qint64>(bytes));
+      result.insert(QStringLiteral("bytesPerSecond"),
+                    seconds > 0 ? static_cast<double>(bytes) / seconds : 0.0);
+    }
+    result.insert(QStringLiteral("peakRssBytes"),
+                  static_cast<qint64>(peakRssBytes()));
+    results.append(result);
+    std::cerr << qPrintable(name) << ": " << seconds << " s\n";
+  }
+
+  QJsonArray results;
+};
+
+void resetFolderSizes(TreeNode *root) {
+  std::vector<TreeNode *> pending{root};
+  while (!pending.empty()) {
+    TreeNode *node = pending.back();
+    pending.pop_back();
+    if (!node->children.isEmpty()) {
+      node->size = 0;
+    }
+    for (TreeNode *child : node->children) {
+      pending.push_back(child);
+    }
+  }
+}
+
+quint64 countNodes(const TreeNode *root) {
+  quint64 count = 0;
+  std::vector<const TreeNode *> pending{root};
+  while (!pending.empty()) {
+    const TreeNode *node = pending.back();
+    pending.pop_back();
+    ++count;
+    for (const TreeNode *child : node->children) {
+      pending.push_back(child);
+    }
+  }
+  return count;
+}
+
+// Phases shorter than this in the baseline are too noisy to gate on.
+constexpr double kMinGatedSeconds = 0.05;
+
+// Attempts per size in the scaling gate; the fastest one counts.
+constexpr int kScalingRuns = 3;
+
+// Read, size and lay out the scan at `path` as opening it in the viewer
+// does. Returns the fastest of `runs` attempts, or a negative value if the
+// scan does not load.
+double loadSeconds(const QString &path, const QRectF &bounds, int runs,
+                   QString *errorOut) {
+  double best = -1;
+  for (int run = 0; run < runs; ++run) {
+    std::shared_ptr<TreeModel> model;
+    TreeLayout::ViewState view;
+    const double seconds = timed([&]() {
+      model = TreeReader::readFromFile(path, errorOut);
+      if (model && model->root()) {
+        model->computeDerivedSizes();
+        TreeLayout::layout(model->root(), bounds, view);
+      }
+    });
+    if (!model || !model->root()) {
+      return -1;
+    }
+    best = best < 0 ? seconds : std::min(best, seconds);
+  }
+  return best;
+}
+
+// Exit code for a gate that could not compare, reported by ctest as skipped
+// through SKIP_RETURN_CODE rather than as a pass.
+constexpr int kSkippedExitCode = 77;
+
+bool optimizedBuild() {
+#ifdef NDEBUG
+  return true;
+#else
+  return false;
+#endif
+}
+
+// What a baseline records of a run: phase times and the final peak RSS.
+// Generating the fixture is not the viewer's work, so it is left out.
+QJsonObject baselineEntry(const QJsonObject &output) {
+  QJsonObject seconds;
+  for (const QJsonValue &value :
+       output.value(QStringLiteral("results")).toArray()) {
+    const QJsonObject result = value.toObject();
+    const QString name = result.value(QStringLiteral("name")).toString();
+    if (name != QLatin1String("generate")) {
+      seconds.insert(name, result.value(QStringLiteral("seconds")));
+    }
+  }
+  QJsonObject entry;
+  entry.insert(QStringLiteral("optimized"), optimizedBuild());
+  entry.insert(QStringLiteral("seconds"), seconds);
+  entry.insert(QStringLiteral("peakRssBytes"),
+               output.value(QStringLiteral("peakRssBytes")));
+  return entry;
+}
+
+// A missing file reads as no baselines at all.
+bool readBaselines(const QString &path, QJsonObject *baselines,
+                   QString *errorOut) {
+  QFile file(path);
+  if (!file.exists()) {
+    *baselines = QJsonObject();
+    return true;
+  }
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (errorOut) {
+      *errorOut = file.errorString();
+    }
+    return false;
+  }
+  QJsonParseError parseError{};
+  const QJsonDocument document = QJsonDocument::fromJson(file.readAll(),
+                                                         &parseError);
+  if (!document.isObject()) {
+    if (errorOut) {
+      *errorOut = parseError.error != QJsonParseError::NoError
+                      ? parseError.errorString()
+                      : QObject::tr("Expected a JSON object.");
+    }
+    return false;
+  }
+  *baselines = document.object();
+  return true;
+}
+
+bool writeBaselines(const QString &path, const QJsonObject &baselines,
+                    QString *errorOut) {
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QJsonDocument(baselines).toJson(QJsonDocument::Indented)) <
+          0 ||
+      !file.commit()) {
+    if (errorOut) {
+      *errorOut = file.errorString();
+    }
+    return false;
+  }
+  return true;
+}
+
+// Everything in current that exceeds baseline by more than the margins,
+// which are fractions (0.5 allows 50% growth).
+QStringList regressions(const QJsonObject &baseline,
+                        const QJsonObject &current, double timeMargin,
+                        double memoryMargin) {
+  QStringList found;
+  const QJsonObject baseSeconds =
+      baseline.value(QStringLiteral("seconds")).toObject();
+  const QJsonObject currentSeconds =
+      current.value(QStringLiteral("seconds")).toObject();
+  for (auto it = baseSeconds.begin(); it != baseSeconds.end(); ++it) {
+    const double limit =
+        std::max(it.value().toDouble(), kMinGatedSeconds) * (1 + timeMargin);
+    const double seconds = currentSeconds.value(it.key()).toDouble();
+    if (seconds > limit) {
+      found.append(QObject::tr("%1: %2 s, baseline %3 s, limit %4 s")
+                       .arg(it.key())
+                       .arg(seconds)
+                       .arg(it.value().toDouble())
+                       .arg(limit));
+    }
+  }
+  const double baseRss =
+      baseline.value(QStringLiteral("peakRssBytes")).toDouble();
+  const double rss = current.value(QStringLiteral("peakRssBytes")).toDouble();
+  const double rssLimit = baseRss * (1 + memoryMargin);
+  if (baseRss > 0 && rss > rssLimit) {
+    found.append(QObject::tr("peak RSS: %1 MiB, baseline %2 MiB, limit %3 MiB")
+                     .arg(rss / (1024 * 1024), 0, 'f', 1)
+                     .arg(baseRss / (1024 * 1024), 0, 'f', 1)
+                     .arg(rssLimit / (1024 * 1024), 0, 'f', 1));
+  }
+  return found;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("gpscan_viewer_bench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QObject::tr(
+      "Measure loading, layout, rendering and hit-testing of a synthetic or "
+      "given scan. Results are printed as JSON."));
+  parser.addHelpOption();
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("shape"),
+      QObject::tr("Generated scan shape: realistic, wide or deep."),
+      QObject::tr("shape"), QStringLiteral("realistic")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("nodes"), QObject::tr("Items in the generated scan."),
+      QObject::tr("n"), QStringLiteral("1000000")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("depth"), QObject::tr("Chain length of the deep shape."),
+      QObject::tr("n"), QStringLiteral("1000")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("seed"), QObject::tr("Seed of the generated scan."),
+      QObject::tr("n"), QStringLiteral("1")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("gzip"), QObject::tr("Generate a gzip-compressed scan.")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("input"),
+      QObject::tr("Benchmark this scan instead of generating one."),
+      QObject::tr("file")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("size"), QObject::tr("Layout and raster size."),
+      QObject::tr("WxH"), QStringLiteral("1920x1080")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("hits"), QObject::tr("Hit-test queries."),
+      QObject::tr("n"), QStringLiteral("100000")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("baselines"),
+      QObject::tr("Compare the run with the --fixture entry of this file and "
+                  "fail on regressions."),
+      QObject::tr("file")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("fixture"), QObject::tr("Baseline entry name."),
+      QObject::tr("name")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("time-margin"),
+      QObject::tr("Allowed wall-time growth per phase, in percent."),
+      QObject::tr("percent"), QStringLiteral("50")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("memory-margin"),
+      QObject::tr("Allowed peak RSS growth, in percent."),
+      QObject::tr("percent"), QStringLiteral("20")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("max-bytes-per-node"),
+      QObject::tr("Fail when the loaded tree takes more bytes per node."),
+      QObject::tr("bytes")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("max-scaling"),
+      QObject::tr("Fail when loading the generated scan takes more than this "
+                  "many times as long as loading one of half its size."),
+      QObject::tr("ratio")));
+  parser.addOption(QCommandLineOption(
+      QStringLiteral("update-baselines"),
+      QObject::tr("Store the run as the --fixture baseline instead of "
+                  "comparing. Also enabled by "
+                  "GPSCAN_VIEWER_UPDATE_BASELINES.")));
+  parser.process(app);
+
+  auto note = [](const QString &message) {
+    std::cerr << qPrintable(message) << "\n";
+  };
+  auto fail = [&note](const QString &message) {
+    note(message);
+    return 1;
+  };
+
+  ScanGenerator::Options generator;
+  generator.gzip = parser.isSet(QStringLiteral("gzip"));
+  if (!ScanGenerator::parseShape(parser.value(QStringLiteral("shape")),
+                                 &generator.shape)) {
+    return fail(QObject::tr("Unknown --shape: %1")
+                    .arg(parser.value(QStringLiteral("shape"))));
+  }
+  bool nodesOk = false;
+  bool depthOk = false;
+  bool seedOk = false;
+  bool hitsOk = false;
+  generator.nodes = parser.value(QStringLiteral("nodes")).toULongLong(&nodesOk);
+  generator.depth = parser.value(QStringLiteral("depth")).toInt(&depthOk);
+  generator.seed = parser.value(QStringLiteral("seed")).toULongLong(&seedOk);
+  const int hits = parser.value(QStringLiteral("hits")).toInt(&hitsOk);
+  if (!nodesOk || generator.nodes == 0 || !depthOk || generator.depth <= 0 ||
+      !seedOk || !hitsOk || hits < 0) {
+    return fail(QObject::tr("Invalid --nodes, --depth, --seed or --hits."));
+  }
+  const QString baselinesPath = parser.value(QStringLiteral("baselines"));
+  const QString fixture = parser.value(QStringLiteral("fixture"));
+  if (!baselinesPath.isEmpty() && fixture.isEmpty()) {
+    return fail(QObject::tr("--baselines needs a --fixture name."));
+  }
+  bool timeMarginOk = false;
+  bool memoryMarginOk = false;
+  const double timeMargin =
+      parser.value(QStringLiteral("time-margin")).toDouble(&timeMarginOk) / 100;
+  const double memoryMargin =
+      parser.value(QStringLiteral("memory-margin")).toDouble(&memoryMarginOk) /
+      100;
+  if (!timeMarginOk || timeMargin < 0 || !memoryMarginOk ||
+      memoryMargin < 0) {
+    return fail(QObject::tr("Invalid --time-margin or --memory-margin."));
+  }
+  // Both limits are ratios of the run with itself, so unlike the baselines
+  // they hold on any machine and build type.
+  bool maxBytesOk = true;
+  bool maxScalingOk = true;
+  const double maxBytesPerNode =
+      parser.isSet(QStringLiteral("max-bytes-per-node"))
+          ? parser.value(QStringLiteral("max-bytes-per-node"))
+                .toDouble(&maxBytesOk)
+          : 0;
+  const double maxScaling =
+      parser.isSet(QStringLiteral("max-scaling"))
+          ? parser.value(QStringLiteral("max-scaling")).toDouble(&maxScalingOk)
+          : 0;
+  if (!maxBytesOk || maxBytesPerNode < 0 || !maxScalingOk ||
+      maxScaling < 0) {
+    return fail(QObject::tr("Invalid --max-bytes-per-node or --max-scaling."));
+  }
+  if (maxScaling > 0 && (parser.isSet(QStringLiteral("input")) ||
+                         generator.nodes < 2)) {
+    return fail(QObject::tr("--max-scaling needs a generated scan of at least "
+                            "two items."));
+  }
+  QSize size;
+  if (!BatchRender::parseSize(parser.value(QStringLiteral("size")), &size)) {
+    return fail(QObject::tr("Invalid --size, expected WIDTHxHEIGHT."));
+  }
+
+  Report report;
+  QTemporaryDir dir;
+  QString path = parser.value(QStringLiteral("input"));
+  if (path.isEmpty()) {
+    if (!dir.isValid()) {
+      return fail(QObject::tr("Failed to create a temporary directory."));
+    }
+    path = dir.filePath(generator.gzip ? QStringLiteral("bench.gpscan")
+                                       : QStringLiteral("bench.xml"));
+    QString error;
+    bool written = false;
+    const double seconds = timed(
+        [&]() { written = ScanGenerator::write(path, generator, &error); });
+    if (!written) {
+      return fail(error);
+    }
+    report.add(QStringLiteral("generate"), seconds, generator.nodes,
+               static_cast<quint64>(QFileInfo(path).size()));
+  }
+
+  QString error;
+  std::shared_ptr<TreeModel> model;
+  const auto fileBytes = static_cast<quint64>(QFileInfo(path).size());
+  const double readSeconds =
+      timed([&]() { model = TreeReader::readFromFile(path, &error); });
+  if (!model || !model->root()) {
+    return fail(QStringLiteral("%1: %2").arg(path, error));
+  }
+  TreeNode *root = model->root();
+  const quint64 nodes = countNodes(root);
+  report.add(QStringLiteral("read"), readSeconds, nodes, fileBytes);
+
+  resetFolderSizes(root);
+  report.add(QStringLiteral("computeDerivedSizes"),
+             timed([&]() { model->computeDerivedSizes(); }), nodes);
+
+  const QRectF bounds(0, 0, size.width(), size.height());
+  TreeLayout::ViewState view;
+  report.add(QStringLiteral("layout"),
+             timed([&]() { TreeLayout::layout(root, bounds, view); }), nodes);
+
+  // Items are pixels here.
+  TreeRenderer renderer;
+  renderer.setPalette(palettes::paletteForName(palettes::defaultPaletteName()));
+  renderer.setModel(model);
+  QImage image;
+  report.add(QStringLiteral("raster"),
+             timed([&]() { image = renderer.render(root, size); }),
+             static_cast<quint64>(size.width()) * size.height());
+
+  // Fixed points, so runs are comparable.
+  std::mt19937_64 rng(generator.seed);
+  std::uniform_real_distribution<double> x(0.0, bounds.width());
+  std::uniform_real_distribution<double> y(0.0, bounds.height());
+  std::vector<QPointF> points;
+  points.reserve(static_cast<size_t>(hits));
+  for (int i = 0; i < hits; ++i) {
+    points.emplace_back(x(rng), y(rng));
+  }
+  quint64 found = 0;
+  const double hitSeconds = timed([&]() {
+    for (const QPointF &point : points) {
+      found += TreeLayout::nodeAt(root, point, view) ? 1 : 0;
+    }
+  });
+  report.add(QStringLiteral("hitTest"), hitSeconds,
+             static_cast<quint64>(hits));
+
+  // The scaling runs below load more scans; they are not the phases'.
+  const quint64 peakRss = peakRssBytes();
+  const TreeModel::MemoryReport memory = TreeModel::memoryReport(root);
+  const double bytesPerNode =
+      static_cast<double>(memory.totalBytes()) / static_cast<double>(nodes);
+
+  // The same shape at half the size; linear loading doubles the time.
+  QJsonObject scaling;
+  double scalingRatio = 0;
+  if (maxScaling > 0) {
+    ScanGenerator::Options half = generator;
+    half.nodes = generator.nodes / 2;
+    const QString halfPath =
+        dir.filePath(generator.gzip ? QStringLiteral("half.gpscan")
+                                    : QStringLiteral("half.xml"));
+    if (!ScanGenerator::write(halfPath, half, &error)) {
+      return fail(error);
+    }
+    const double halfSeconds =
+        loadSeconds(halfPath, bounds, kScalingRuns, &error);
+    if (halfSeconds < 0) {
+      return fail(QStringLiteral("%1: %2").arg(halfPath, error));
+    }
+    const double fullSeconds = loadSeconds(path, bounds, kScalingRuns, &error);
+    if (fullSeconds < 0) {
+      return fail(QStringLiteral("%1: %2").arg(path, error));
+    }
+    scalingRatio = fullSeconds / std::max(halfSeconds, 1e-9);
+    scaling.insert(QStringLiteral("halfNodes"),
+                   static_cast<qint64>(half.nodes));
+    scaling.insert(QStringLiteral("halfSeconds"), halfSeconds);
+    scaling.insert(QStringLiteral("seconds"), fullSeconds);
+    scaling.insert(QStringLiteral("ratio"), scalingRatio);
+  }
+
+  QJsonObject scan;
+  scan.insert(QStringLiteral("path"), parser.isSet(QStringLiteral("input"))
+                                          ? path
+                                          : QString());
+  scan.insert(QStringLiteral("shape"), parser.value(QStringLiteral("shape")));
+  scan.insert(QStringLiteral("nodes"), static_cast<qint64>(nodes));
+  scan.insert(QStringLiteral("bytes"), static_cast<qint64>(fileBytes));
+  scan.insert(QStringLiteral("gzip"), generator.gzip);
+
+  QJsonObject output;
+  output.insert(QStringLiteral("scan"), scan);
+  output.insert(QStringLiteral("size"), parser.value(QStringLiteral("size")));
+  output.insert(QStringLiteral("hitsFound"), static_cast<qint64>(found));
+  output.insert(QStringLiteral("results"), report.results);
+  output.insert(QStringLiteral("bytesPerNode"), bytesPerNode);
+  if (!scaling.isEmpty()) {
+    output.insert(QStringLiteral("scaling"), scaling);
+  }
+  output.insert(QStringLiteral("peakRssBytes"), static_cast<qint64>(peakRss));
+  std::cout << QJsonDocument(output).toJson(QJsonDocument::Indented)
+                   .constData();
+
+  QStringList failures;
+  if (maxBytesPerNode > 0 && bytesPerNode > maxBytesPerNode) {
+    failures.append(QObject::tr("memory: %1 bytes per node, limit %2")
+                        .arg(bytesPerNode, 0, 'f', 1)
+                        .arg(maxBytesPerNode));
+  }
+  if (maxScaling > 0 && scalingRatio > maxScaling) {
+    failures.append(QObject::tr("scaling: loading %1 items took %2 times as "
+                                "long as half as many, limit %3")
+                        .arg(nodes)
+                        .arg(scalingRatio, 0, 'f', 2)
+                        .arg(maxScaling));
+  }
+  const QString label =
+      fixture.isEmpty() ? parser.value(QStringLiteral("shape")) : fixture;
+  auto finish = [&note, &failures, &label]() {
+    for (const QString &regression : failures) {
+      note(QObject::tr("Regression in %1: %2").arg(label, regression));
+    }
+    return failures.isEmpty() ? 0 : 1;
+  };
+
+  if (baselinesPath.isEmpty()) {
+    return finish();
+  }
+  QJsonObject baselines;
+  if (!readBaselines(baselinesPath, &baselines, &error)) {
+    return fail(QStringLiteral("%1: %2").arg(baselinesPath, error));
+  }
+  const QJsonObject current = baselineEntry(output);
+  if (parser.isSet(QStringLiteral("update-baselines")) ||
+      qEnvironmentVariableIsSet("GPSCAN_VIEWER_UPDATE_BASELINES")) {
+    baselines.insert(fixture, current);
+    if (!writeBaselines(baselinesPath, baselines, &error)) {
+      return fail(QStringLiteral("%1: %2").arg(baselinesPath, error));
+    }
+    note(QObject::tr("Updated baseline %1.").arg(fixture));
+    return 0;
+  }
+  // Without a comparable baseline only the machine-independent limits
+  // apply; with none of those either, the gate checked nothing.
+  const bool limited = maxBytesPerNode > 0 || maxScaling > 0;
+  const QJsonObject baseline = baselines.value(fixture).toObject();
+  if (baseline.isEmpty()) {
+    note(QObject::tr("No baseline for %1, timings not compared.")
+             .arg(fixture));
+    return limited ? finish() : kSkippedExitCode;
+  }
+  // Debug timings say nothing about a release baseline and vice versa.
+  if (baseline.value(QStringLiteral("optimized")).toBool() !=
+      optimizedBuild()) {
+    note(QObject::tr("Baseline %1 was recorded with a different build type, "
+                     "timings not compared.")
+             .arg(fixture));
+    return limited ? finish() : kSkippedExitCode;
+  }
+  failures.append(regressions(baseline, current, timeMargin, memoryMargin));
+  return finish();
+}
@@ -0,0 +1,313 @@
+#include "ScanGenerator.h"
+
+#include <QFile>
+#include <QObject>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <zlib.h>
+
+namespace ScanGenerator {
+
+namespace {
+
+constexpr qsizetype kBufferSize = 1 << 20;
+
+// Buffered writer for plain or gzip output, in the manner of TreeExport.
+class Sink {
+public:
+  ~Sink() {
+    if (gzip) {
+      deflateEnd(&stream);
+    }
+  }
+
+  bool open(const QString &path, bool compress) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      return false;
+    }
+    if (compress) {
+      std::memset(&stream, 0, sizeof(stream));
+      if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      gzip = true;
+      compressed.resize(kBufferSize);
+    }
+    buffer.reserve(kBufferSize + 4096);
+    return true;
+  }
+
+  QByteArray &data() { return buffer; }
+
+  bool maybeFlush() { return buffer.size() < kBufferSize || flush(Z_NO_FLUSH); }
+
+  bool finish() {
+    if (!flush(Z_FINISH)) {
+      return false;
+    }
+    file.close();
+    return file.error() == QFileDevice::NoError;
+  }
+
+private:
+  bool flush(int mode) {
+    if (!gzip) {
+      const bool ok = buffer.isEmpty() || file.write(buffer) == buffer.size();
+      buffer.clear();
+      return ok;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(buffer.data());
+    stream.avail_in = static_cast<uInt>(buffer.size());
+    int result = Z_OK;
+    do {
+      stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+      stream.avail_out = static_cast<uInt>(compressed.size());
+      result = deflate(&stream, mode);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      const qint64 produced = compressed.size() - stream.avail_out;
+      if (produced > 0 && file.write(compressed.constData(), produced) !=
+                              produced) {
+        return false;
+      }
+    } while (stream.avail_out == 0 ||
+             (mode == Z_FINISH && result != Z_STREAM_END));
+    buffer.clear();
+    return true;
+  }
+
+  QFile file;
+  bool gzip = false;
+  z_stream stream;
+  QByteArray buffer;
+  QByteArray compressed;
+};
+
+// Planned folder: its files and the range of its subfolders in the plan.
+struct Folder {
+  quint32 files = 0;
+  quint32 firstChild = 0;
+  quint32 childCount = 0;
+  int depth = 0;
+};
+
+// Folder layout with exactly `nodes` items in total.
+std::vector<Folder> planFolders(const Options &options, std::mt19937_64 &rng) {
+  std::vector<Folder> folders(1);
+  quint64 remaining = options.nodes > 0 ? options.nodes - 1 : 0;
+
+  // Subfolders of one folder are a contiguous run of the plan.
+  auto addChildren = [&folders, &remaining](size_t parent, quint64 count) {
+    count = std::min(count, remaining);
+    Folder child;
+    child.depth = folders[parent].depth + 1;
+    folders[parent].firstChild = static_cast<quint32>(folders.size());
+    folders[parent].childCount = static_cast<quint32>(count);
+    folders.insert(folders.end(), static_cast<size_t>(count), child);
+    remaining -= count;
+  };
+  auto addFiles = [&folders, &remaining](size_t folder, quint64 count) {
+    count = std::min(count, remaining);
+    folders[folder].files += static_cast<quint32>(count);
+    remaining -= count;
+  };
+
+  switch (options.shape) {
+  case Shape::Wide:
+    addFiles(0, remaining);
+    break;
+  case Shape::Deep: {
+    // The root holds chains of `depth` folders with one file per level.
+    const quint64 levels = static_cast<quint64>(std::max(1, options.depth));
+    addChildren(0, (remaining + 2 * levels - 1) / (2 * levels));
+    const quint32 chains = folders[0].childCount;
+    for (quint32 chain = 0; chain < chains; ++chain) {
+      size_t folder = 1 + chain;
+      addFiles(folder, 1);
+      for (quint64 level = 1; level < levels && remaining > 0; ++level) {
+        addChildren(folder, 1);
+        folder = folders[folder].firstChild;
+        addFiles(folder, 1);
+      }
+    }
+    addFiles(0, remaining);
+    break;
+  }
+  case Shape::Realistic: {
+    // Breadth-first, with skewed fanout and fewer subfolders deeper down.
+    std::geometric_distribution<quint32> fileCount(1.0 / 12.0);
+    std::uniform_int_distribution<int> folderCount(0, 6);
+    for (size_t next = 0; next < folders.size() && remaining > 0; ++next) {
+      addFiles(next, fileCount(rng));
+      int subfolders = std::max(0, folderCount(rng) - folders[next].depth / 3);
+      // Never let the tree close before the budget is used up.
+      if (next + 1 == folders.size() && subfolders == 0) {
+        subfolders = 1;
+      }
+      addChildren(next, static_cast<quint64>(subfolders));
+    }
+    addFiles(0, remaining);
+    break;
+  }
+  }
+  return folders;
+}
+
+const char *const kFolderWords[] = {
+    "src",   "docs",         "build", "cache", "Photos", "Music",
+    "R&D",   "node_modules", "lib",   "tmp",   "Backups", "Projects",
+    "share", "Library",      "data",  "logs",
+};
+
+struct Extension {
+  const char *name;
+  int weight;
+};
+
+// Roughly the mix of a developer's home directory.
+const Extension kExtensions[] = {
+    {"", 6},    {"txt", 6},  {"log", 5},  {"jpg", 8},  {"png", 7},
+    {"h", 9},   {"cpp", 8},  {"js", 10},  {"json", 6}, {"o", 5},
+    {"so", 2},  {"mp4", 1},  {"mp3", 2},  {"pdf", 3},  {"zip", 1},
+    {"iso", 1}, {"gz", 2},   {"py", 5},   {"html", 3}, {"svg", 2},
+};
+
+void appendEscaped(QByteArray &out, const QByteArray &text) {
+  for (char c : text) {
+    switch (c) {
+    case '&':
+      out += "&amp;";
+      break;
+    case '<':
+      out += "&lt;";
+      break;
+    case '>':
+      out += "&gt;";
+      break;
+    case '"':
+      out += "&quot;";
+      break;
+    default:
+      out += c;
+    }
+  }
+}
+
+} // namespace
+
+bool parseShape(const QString &name, Shape *shapeOut) {
+  const QString key = name.trimmed().toLower();
+  Shape shape;
+  if (key == QLatin1String("realistic")) {
+    shape = Shape::Realistic;
+  } else if (key == QLatin1String("wide")) {
+    shape = Shape::Wide;
+  } else if (key == QLatin1String("deep")) {
+    shape = Shape::Deep;
+  } else {
+    return false;
+  }
+  if (shapeOut) {
+    *shapeOut = shape;
+  }
+  return true;
+}
+
+bool write(const QString &path, const Options &options, QString *errorOut) {
+  std::mt19937_64 rng(options.seed);
+  const std::vector<Folder> folders = planFolders(options, rng);
+
+  std::vector<int> extensionWeights;
+  for (const Extension &extension : kExtensions) {
+    extensionWeights.push_back(extension.weight);
+  }
+  std::discrete_distribution<size_t> pickExtension(extensionWeights.begin(),
+                                                   extensionWeights.end());
+  std::uniform_int_distribution<size_t> pickWord(
+      0, std::size(kFolderWords) - 1);
+  // Median around 16 KB with a long tail of large files.
+  std::lognormal_distribution<double> fileSize(9.7, 2.2);
+
+  Sink sink;
+  if (!sink.open(path, options.gzip)) {
+    if (errorOut) {
+      *errorOut = QObject::tr("Failed to open %1 for writing.").arg(path);
+    }
+    return false;
+  }
+
+  QByteArray &out = sink.data();
+  out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         "<GrandPerspectiveScanDump appVersion=\"3.6.2\" formatVersion=\"7\">"
+         "\n<ScanInfo volumePath=\"/bench\" volumeSize=\"0\" freeSpace=\"0\" "
+         "scanTime=\"2026-01-01 00:00:00 +0000\" "
+         "fileSizeMeasure=\"logical\">\n";
+
+  // Depth-first over the plan; a negative entry closes a folder.
+  quint64 serial = 0;
+  std::vector<qint64> pending{0};
+  bool ok = true;
+  while (!pending.empty() && ok) {
+    const qint64 top = pending.back();
+    pending.pop_back();
+    if (top < 0) {
+      out += "</Folder>\n";
+      ok = sink.maybeFlush();
+      continue;
+    }
+
+    const Folder &folder = folders[static_cast<size_t>(top)];
+    out += "<Folder name=\"";
+    if (top == 0) {
+      out += '/';
+    } else {
+      appendEscaped(out, kFolderWords[pickWord(rng)]);
+      out += ' ';
+      out += QByteArray::number(++serial);
+    }
+    out += "\">\n";
+
+    for (quint32 i = 0; i < folder.files; ++i) {
+      const Extension &extension = kExtensions[pickExtension(rng)];
+      out += "<File name=\"file";
+      out += QByteArray::number(++serial);
+      if (extension.name[0] != '\0') {
+        out += '.';
+        out += extension.name;
+      }
+      out += "\" size=\"";
+      out += QByteArray::number(
+          static_cast<quint64>(std::min(fileSize(rng), 1e12)));
+      out += "\" />\n";
+      if (!sink.maybeFlush()) {
+        ok = false;
+        break;
+      }
+    }
+
+    pending.push_back(-1);
+    for (quint32 i = folder.childCount; i-- > 0;) {
+      pending.push_back(static_cast<qint64>(folder.firstChild + i));
+    }
+  }
+
+  out += "</ScanInfo>\n</GrandPerspectiveScanDump>\n";
+  if (!ok || !sink.finish()) {
+    if (errorOut) {
+      *errorOut = QObject::tr("Failed to write %1.").arg(path);
+    }
+    return false;
+  }
+  return true;
+}
+
+} // namespace ScanGenerator
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QString>
+
+// Synthetic GrandPerspective scan dumps for benchmarks. Output is
+// deterministic for a given set of options.
+namespace ScanGenerator {
+
+enum class Shape {
+  Realistic, // Nested folders with mixed fanout, names and sizes
+  Wide,      // Every item directly in the root folder
+  Deep,      // Chains of nested folders, one file per level
+};
+
+struct Options {
+  Shape shape = Shape::Realistic;
+  quint64 nodes = 1000000; // Folders and files, including the root
+  int depth = 1000;        // Chain length of Shape::Deep
+  quint64 seed = 1;
+  bool gzip = false;
+};
+
+// "realistic", "wide" or "deep".
+bool parseShape(const QString &name, Shape *shapeOut);
+
+// Write a scan with `options.nodes` items to `path`, gzip-compressed when
+// `options.gzip` is set. Returns false and sets `errorOut` on I/O errors.
+bool write(const QString &path, const Options &options, QString *errorOut);
+
+} // namespace ScanGenerator
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Re-record bench/baselines.json by running the perf tests of a release build.
+# Usage: bench/update-baselines.sh [build-dir]
+set -e
+
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+build_dir=${1:-"$source_dir/build-perf"}
+
+cmake -S "$source_dir" -B "$build_dir" -DCMAKE_BUILD_TYPE=Release \
+  -DGPSCAN_VIEWER_PERF_TESTS=ON
+cmake --build "$build_dir" --target gpscan_viewer_bench
+GPSCAN_VIEWER_UPDATE_BASELINES=1 ctest --test-dir "$build_dir" -L perf \
+  --output-on-failure
@@ -0,0 +1,155 @@
+#include "AllocStats.h"
+
+#include <QMutex>
+#include <QObject>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "Utils.h"
+
+namespace {
+
+// Plain thread-locals need no allocation of their own, so the allocator
+// hooks below may touch them at any time.
+thread_local quint64 threadAllocations = 0;
+thread_local quint64 threadBytes = 0;
+
+struct PhaseTable {
+  QMutex mutex;
+  QVector<AllocStats::PhaseTotal> phases;
+};
+
+PhaseTable &phaseTable() {
+  static PhaseTable table;
+  return table;
+}
+
+#ifdef GPSCAN_VIEWER_ALLOC_STATS
+inline void count(std::size_t size) {
+  ++threadAllocations;
+  threadBytes += size;
+}
+#endif
+
+} // namespace
+
+#ifdef GPSCAN_VIEWER_ALLOC_STATS
+#ifdef __GLIBC__
+// Qt containers allocate with malloc() rather than operator new, so on glibc
+// the malloc family itself is interposed and forwarded to glibc.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size) noexcept {
+  count(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(std::size_t items, std::size_t size) noexcept {
+  count(items * size);
+  return __libc_calloc(items, size);
+}
+
+void *realloc(void *pointer, std::size_t size) noexcept {
+  count(size);
+  return __libc_realloc(pointer, size);
+}
+}
+#else
+// Elsewhere only C++ allocations are seen.
+void *operator new(std::size_t size) {
+  count(size);
+  if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  count(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  std::free(pointer);
+}
+#endif
+#endif
+
+namespace AllocStats {
+
+Counts threadCounts() {
+  Counts counts;
+  counts.allocations = threadAllocations;
+  counts.bytes = threadBytes;
+  return counts;
+}
+
+void detail::addPhase(const char *name, const Counts &before) {
+  // Read before locking; the bookkeeping below allocates too.
+  const Counts after = threadCounts();
+  PhaseTable &table = phaseTable();
+  QMutexLocker lock(&table.mutex);
+  PhaseTotal *total = nullptr;
+  for (PhaseTotal &phase : table.phases) {
+    if (phase.name == QLatin1String(name)) {
+      total = &phase;
+      break;
+    }
+  }
+  if (!total) {
+    table.phases.push_back(PhaseTotal{QString::fromLatin1(name), 0, {}});
+    total = &table.phases.last();
+  }
+  ++total->runs;
+  total->counts.allocations += after.allocations - before.allocations;
+  total->counts.bytes += after.bytes - before.bytes;
+}
+
+QVector<PhaseTotal> phases() {
+  PhaseTable &table = phaseTable();
+  QMutexLocker lock(&table.mutex);
+  return table.phases;
+}
+
+QString toText() {
+  if (!isEnabled()) {
+    return QObject::tr("Allocation counting is off; configure with "
+                       "-DGPSCAN_VIEWER_ALLOC_STATS=ON to enable it.\n");
+  }
+  QString text;
+  for (const PhaseTotal &phase : phases()) {
+    text += QObject::tr("  %1  %2 allocations, %3 in %4 runs\n")
+                .arg(phase.name, -8)
+                .arg(phase.counts.allocations)
+                .arg(Utils::formatSize(phase.counts.bytes))
+                .arg(phase.runs);
+  }
+  if (text.isEmpty()) {
+    text = QObject::tr("  No phases recorded yet.\n");
+  }
+  return text;
+}
+
+} // namespace AllocStats
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Heap allocations per phase (loading, layout, painting). Counting needs a
+// build configured with GPSCAN_VIEWER_ALLOC_STATS; elsewhere scopes compile
+// to nothing and no phases are reported.
+namespace AllocStats {
+
+struct Counts {
+  quint64 allocations = 0;
+  quint64 bytes = 0; // Requested; frees are not subtracted
+};
+
+struct PhaseTotal {
+  QString name;
+  quint64 runs = 0;
+  Counts counts;
+};
+
+constexpr bool isEnabled() {
+#ifdef GPSCAN_VIEWER_ALLOC_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Allocations made by the calling thread so far.
+Counts threadCounts();
+
+// Totals of every phase run so far, in the order they first ran.
+QVector<PhaseTotal> phases();
+
+// One line per phase, or a note on how to enable counting.
+QString toText();
+
+namespace detail {
+void addPhase(const char *name, const Counts &before);
+} // namespace detail
+
+// Adds the calling thread's allocations during its lifetime to the phase
+// `name`, which must be a string literal.
+class Scope {
+public:
+#ifdef GPSCAN_VIEWER_ALLOC_STATS
+  explicit Scope(const char *name) : name(name), before(threadCounts()) {}
+  ~Scope() { detail::addPhase(name, before); }
+#else
+  explicit Scope(const char *) {}
+#endif
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+#ifdef GPSCAN_VIEWER_ALLOC_STATS
+private:
+  const char *name;
+  Counts before;
+#endif
+};
+
+} // namespace AllocStats
@@ -0,0 +1,166 @@
+#include "BatchRenderer.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QSet>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+#include "NodeTable.h"
+#include "Palette.h"
+#include "TaskScheduler.h"
+#include "TreeDiff.h"
+#include "TreeReader.h"
+
+namespace BatchRender {
+
+namespace {
+
+bool resolveOutputs(const Options &options, QStringList *outputs,
+                    QString *errorOut) {
+  const bool toDirectory = options.inputs.size() > 1 ||
+                           QFileInfo(options.output).isDir() ||
+                           options.output.endsWith(QLatin1Char('/'));
+  if (!toDirectory) {
+    outputs->push_back(options.output);
+    return true;
+  }
+
+  if (!QDir().mkpath(options.output)) {
+    *errorOut =
+        QObject::tr("Failed to create directory: %1").arg(options.output);
+    return false;
+  }
+
+  const QDir dir(options.output);
+  QSet<QString> used;
+  for (const QString &input : options.inputs) {
+    const QString base = QFileInfo(input).completeBaseName();
+    QString name = base + QStringLiteral(".png");
+    for (int n = 2; used.contains(name); ++n) {
+      name = QStringLiteral("%1-%2.png").arg(base).arg(n);
+    }
+    used.insert(name);
+    outputs->push_back(dir.filePath(name));
+  }
+  return true;
+}
+
+bool renderFile(const TreeRenderer &renderer, const TreeNode *baseline,
+                const QString &input, const QString &output, const QSize &size,
+                QString *errorOut) {
+  std::shared_ptr<TreeModel> model = TreeReader::readFromFile(input, errorOut);
+  if (!model) {
+    if (errorOut->isEmpty()) {
+      *errorOut = QObject::tr("Failed to load file.");
+    }
+    return false;
+  }
+
+  // Strips go straight to disk, so even very large sizes stay within a
+  // bounded amount of memory per worker. A baseline is only passed in
+  // Change mode, the one mode that shows the diff.
+  TreeRenderer local = renderer;
+  local.setModel(model);
+  if (baseline) {
+    local.setDiff(TreeDiff::compute(NodeTable::build(model), baseline));
+  }
+  return local.renderToPng(model->root(), size, output, errorOut);
+}
+
+} // namespace
+
+bool parseSize(const QString &text, QSize *sizeOut) {
+  const QStringList parts = text.trimmed().toLower().split(QLatin1Char('x'));
+  if (parts.size() != 2) {
+    return false;
+  }
+
+  bool widthOk = false;
+  bool heightOk = false;
+  const int width = parts[0].toInt(&widthOk);
+  const int height = parts[1].toInt(&heightOk);
+  if (!widthOk || !heightOk || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  if (sizeOut) {
+    *sizeOut = QSize(width, height);
+  }
+  return true;
+}
+
+int run(const Options &options) {
+  if (options.inputs.isEmpty()) {
+    std::cerr << qPrintable(QObject::tr("No input files to render.")) << "\n";
+    return 1;
+  }
+
+  QStringList outputs;
+  QString error;
+  if (!resolveOutputs(options, &outputs, &error)) {
+    std::cerr << qPrintable(error) << "\n";
+    return 1;
+  }
+
+  // Workers only read the baseline, so it is loaded once for all inputs.
+  // Other color modes never look at a diff, so it is not loaded for them.
+  std::shared_ptr<TreeModel> baseline;
+  if (options.colorMode == TreeRenderer::ColorMappingMode::Change &&
+      !options.baseline.isEmpty()) {
+    baseline = TreeReader::readFromFile(options.baseline, &error);
+    if (!baseline) {
+      std::cerr << qPrintable(QStringLiteral("%1: %2").arg(
+                       options.baseline,
+                       error.isEmpty() ? QObject::tr("Failed to load file.")
+                                       : error))
+                << "\n";
+      return 1;
+    }
+  }
+
+  // Workers only read the renderer, so a single instance is shared.
+  TreeRenderer renderer;
+  renderer.setPalette(palettes::paletteForName(options.paletteName));
+  renderer.setColorMappingMode(options.colorMode);
+
+  // Each worker takes the next unrendered input until none are left.
+  const qsizetype workers =
+      std::min<qsizetype>(options.jobs > 0 ? options.jobs
+                                           : TaskScheduler::threadCount(),
+                          options.inputs.size());
+  std::atomic<qsizetype> next{0};
+  QMutex reportMutex;
+  int failures = 0;
+  TaskScheduler::parallelFor(static_cast<size_t>(workers), 1, [&](size_t,
+                                                                   size_t) {
+    for (qsizetype i = next++; i < options.inputs.size(); i = next++) {
+      const QString &input = options.inputs[i];
+      const QString &output = outputs[i];
+      QString fileError;
+      const bool ok =
+          renderFile(renderer, baseline ? baseline->root() : nullptr, input,
+                     output, options.size, &fileError);
+
+      QMutexLocker locker(&reportMutex);
+      if (ok) {
+        std::cout << qPrintable(QStringLiteral("%1 -> %2").arg(input, output))
+                  << "\n";
+      } else {
+        ++failures;
+        std::cerr << qPrintable(
+                         QStringLiteral("%1: %2").arg(input, fileError))
+                  << "\n";
+      }
+    }
+  });
+
+  return failures == 0 ? 0 : 1;
+}
+
+} // namespace BatchRender
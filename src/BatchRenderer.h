@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include "TreeRenderer.h"
+
+namespace BatchRender {
+
+struct Options {
+  QStringList inputs;
+  // PNG path for a single input; otherwise a directory that receives
+  // <basename>.png for every input.
+  QString output;
+  QSize size = QSize(1920, 1080);
+  TreeRenderer::ColorMappingMode colorMode =
+      TreeRenderer::ColorMappingMode::Extension;
+  QString paletteName;
+  // Earlier scan every input is compared with for the "change" color mode;
+  // ignored by the other modes.
+  QString baseline;
+  // Files rendered concurrently. Each worker holds at most one model, which
+  // bounds memory. 0, or more than TaskScheduler::threadCount(), uses the
+  // scheduler's thread count.
+  int jobs = 0;
+};
+
+// Parse a "WIDTHxHEIGHT" size such as "3840x2160".
+bool parseSize(const QString &text, QSize *sizeOut);
+
+// Load and render every input without a display. Progress goes to stdout,
+// errors to stderr. Returns a process exit code.
+int run(const Options &options);
+
+} // namespace BatchRender
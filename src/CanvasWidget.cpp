@@ -4,19 +4,25 @@
 #include <QContextMenuEvent>
 #include <QDesktopServices>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QFontDatabase>
 #include <QGuiApplication>
 #include <QImage>
 #include <QMenu>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QTimer>
 #include <QToolTip>
 #include <QUrl>
 
 #include <algorithm>
-#include <array>
 #include <cmath>
 
+#include "AllocStats.h"
+#include "NodeTable.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
 #include "TreeLayout.h"
 #include "Utils.h"
 
@@ -24,60 +30,40 @@
 
 namespace {
 
-constexpr int kGradientSteps = 256;
-
-std::array<QRgb, kGradientSteps> buildGradientColors(const QColor &base,
-                                                     double colorGradient) {
-  std::array<QRgb, kGradientSteps> colors{};
-
-  float hue = 0.0f;
-  float saturation = 0.0f;
-  float brightness = 0.0f;
-  float alpha = 1.0f;
-  QColor hsv = base.toHsv();
-  hsv.getHsvF(&hue, &saturation, &brightness, &alpha);
-  if (hue < 0.0f) {
-    hue = 0.0f;
-  }
-
-  auto clamp01 = [](double v) { return std::clamp(v, 0.0, 1.0); };
-
-  // Darker colors (0..127)
-  for (int j = 0; j < 128; ++j) {
-    double adjust = colorGradient * (128.0 - static_cast<double>(j)) / 128.0;
-    double b = clamp01(static_cast<double>(brightness) * (1.0 - adjust));
-    QColor mod = QColor::fromHsvF(hue, clamp01(saturation), b, clamp01(alpha));
-    colors[j] = mod.rgb();
-  }
-
-  // Lighter colors (128..255)
-  for (int j = 0; j < 128; ++j) {
-    double adjust = colorGradient * static_cast<double>(j) / 128.0;
-    double dif = 1.0 - static_cast<double>(brightness);
-    double absAdjust = (dif + saturation) * adjust;
-    double b = brightness;
-    double s = saturation;
-
-    if (absAdjust < dif) {
-      b = clamp01(static_cast<double>(brightness) + absAdjust);
-    } else {
-      s = clamp01(saturation + dif - absAdjust);
-      b = 1.0;
-    }
-
-    QColor mod = QColor::fromHsvF(hue, clamp01(s), clamp01(b), clamp01(alpha));
-    colors[128 + j] = mod.rgb();
-  }
-
-  return colors;
-}
+// Per-frame raster budget used by progressive rendering (about 60 fps).
+constexpr qint64 kFrameBudgetMs = 16;
 
 } // namespace
 
 CanvasWidget::CanvasWidget(QWidget *parent) : QWidget(parent) {
   setMouseTracking(true);
   currentPaletteName = palettes::defaultPaletteName();
-  palette = palettes::paletteForName(currentPaletteName);
+  renderer.setPalette(palettes::paletteForName(currentPaletteName));
+
+  refineTimer = new QTimer(this);
+  refineTimer->setSingleShot(true);
+  refineTimer->setInterval(0);
+  connect(refineTimer, &QTimer::timeout, this, &CanvasWidget::continueRender);
+
+  memoryWatcher = new QFutureWatcher<TreeModel::MemoryReport>(this);
+  connect(memoryWatcher, &QFutureWatcherBase::finished, this, [this]() {
+    modelMemory = memoryWatcher->result();
+    if (hud) {
+      update(hudRect.isNull() ? rect() : hudRect);
+    }
+  });
+}
+
+void CanvasWidget::setProgressiveRendering(bool enabled) {
+  if (progressive == enabled) {
+    return;
+  }
+  progressive = enabled;
+  if (!progressive && refineTimer->isActive()) {
+    // Finish the interrupted refinement in one go on the next paint.
+    refineTimer->stop();
+    update();
+  }
 }
 
 void CanvasWidget::setPaletteName(const QString &name) {
@@ -92,28 +78,189 @@ void CanvasWidget::setPaletteName(const QString &name) {
   }
 
   currentPaletteName = effective;
-  palette = std::move(next);
-  update();
+  renderer.setPalette(next);
+  invalidateDisplayList();
+}
+
+void CanvasWidget::setHighDpiRendering(bool enabled) {
+  if (highDpi != enabled) {
+    highDpi = enabled;
+    invalidateDisplayList();
+  }
+}
+
+void CanvasWidget::setHudVisible(bool visible) {
+  if (hud != visible) {
+    hud = visible;
+    if (hud) {
+      requestModelMemory();
+    }
+    update();
+  }
 }
 
 QString CanvasWidget::paletteName() const { return currentPaletteName; }
 
 void CanvasWidget::setColorMappingMode(ColorMappingMode mode) {
-  if (colorMappingMode != mode) {
-    colorMappingMode = mode;
-    update();
+  if (renderer.colorMappingMode() != mode) {
+    renderer.setColorMappingMode(mode);
+    invalidateDisplayList();
+  }
+}
+
+void CanvasWidget::setDiff(std::shared_ptr<const TreeDiff> diff) {
+  renderer.setDiff(std::move(diff));
+  hoveredNode = nullptr;
+  if (renderer.colorMappingMode() == ColorMappingMode::Change) {
+    invalidateDisplayList();
   }
 }
 
+void CanvasWidget::setDiskCheck(std::shared_ptr<const DiskCheck> check) {
+  diskCheck = std::move(check);
+  hoveredNode = nullptr;
+  staleMaskDirty = true;
+  update();
+}
+
 void CanvasWidget::setModel(std::shared_ptr<TreeModel> newModel) {
   model = std::move(newModel);
+  renderer.setModel(model);
+  viewState = TreeLayout::ViewState();
+  focusedNode = nullptr;
   selectedNode = nullptr;
   hoveredNode = nullptr;
+  searchHighlights.clear();
+  filterHighlights.clear();
+  modelMemory = TreeModel::MemoryReport();
+  memoryRequested = false;
+  if (hud) {
+    requestModelMemory();
+  }
+  relayout();
+}
+
+void CanvasWidget::setSelectedNode(TreeNode *node) {
+  if (node && !isInModel(node)) {
+    return;
+  }
+  if (node && !isInView(node)) {
+    setFocusNode(nullptr);
+  }
+  if (node != selectedNode) {
+    selectedNode = node;
+    emit selectedNodeChanged(selectedNode);
+    update();
+  }
+}
+
+void CanvasWidget::setSearchHighlights(const QVector<TreeNode *> &nodes) {
+  setHighlights(searchHighlights, nodes);
+}
+
+void CanvasWidget::setFilterHighlights(const QVector<TreeNode *> &nodes) {
+  setHighlights(filterHighlights, nodes);
+}
+
+void CanvasWidget::setHighlights(QVector<TreeNode *> &target,
+                                 const QVector<TreeNode *> &nodes) {
+  // Highlights always come from one model, so checking one node suffices.
+  if (!nodes.isEmpty() && !isInModel(nodes.front())) {
+    target.clear();
+  } else {
+    target = nodes;
+  }
+  highlightMaskDirty = true;
   update();
 }
 
+void CanvasWidget::setFocusNode(TreeNode *node) {
+  if (!model || !model->root()) {
+    return;
+  }
+
+  TreeNode *target = node == model->root() ? nullptr : node;
+  if (target == focusedNode || (target && !isInModel(target))) {
+    return;
+  }
+
+  focusedNode = target;
+  hoveredNode = nullptr;
+  relayout();
+  emit focusNodeChanged(focusNode());
+}
+
+TreeNode *CanvasWidget::focusNode() const {
+  if (focusedNode) {
+    return focusedNode;
+  }
+  return model ? model->root() : nullptr;
+}
+
+bool CanvasWidget::isInView(const TreeNode *node) const {
+  if (!isInModel(node)) {
+    return false;
+  }
+  const TreeNode *viewRoot = focusNode();
+  for (const TreeNode *cur = node; cur; cur = model->parentOf(cur)) {
+    if (cur == viewRoot) {
+      return true;
+    }
+    if (viewState.isHidden(cur)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool CanvasWidget::isInModel(const TreeNode *node) const {
+  return model && model->contains(node);
+}
+
+TreeNode *CanvasWidget::parentOf(const TreeNode *node) const {
+  return model ? model->parentOf(node) : nullptr;
+}
+
+QString CanvasWidget::pathOf(const TreeNode *node) const {
+  return model ? Utils::buildFullPath(*model, node) : QString();
+}
+
+void CanvasWidget::setHiddenMask(const NodeTable &table,
+                                 const std::vector<quint8> &mask) {
+  if (!model || table.model != model) {
+    return;
+  }
+  Utils::applyHiddenMask(viewState, table, mask);
+  filterChanged();
+}
+
+void CanvasWidget::clearHiddenMask() {
+  Utils::clearHidden(viewState);
+  filterChanged();
+}
+
+void CanvasWidget::filterChanged() {
+  for (const TreeNode *cur = focusedNode; cur; cur = parentOf(cur)) {
+    if (viewState.isHidden(cur)) {
+      setFocusNode(nullptr);
+      break;
+    }
+  }
+  relayout();
+}
+
+void CanvasWidget::relayout() {
+  if (TreeNode *viewRoot = focusNode()) {
+    QRectF bounds(0, 0, width(), height());
+    TreeLayout::layout(viewRoot, bounds, viewState);
+  }
+  invalidateDisplayList();
+}
+
 void CanvasWidget::paintEvent(QPaintEvent *event) {
   Q_UNUSED(event);
+  Trace::Scope trace("CanvasWidget::paintEvent");
+  AllocStats::Scope allocations("paint");
   QPainter painter(this);
   painter.fillRect(rect(), Qt::black);
 
@@ -121,13 +268,58 @@ void CanvasWidget::paintEvent(QPaintEvent *event) {
     return;
   }
 
-  // Draw pixel-by-pixel using QImage
-  QImage image(size(), QImage::Format_RGB32);
-  image.fill(Qt::black);
+  QElapsedTimer stage;
+  stage.start();
+  auto lap = [&stage]() {
+    return static_cast<double>(stage.nsecsElapsed()) / 1e6;
+  };
 
-  drawNode(image, model->root(), 0);
+  // Moving to a screen with a different pixel ratio changes the raster size.
+  if (!qFuzzyCompare(renderScale, targetRenderScale())) {
+    refineTimer->stop();
+    displayListDirty = true;
+    highlightMaskDirty = true;
+    staleMaskDirty = true;
+  }
+  // Only frames that rasterized count; overlay-only repaints would skew the
+  // raster numbers towards zero.
+  bool rasterized = refineMs > 0.0;
+  if (displayListDirty) {
+    rebuildDisplayList();
+    rasterized = true;
+  }
+  if (imageDirty) {
+    beginRender();
+    rasterized = true;
+  }
+  if (renderedItems < displayList.size() && !refineTimer->isActive()) {
+    if (!renderPendingItems(progressive ? kFrameBudgetMs : -1)) {
+      refineTimer->start();
+    }
+    rasterized = true;
+  }
+  if (rasterized) {
+    rasterStats.add(refineMs + lap());
+  }
+  refineMs = 0.0;
 
-  painter.drawImage(0, 0, image);
+  stage.restart();
+  painter.drawImage(QPointF(0, 0), cachedImage);
+  blitStats.add(lap());
+
+  stage.restart();
+  if (diskCheck) {
+    if (staleMaskDirty) {
+      rebuildStaleMask();
+    }
+    painter.drawImage(QPointF(0, 0), staleMask);
+  }
+  if (!searchHighlights.isEmpty() || !filterHighlights.isEmpty()) {
+    if (highlightMaskDirty) {
+      rebuildHighlightMask();
+    }
+    painter.drawImage(QPointF(0, 0), highlightMask);
+  }
 
   // Highlight hovered ancestors (excluding root)
   if (hoveredNode) {
@@ -138,6 +330,11 @@ void CanvasWidget::paintEvent(QPaintEvent *event) {
   if (selectedNode) {
     drawSelection(painter, selectedNode);
   }
+  overlayStats.add(lap());
+
+  if (hud) {
+    drawHud(painter);
+  }
 }
 
 void CanvasWidget::mousePressEvent(QMouseEvent *event) {
@@ -145,7 +342,7 @@ void CanvasWidget::mousePressEvent(QMouseEvent *event) {
     return;
   }
 
-  TreeNode *hit = findNode(model->root(), mapToLayout(event->position()));
+  TreeNode *hit = timedNodeAt(event->position(), true);
   if (hit != selectedNode) {
     selectedNode = hit;
     emit selectedNodeChanged(selectedNode);
@@ -155,10 +352,7 @@ void CanvasWidget::mousePressEvent(QMouseEvent *event) {
 
 void CanvasWidget::resizeEvent(QResizeEvent *event) {
   QWidget::resizeEvent(event);
-  if (model && model->root()) {
-    QRectF bounds(0, 0, width(), height());
-    TreeLayout::layout(model->root(), bounds);
-  }
+  relayout();
 }
 
 void CanvasWidget::mouseMoveEvent(QMouseEvent *event) {
@@ -179,7 +373,7 @@ void CanvasWidget::contextMenuEvent(QContextMenuEvent *event) {
     return;
   }
 
-  TreeNode *hit = findNode(model->root(), mapToLayout(event->pos()));
+  TreeNode *hit = nodeAt(event->pos(), true);
   if (!hit) {
     return;
   }
@@ -199,13 +393,33 @@ void CanvasWidget::updateTooltip(const QPointF &rawPos) {
     return;
   }
 
-  const QPointF layoutPos = mapToLayout(rawPos);
-  TreeNode *node = findNode(model->root(), layoutPos);
+  TreeNode *node = timedNodeAt(rawPos, false);
   if (node && node != hoveredNode) {
     hoveredNode = node;
-    QString fullPath = Utils::buildFullPath(node);
+    QString fullPath = pathOf(node);
     QString sizeText = Utils::formatSize(node->size);
     QString tip = QString("%1\n%2").arg(fullPath, sizeText);
+    if (const TreeDiff *diff = renderer.treeDiff().get()) {
+      const QString change = changeText(*diff, node);
+      if (!change.isEmpty()) {
+        tip += QLatin1Char('\n') + change;
+      }
+    }
+    if (diskCheck) {
+      switch (diskCheck->statusOf(node)) {
+      case DiskCheck::Status::Missing:
+        tip += QLatin1Char('\n') + tr("No longer on disk");
+        break;
+      case DiskCheck::Status::Resized:
+        tip += QLatin1Char('\n') + tr("Size on disk has changed");
+        break;
+      case DiskCheck::Status::Unknown:
+        tip += QLatin1Char('\n') + tr("Could not be checked on disk");
+        break;
+      case DiskCheck::Status::Present:
+        break;
+      }
+    }
     QToolTip::showText(mapToGlobal(rawPos.toPoint()), tip, this);
     update();
   } else if (!node) {
@@ -217,12 +431,35 @@ void CanvasWidget::updateTooltip(const QPointF &rawPos) {
   }
 }
 
+QString CanvasWidget::changeText(const TreeDiff &diff, const TreeNode *node) {
+  if (diff.nodeTable()->rowOf(node) < 0) {
+    return QString();
+  }
+  if (diff.changeOf(node) == TreeDiff::Change::Added) {
+    return tr("New since baseline");
+  }
+  const qint64 delta = diff.deltaOf(node);
+  QString text;
+  if (delta == 0) {
+    text = tr("Unchanged since baseline");
+  } else {
+    const quint64 magnitude = static_cast<quint64>(delta > 0 ? delta : -delta);
+    text = tr("%1%2 since baseline")
+               .arg(delta > 0 ? QLatin1Char('+') : QLatin1Char('-'))
+               .arg(Utils::formatSize(magnitude));
+  }
+  if (const quint64 removed = diff.removedBytesOf(node)) {
+    text += tr(" (%1 removed)").arg(Utils::formatSize(removed));
+  }
+  return text;
+}
+
 void CanvasWidget::showContextMenu(const QPoint &globalPos, TreeNode *node) {
   if (!node) {
     return;
   }
 
-  const QString fullPath = Utils::buildFullPath(node);
+  const QString fullPath = pathOf(node);
   if (fullPath.isEmpty()) {
     return;
   }
@@ -275,92 +512,171 @@ QPointF CanvasWidget::mapToLayout(const QPointF &pos) const {
   return QPointF(pos.x(), height() - pos.y());
 }
 
-void CanvasWidget::drawBevelRect(QImage &image, const QRectF &rect,
-                                 const QColor &base) {
-  int x0 = static_cast<int>(rect.x() + 0.5);
-  int y0 = static_cast<int>(rect.y() + 0.5);
-  int rectWidth = static_cast<int>(rect.x() + rect.width() + 0.5) - x0;
-  int rectHeight = static_cast<int>(rect.y() + rect.height() + 0.5) - y0;
-
-  if (rectWidth <= 0 || rectHeight <= 0) {
-    return;
-  }
+qreal CanvasWidget::targetRenderScale() const {
+  return highDpi ? std::max<qreal>(1.0, devicePixelRatioF()) : 1.0;
+}
 
-  const int imgWidth = image.width();
-  const int imgHeight = image.height();
+void CanvasWidget::invalidateDisplayList() {
+  // Also cancels any progressive refinement still in flight.
+  refineTimer->stop();
+  displayListDirty = true;
+  imageDirty = true;
+  highlightMaskDirty = true;
+  staleMaskDirty = true;
+  update();
+}
 
-  // GrandPerspective original algorithm: two triangles filled by horizontal and
-  // vertical gradient lines, using a gradient palette derived from the base
-  // color.
-  constexpr double kDefaultColorGradient = 0.5;
-  const auto gradientColors = buildGradientColors(base, kDefaultColorGradient);
+void CanvasWidget::rebuildDisplayList() {
+  Trace::Scope trace("CanvasWidget::rebuildDisplayList");
+  displayListDirty = false;
+  imageDirty = true;
+  renderScale = targetRenderScale();
+  renderer.buildDisplayList(focusNode(), viewState, renderScale,
+                            displayList, &culledItems);
+  trace.setArg("items", static_cast<qint64>(displayList.size()));
+}
 
-  QRgb *data = reinterpret_cast<QRgb *>(image.bits());
-  const int stride = image.bytesPerLine() / static_cast<int>(sizeof(QRgb));
+void CanvasWidget::beginRender() {
+  imageDirty = false;
+  renderedItems = 0;
 
-  auto setPixel = [&](int x, int y, QRgb color) {
-    if (x < 0 || x >= imgWidth || y < 0 || y >= imgHeight) {
-      return;
-    }
-    data[y * stride + x] = color;
-  };
-
-  // Horizontal lines: upper-left triangle
-  for (int y = 0; y < rectHeight; ++y) {
-    double gradient = 256.0 * (y0 + y + 0.5 - rect.y()) / rect.height();
-    int gradientIndex =
-        std::clamp(static_cast<int>(std::lround(gradient)), 0, 255);
-    QRgb color = gradientColors[gradientIndex];
-
-    int maxX = (rectHeight - y - 1) * rectWidth / rectHeight;
-    int yWrite =
-        imgHeight - y0 - y - 1; // Match original bitmap's flipped Y-axis
-    for (int x = 0; x < maxX; ++x) {
-      setPixel(x0 + x, yWrite, color);
-    }
+  // Draw pixel-by-pixel using QImage, at device resolution when HiDPI
+  // rendering is enabled.
+  const QSize imageSize = (QSizeF(size()) * renderScale).toSize();
+  if (cachedImage.size() != imageSize) {
+    cachedImage = QImage(imageSize, QImage::Format_RGB32);
   }
+  cachedImage.setDevicePixelRatio(renderScale);
+  cachedImage.fill(Qt::black);
+  nodeIdBuffer.assign(
+      static_cast<size_t>(cachedImage.width()) * cachedImage.height(), 0);
+}
 
-  // Vertical lines: lower-right triangle
-  for (int x = 0; x < rectWidth; ++x) {
-    double gradient = 256.0 * (1.0 - (x0 + x + 0.5 - rect.x()) / rect.width());
-    int gradientIndex =
-        std::clamp(static_cast<int>(std::lround(gradient)), 0, 255);
-    QRgb color = gradientColors[gradientIndex];
-
-    int minY = (rectWidth - x - 1) * rectHeight / rectWidth;
-    int startY = imgHeight - y0 - rectHeight;
-    int rows = rectHeight - minY;
-    for (int y = 0; y < rows; ++y) {
-      setPixel(x0 + x, startY + y, color);
+bool CanvasWidget::renderPendingItems(qint64 budgetMs) {
+  // Checking the clock per item would cost more than drawing small ones.
+  constexpr size_t kItemsPerClockCheck = 256;
+
+  Trace::Scope trace("CanvasWidget::renderPendingItems");
+  const size_t first = renderedItems;
+  QElapsedTimer clock;
+  clock.start();
+
+  // The display list is breadth-first, so stopping early leaves every
+  // shallower level complete and the partial image is still meaningful.
+  const size_t count = displayList.size();
+  while (renderedItems < count) {
+    const TreeRenderer::DisplayItem &item = displayList[renderedItems];
+    TreeRenderer::drawBevelRect(
+        cachedImage, nodeIdBuffer.data(),
+        static_cast<quint32>(renderedItems + 1), item.rect,
+        renderer.gradient(item.paletteIndex));
+    ++renderedItems;
+
+    if (budgetMs >= 0 && renderedItems % kItemsPerClockCheck == 0 &&
+        clock.elapsed() >= budgetMs) {
+      break;
     }
   }
+  trace.setArg("items", static_cast<qint64>(renderedItems - first));
+  return renderedItems >= count;
 }
 
-void CanvasWidget::drawNode(QImage &image, TreeNode *node, int depth) {
-  if (!node) {
-    return;
+void CanvasWidget::continueRender() {
+  if (displayListDirty || imageDirty) {
+    return; // The next paint restarts from scratch.
   }
-
-  // Skip rectangles smaller than 1 pixel
-  if (node->rect.width() < 1.0 || node->rect.height() < 1.0) {
-    return;
+  QElapsedTimer clock;
+  clock.start();
+  if (!renderPendingItems(kFrameBudgetMs)) {
+    refineTimer->start();
   }
+  refineMs += static_cast<double>(clock.nsecsElapsed()) / 1e6;
+  update();
+}
+
+QImage
+CanvasWidget::renderOverview(const QSize &size,
+                             QHash<TreeNode *, QRectF> *folderRects) const {
+  return renderer.render(model ? model->root() : nullptr, size, folderRects,
+                         &viewState);
+}
 
-  QColor base = colorForNode(node, depth);
-  drawBevelRect(image, node->rect, base);
+bool CanvasWidget::exportImage(
+    const QString &path, const QSize &size, QString *errorOut,
+    const std::function<bool(int)> &progress) const {
+  return renderer.renderToPng(focusNode(), size, path, errorOut, progress, 0,
+                              &viewState);
+}
 
-  for (TreeNode *child : node->children) {
-    drawNode(image, child, depth + 1);
+void CanvasWidget::rebuildHighlightMask() {
+  highlightMaskDirty = false;
+  if (highlightMask.size() != cachedImage.size()) {
+    highlightMask =
+        QImage(cachedImage.size(), QImage::Format_ARGB32_Premultiplied);
+  }
+  highlightMask.setDevicePixelRatio(renderScale);
+
+  // Dim everything, then punch holes where either set's nodes are.
+  highlightMask.fill(QColor(0, 0, 0, 160));
+  QPainter painter(&highlightMask);
+  painter.setCompositionMode(QPainter::CompositionMode_Clear);
+
+  // Keep sub-pixel matches visible as at least one device pixel.
+  const qreal minSize = 1.0 / renderScale;
+  for (const QVector<TreeNode *> *nodes :
+       {&searchHighlights, &filterHighlights}) {
+    for (const TreeNode *node : *nodes) {
+      if (!isInView(node)) {
+        continue;
+      }
+      QRectF rect = viewState.rect(node);
+      rect.moveTop(height() - rect.y() - rect.height());
+      rect.setWidth(std::max(rect.width(), minSize));
+      rect.setHeight(std::max(rect.height(), minSize));
+      painter.fillRect(rect, Qt::transparent);
+    }
+  }
+}
+
+void CanvasWidget::rebuildStaleMask() {
+  staleMaskDirty = false;
+  if (staleMask.size() != cachedImage.size()) {
+    staleMask =
+        QImage(cachedImage.size(), QImage::Format_ARGB32_Premultiplied);
+  }
+  staleMask.setDevicePixelRatio(renderScale);
+  staleMask.fill(Qt::transparent);
+
+  QPainter painter(&staleMask);
+  const QBrush missing(QColor(96, 96, 96, 210));
+  const QBrush resized(QColor(255, 255, 255, 150), Qt::BDiagPattern);
+  const TreeNode *viewRoot = focusNode();
+  for (const TreeRenderer::DisplayItem &item : displayList) {
+    const DiskCheck::Status status = diskCheck->statusOf(item.node);
+    if (status != DiskCheck::Status::Missing &&
+        status != DiskCheck::Status::Resized) {
+      continue;
+    }
+    // A missing folder's tint already covers everything inside it.
+    if (status == DiskCheck::Status::Missing && item.node != viewRoot &&
+        diskCheck->statusOf(model->parentOf(item.node)) ==
+            DiskCheck::Status::Missing) {
+      continue;
+    }
+    QRectF rect = viewState.rect(item.node);
+    rect.moveTop(height() - rect.y() - rect.height());
+    painter.fillRect(rect, status == DiskCheck::Status::Missing ? missing
+                                                                : resized);
   }
 }
 
 void CanvasWidget::drawSelection(QPainter &painter, TreeNode *node) {
-  if (!node)
+  if (!node || !isInView(node))
     return;
 
   painter.setPen(QPen(Qt::yellow, 2));
   painter.setBrush(Qt::NoBrush);
-  QRectF rect = node->rect;
+  QRectF rect = viewState.rect(node);
   rect.moveTop(height() - rect.y() - rect.height());
   painter.drawRect(rect.adjusted(1, 1, -1, -1));
 }
@@ -377,121 +693,120 @@ void CanvasWidget::drawHoveredAncestors(QPainter &painter, TreeNode *node) {
 
   TreeNode *cur = node;
   while (cur) {
-    if (cur == model->root()) {
+    if (cur == focusNode()) {
       break;
     }
 
-    QRectF rect = cur->rect;
+    QRectF rect = viewState.rect(cur);
     rect.moveTop(height() - rect.y() - rect.height());
     painter.drawRect(rect.adjusted(0.5, 0.5, -0.5, -0.5));
 
-    cur = cur->parent;
+    cur = model->parentOf(cur);
   }
 }
 
-QColor CanvasWidget::colorForNode(const TreeNode *node, int depth) const {
-  if (!node) {
-    return QColor(128, 128, 128);
-  }
-
-  if (palette.isEmpty()) {
-    return QColor(128, 128, 128);
+void CanvasWidget::requestModelMemory() {
+  if (!model || memoryRequested) {
+    return;
   }
+  // setFuture() drops the report of a model replaced in the meantime.
+  memoryRequested = true;
+  const std::shared_ptr<const TreeModel> measured = model;
+  memoryWatcher->setFuture(TaskScheduler::run(
+      TaskScheduler::Priority::Background,
+      [measured]() { return TreeModel::memoryReport(measured->root()); }));
+}
 
-  auto extensionKey = [](const QString &name) -> QString {
-    int dot = name.lastIndexOf('.');
-    if (dot <= 0 || dot == name.size() - 1) {
-      return QString();
-    }
-    return name.mid(dot + 1).toLower();
+void CanvasWidget::drawHud(QPainter &painter) {
+  auto line = [](const QString &label, const FrameStats &stats) {
+    return QStringLiteral("%1 %2 ms  min %3  avg %4  p95 %5")
+        .arg(label, -8)
+        .arg(stats.last(), 6, 'f', 2)
+        .arg(stats.min(), 0, 'f', 2)
+        .arg(stats.average(), 0, 'f', 2)
+        .arg(stats.percentile95(), 0, 'f', 2);
   };
-
-  auto folderKey = [](const TreeNode *n) -> QString {
-    if (!n) {
-      return QString();
-    }
-    if (n->isDir) {
-      return n->name;
-    }
-    return n->parent ? n->parent->name : QString();
+  const QStringList lines = {
+      line(tr("Raster"), rasterStats),
+      line(tr("Blit"), blitStats),
+      line(tr("Overlay"), overlayStats),
+      line(tr("Hit test"), hitTestStats),
+      tr("Drawn %1 rects, culled %2 subtrees")
+          .arg(displayList.size())
+          .arg(culledItems),
+      modelMemory.nodes == 0
+          ? tr("Model ...")
+          : tr("Model %1 nodes, ~%2")
+                .arg(modelMemory.nodes)
+                .arg(Utils::formatSize(modelMemory.totalBytes())),
   };
 
-  auto topFolderKey = [](const TreeNode *n) -> QString {
-    if (!n) {
-      return QString();
-    }
-    const TreeNode *cur = n;
-    // Walk to the node directly under the root.
-    while (cur->parent && cur->parent->parent) {
-      cur = cur->parent;
-    }
-    // If the root has name "/", cur might still be a file; use its parent when
-    // possible.
-    if (!cur->isDir && cur->parent) {
-      return cur->parent->name;
-    }
-    return cur->name;
-  };
+  painter.save();
+  painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  const QFontMetrics metrics = painter.fontMetrics();
+  int width = 0;
+  for (const QString &text : lines) {
+    width = std::max(width, metrics.horizontalAdvance(text));
+  }
+  const int padding = 6;
+  const QRect box(8, 8, width + 2 * padding,
+                  static_cast<int>(lines.size()) * metrics.height() +
+                      2 * padding);
+  // A partial repaint is clipped to the previous box; schedule a grown one.
+  if (!hudRect.contains(box)) {
+    update(box);
+  }
+  hudRect = box;
+  painter.fillRect(box, QColor(0, 0, 0, 180));
+  painter.setPen(Qt::white);
+  int y = box.top() + padding + metrics.ascent();
+  for (const QString &text : lines) {
+    painter.drawText(box.left() + padding, y, text);
+    y += metrics.height();
+  }
+  painter.restore();
+}
 
-  int index = 0;
-  switch (colorMappingMode) {
-  case ColorMappingMode::Extension: {
-    // Matches GrandPerspective's "extension" mapping idea.
-    QString key = node->isDir ? node->name : extensionKey(node->name);
-    if (key.isEmpty()) {
-      key = node->name;
-    }
-    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
-    break;
-  }
-  case ColorMappingMode::Name: {
-    index =
-        static_cast<int>(qHash(node->name) % static_cast<uint>(palette.size()));
-    break;
-  }
-  case ColorMappingMode::Folder: {
-    QString key = folderKey(node);
-    if (key.isEmpty()) {
-      key = node->name;
-    }
-    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
-    break;
-  }
-  case ColorMappingMode::TopFolder: {
-    QString key = topFolderKey(node);
-    if (key.isEmpty()) {
-      key = node->name;
-    }
-    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
-    break;
+TreeNode *CanvasWidget::timedNodeAt(const QPointF &rawPos, bool exact) {
+  QElapsedTimer clock;
+  clock.start();
+  TreeNode *hit = nodeAt(rawPos, exact);
+  hitTestStats.add(static_cast<double>(clock.nsecsElapsed()) / 1e6);
+  if (hud) {
+    // Show the new latency even if the hover did not change.
+    update(hudRect.isNull() ? rect() : hudRect);
   }
-  case ColorMappingMode::Level: {
-    // Similar to GrandPerspective's level mapping: clamp to last color.
-    index = std::min(depth, static_cast<int>(palette.size()) - 1);
-    break;
-  }
-  case ColorMappingMode::Nothing:
-  default:
-    index = 0;
-    break;
+  return hit;
+}
+
+TreeNode *CanvasWidget::nodeAt(const QPointF &rawPos, bool exact) {
+  if (!model || !model->root()) {
+    return nullptr;
   }
 
-  return palette[index];
-}
+  const QPointF layoutPos = mapToLayout(rawPos);
+  if (displayListDirty || imageDirty || cachedImage.isNull()) {
+    return TreeLayout::nodeAt(focusNode(), layoutPos, viewState);
+  }
 
-TreeNode *CanvasWidget::findNode(TreeNode *node, const QPointF &pos) {
-  if (!node || !node->rect.contains(pos)) {
+  const int x = static_cast<int>(std::floor(rawPos.x() * renderScale));
+  const int y = static_cast<int>(std::floor(rawPos.y() * renderScale));
+  if (x < 0 || y < 0 || x >= cachedImage.width() ||
+      y >= cachedImage.height()) {
     return nullptr;
   }
 
-  for (TreeNode *child : node->children) {
-    if (child->rect.contains(pos)) {
-      TreeNode *found = findNode(child, pos);
-      if (found) {
-        return found;
-      }
-    }
+  const quint32 id =
+      nodeIdBuffer[static_cast<size_t>(y) * cachedImage.width() + x];
+  if (id == 0) {
+    return TreeLayout::nodeAt(focusNode(), layoutPos, viewState);
   }
 
-  return node;
+  TreeNode *hit = displayList[id - 1].node;
+  if (exact && !hit->children.isEmpty()) {
+    if (TreeNode *refined = TreeLayout::nodeAt(hit, layoutPos, viewState)) {
+      return refined;
+    }
+  }
+  return hit;
 }
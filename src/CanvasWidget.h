@@ -1,35 +1,103 @@
 #pragma once
 
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
 #include <QWidget>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <QString>
 
+#include "DiskCheck.h"
+#include "FrameStats.h"
+#include "TreeLayout.h"
 #include "TreeModel.h"
+#include "TreeRenderer.h"
+
+class NodeTable;
+class QTimer;
 
 class CanvasWidget : public QWidget {
   Q_OBJECT
 
 public:
-  enum class ColorMappingMode {
-    Extension,
-    Name,
-    Folder,
-    TopFolder,
-    Level,
-    Nothing,
-  };
+  using ColorMappingMode = TreeRenderer::ColorMappingMode;
 
   explicit CanvasWidget(QWidget *parent = nullptr);
 
   void setModel(std::shared_ptr<TreeModel> model);
   void setColorMappingMode(ColorMappingMode mode);
+  // Baseline comparison for the Change color mode and the tooltip delta.
+  void setDiff(std::shared_ptr<const TreeDiff> diff);
+  // Gray out items that are gone from disk and hatch files whose size
+  // changed. Like the highlight mask, an overlay on the cached treemap.
+  void setDiskCheck(std::shared_ptr<const DiskCheck> check);
+
+  // Zoom into the subtree under `node`; nullptr shows the whole model.
+  void setFocusNode(TreeNode *node);
+  // Root of the subtree currently shown.
+  TreeNode *focusNode() const;
+  TreeNode *selection() const { return selectedNode; }
+  // Select `node`, leaving the zoom if it is outside the current view.
+  void setSelectedNode(TreeNode *node);
+
+  // Dim everything except the search and filter matches. The two sets are
+  // kept apart so one never clears the other. The mask is an overlay on top
+  // of the cached treemap, so changing it never re-rasterizes the treemap.
+  void setSearchHighlights(const QVector<TreeNode *> &nodes);
+  void setFilterHighlights(const QVector<TreeNode *> &nodes);
+
+  // Hide the nodes whose row in `table` is set in `mask`, or show all of
+  // them again, leaving a zoom whose folder disappears. `table` must have
+  // been built from the model shown; masks for another model are ignored.
+  void setHiddenMask(const NodeTable &table, const std::vector<quint8> &mask);
+  void clearHiddenMask();
+
+  // Parent of `node` in the model shown, or nullptr.
+  TreeNode *parentOf(const TreeNode *node) const;
+  // Full path of `node` in the model shown.
+  QString pathOf(const TreeNode *node) const;
+
+  // Lay the view out again, e.g. after the widget was resized.
+  void relayout();
+
+  // Render the whole model into an image of `size` with the current palette,
+  // color mapping and filter, regardless of zoom and without touching the
+  // view's layout. Drawn folders are reported in layout coordinates.
+  QImage renderOverview(const QSize &size,
+                        QHash<TreeNode *, QRectF> *folderRects) const;
+
+  // Export the current view's subtree as a PNG of `size`, rendered in strips
+  // so the size is not limited by memory.
+  bool exportImage(const QString &path, const QSize &size, QString *errorOut,
+                   const std::function<bool(int rowsDone)> &progress) const;
 
   void setPaletteName(const QString &name);
   QString paletteName() const;
 
+  // Draw the display list in time-budgeted slices, refining the image on
+  // later event-loop iterations instead of blocking until it is complete.
+  void setProgressiveRendering(bool enabled);
+  bool progressiveRendering() const { return progressive; }
+
+  // Rasterize the cached treemap at the device pixel ratio (sharp on HiDPI
+  // screens) instead of letting Qt upscale a logical-resolution image.
+  void setHighDpiRendering(bool enabled);
+  bool highDpiRendering() const { return highDpi; }
+
+  // Number of rectangles the current view actually draws.
+  int displayListSize() const { return static_cast<int>(displayList.size()); }
+
+  // Overlay the timings of recent frames and hit tests, the rectangles drawn
+  // and culled, and the model's size in memory.
+  void setHudVisible(bool visible);
+  bool hudVisible() const { return hud; }
+
 signals:
   void selectedNodeChanged(TreeNode *node);
+  void focusNodeChanged(TreeNode *node);
   void requestDeletePath(const QString &path);
 
 protected:
@@ -41,23 +109,83 @@ protected:
   void contextMenuEvent(QContextMenuEvent *event) override;
 
 private:
-  QColor colorForNode(const TreeNode *node, int depth) const;
-
-  // Draw rectangle with GrandPerspective-style two-triangle gradient
-  void drawBevelRect(QImage &image, const QRectF &rect, const QColor &base);
+  bool isInView(const TreeNode *node) const;
+  // False for nodes of another model, e.g. the folder tree while an
+  // extension treemap is shown.
+  bool isInModel(const TreeNode *node) const;
+  // Leave a zoom whose folder the filter just hid and lay out again.
+  void filterChanged();
 
-  void drawNode(QImage &image, TreeNode *node, int depth);
+  qreal targetRenderScale() const;
+  void invalidateDisplayList();
+  void rebuildDisplayList();
+  void beginRender();
+  // Rasterize pending display items; a negative budget draws all of them.
+  // Returns true once the image is complete.
+  bool renderPendingItems(qint64 budgetMs);
+  void continueRender();
+  void setHighlights(QVector<TreeNode *> &target,
+                     const QVector<TreeNode *> &nodes);
+  void rebuildHighlightMask();
+  void rebuildStaleMask();
   void drawSelection(QPainter &painter, TreeNode *node);
   void drawHoveredAncestors(QPainter &painter, TreeNode *node);
-  TreeNode *findNode(TreeNode *node, const QPointF &pos);
+  void drawHud(QPainter &painter);
+  // Measure the model's memory on the pool for the HUD, once per model.
+  void requestModelMemory();
+  // nodeAt() with its latency recorded for the HUD.
+  TreeNode *timedNodeAt(const QPointF &rawPos, bool exact);
+  // The item drawn at `rawPos`. Items below one device pixel are not in the
+  // id buffer; `exact` walks down to them from the hit, which clicks need
+  // but hovering does not.
+  TreeNode *nodeAt(const QPointF &rawPos, bool exact);
   void updateTooltip(const QPointF &rawPos);
+  // Tooltip line describing how `node` changed since the baseline.
+  static QString changeText(const TreeDiff &diff, const TreeNode *node);
   void showContextMenu(const QPoint &globalPos, TreeNode *node);
   QPointF mapToLayout(const QPointF &pos) const;
 
   std::shared_ptr<TreeModel> model;
+  TreeNode *focusedNode = nullptr; // nullptr when showing the whole model
   TreeNode *selectedNode = nullptr;
   TreeNode *hoveredNode = nullptr;
-  QVector<QColor> palette;
+  TreeRenderer renderer;
   QString currentPaletteName;
-  ColorMappingMode colorMappingMode = ColorMappingMode::Extension;
+  // Layout and filter state of the model shown; reset with the model.
+  TreeLayout::ViewState viewState;
+
+  // Drawable rectangles of the current layout, breadth-first.
+  std::vector<TreeRenderer::DisplayItem> displayList;
+  bool displayListDirty = true;
+  QImage cachedImage;
+  // Display list index + 1 per pixel of cachedImage; 0 means background.
+  std::vector<quint32> nodeIdBuffer;
+  bool imageDirty = true;
+  size_t renderedItems = 0;
+  bool progressive = false;
+  bool highDpi = true;
+  qreal renderScale = 1.0; // Device pixels per layout unit of displayList
+  QTimer *refineTimer = nullptr;
+
+  QVector<TreeNode *> searchHighlights;
+  QVector<TreeNode *> filterHighlights;
+  QImage highlightMask; // Premultiplied ARGB, same size as cachedImage
+  bool highlightMaskDirty = true;
+
+  std::shared_ptr<const DiskCheck> diskCheck;
+  QImage staleMask; // Premultiplied ARGB, same size as cachedImage
+  bool staleMaskDirty = true;
+
+  // Performance HUD; timings are in milliseconds.
+  bool hud = false;
+  QRect hudRect; // Where drawHud() last drew, repainted on hit tests
+  FrameStats rasterStats;
+  FrameStats blitStats;
+  FrameStats overlayStats;
+  FrameStats hitTestStats;
+  double refineMs = 0.0; // Raster time of refinement steps since last paint
+  size_t culledItems = 0;
+  TreeModel::MemoryReport modelMemory; // Empty until the pool reports it
+  QFutureWatcher<TreeModel::MemoryReport> *memoryWatcher = nullptr;
+  bool memoryRequested = false;
 };
@@ -0,0 +1,184 @@
+#include "DiskCheck.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "Trace.h"
+#include "Utils.h"
+
+namespace {
+
+// Folders per parallel work item; reading one is a system call or more.
+constexpr size_t kChunkFolders = 16;
+
+// Size of each entry of `path` by name, in the scan's measure; -1 when
+// sizes are not wanted or the entry is not a regular file. False if the
+// folder cannot be read, with `gone` set when it no longer exists.
+bool readFolder(const QString &path, bool withSizes,
+                TreeModel::SizeMeasure measure,
+                QHash<QString, qint64> *entries, bool *gone) {
+#ifdef Q_OS_UNIX
+  DIR *dir = opendir(QFile::encodeName(path).constData());
+  if (!dir) {
+    *gone = errno == ENOENT || errno == ENOTDIR;
+    return false;
+  }
+  while (const dirent *entry = readdir(dir)) {
+    const char *name = entry->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+    qint64 size = -1;
+    struct stat info;
+    if (withSizes &&
+        fstatat(dirfd(dir), name, &info, AT_SYMLINK_NOFOLLOW) == 0 &&
+        S_ISREG(info.st_mode)) {
+      // st_blocks counts 512-byte units whatever the file system's block.
+      size = measure == TreeModel::SizeMeasure::Physical
+                 ? static_cast<qint64>(info.st_blocks) * 512
+                 : static_cast<qint64>(info.st_size);
+    }
+    entries->insert(QFile::decodeName(name), size);
+  }
+  closedir(dir);
+  return true;
+#else
+  const QFileInfo folder(path);
+  if (!folder.isDir()) {
+    *gone = !folder.exists();
+    return false;
+  }
+  // QFileInfo has no allocated size, so physical scans compare none.
+  withSizes = withSizes && measure == TreeModel::SizeMeasure::Logical;
+  QDirIterator it(path, QDir::AllEntries | QDir::Hidden | QDir::System |
+                            QDir::NoDotAndDotDot);
+  while (it.hasNext()) {
+    it.next();
+    const QFileInfo info = it.fileInfo();
+    entries->insert(it.fileName(),
+                    withSizes && info.isFile() && !info.isSymLink()
+                        ? info.size()
+                        : -1);
+  }
+  return true;
+#endif
+}
+
+} // namespace
+
+std::shared_ptr<const DiskCheck>
+DiskCheck::run(std::shared_ptr<const NodeTable> nodeTable, bool compareSizes,
+               const TaskScheduler::CancelToken &cancel) {
+  Trace::Scope trace("DiskCheck::run");
+  std::shared_ptr<DiskCheck> check(new DiskCheck());
+  check->table = std::move(nodeTable);
+  const NodeTable &table = *check->table;
+  const size_t rows = table.rowCount();
+  check->statuses.assign(rows, static_cast<quint8>(Status::Present));
+  if (rows == 0) {
+    return check;
+  }
+
+  const bool rootExists =
+      QFileInfo::exists(Utils::buildFullPath(table, 0));
+  if (!rootExists) {
+    check->statuses.assign(rows, static_cast<quint8>(Status::Missing));
+  }
+
+  std::vector<quint32> folders;
+  for (size_t row = 0; row < rows; ++row) {
+    if (table.dirFlags[row]) {
+      folders.push_back(static_cast<quint32>(row));
+    }
+  }
+
+  const TreeModel::SizeMeasure measure =
+      table.model ? table.model->sizeMeasure()
+                  : TreeModel::SizeMeasure::Logical;
+
+  // Each row is written only by the folder it is listed in, so the folders
+  // can be read in any order without locks. A missing folder's own status
+  // comes from its parent. Folders below one found gone are not read:
+  // within a chunk, pre-order puts them in [row, subtreeEnd[row]), and a
+  // folder whose parent was already found gone by another chunk is gone.
+  quint8 *statuses = check->statuses.data();
+  std::vector<std::atomic<bool>> goneFolders(rows);
+  const bool finished = TaskScheduler::parallelFor(
+      rootExists ? folders.size() : 0, kChunkFolders,
+      [&](size_t begin, size_t end) {
+        QHash<QString, qint64> entries;
+        quint32 goneEnd = 0; // Rows below a gone folder of this chunk
+        for (size_t i = begin; i < end; ++i) {
+          const quint32 folderRow = folders[i];
+          const TreeNode *folder = table.nodes[folderRow];
+          entries.clear();
+          bool gone = folderRow < goneEnd ||
+                      (folderRow > 0 &&
+                       goneFolders[table.parents[folderRow]].load(
+                           std::memory_order_relaxed));
+          const bool read =
+              !gone && readFolder(Utils::buildFullPath(table, folderRow),
+                                  compareSizes, measure, &entries, &gone);
+          if (gone) {
+            goneFolders[folderRow].store(true, std::memory_order_relaxed);
+            goneEnd = std::max(goneEnd, table.subtreeEnd[folderRow]);
+          }
+          for (const TreeNode *child : folder->children) {
+            const qint64 row = table.rowOf(child);
+            if (row < 0) {
+              continue;
+            }
+            Status status = Status::Present;
+            if (!read) {
+              status = gone ? Status::Missing : Status::Unknown;
+            } else if (const auto it = entries.constFind(child->name);
+                       it == entries.constEnd()) {
+              status = Status::Missing;
+            } else if (!child->isDir && it.value() >= 0 &&
+                       static_cast<quint64>(it.value()) != child->size) {
+              status = Status::Resized;
+            }
+            statuses[row] = static_cast<quint8>(status);
+          }
+        }
+      },
+      TaskScheduler::Priority::Background, cancel);
+  if (!finished) {
+    return nullptr;
+  }
+
+  for (size_t row = 0; row < rows; ++row) {
+    const auto status = static_cast<Status>(statuses[row]);
+    if (status == Status::Missing) {
+      ++check->missing;
+      const quint32 parent = table.parents[row];
+      if (row == 0 ||
+          static_cast<Status>(statuses[parent]) != Status::Missing) {
+        check->missingSize += table.sizes[row];
+      }
+    } else if (status == Status::Resized) {
+      ++check->resized;
+    }
+  }
+  trace.setArg("folders", static_cast<qint64>(folders.size()));
+  return check;
+}
+
+DiskCheck::Status DiskCheck::statusOf(const TreeNode *node) const {
+  const qint64 row = table ? table->rowOf(node) : -1;
+  return row < 0 ? Status::Present : static_cast<Status>(statuses[row]);
+}
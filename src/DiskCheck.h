@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+#include "TaskScheduler.h"
+#include "TreeModel.h"
+
+// Which items of a scan are still on disk. Every folder is read once and
+// its children are looked up by name in the listing, so files are only
+// stat'ed when sizes are compared, and then relative to the open folder.
+// Sizes are compared in the scan's measure, logical or physical. Folders
+// below one that is gone are not read.
+// Folders are read in parallel on the shared pool. Meant for a worker
+// thread; the tree must not change while it is checked.
+class DiskCheck {
+public:
+  enum class Status : quint8 {
+    Present,
+    Missing, // Gone, or inside a folder that is gone
+    Resized, // A file whose size on disk differs from the scan
+    Unknown, // Inside a folder that could not be read
+  };
+
+  // Null if `cancel` fired before every folder was read.
+  static std::shared_ptr<const DiskCheck>
+  run(std::shared_ptr<const NodeTable> table, bool compareSizes,
+      const TaskScheduler::CancelToken &cancel = TaskScheduler::CancelToken());
+
+  // Nodes that are not rows of nodeTable() report Present.
+  Status statusOf(const TreeNode *node) const;
+
+  quint64 missingItems() const { return missing; }
+  // Scanned size of what is gone, counting each missing folder once.
+  quint64 missingBytes() const { return missingSize; }
+  quint64 resizedItems() const { return resized; }
+
+  const std::shared_ptr<const NodeTable> &nodeTable() const { return table; }
+
+private:
+  DiskCheck() = default;
+
+  std::shared_ptr<const NodeTable> table;
+  std::vector<quint8> statuses; // Per row, a Status
+  quint64 missing = 0;
+  quint64 missingSize = 0;
+  quint64 resized = 0;
+};
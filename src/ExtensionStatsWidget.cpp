@@ -0,0 +1,187 @@
+#include "ExtensionStatsWidget.h"
+
+#include <QCheckBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "ExtensionTreemap.h"
+#include "Utils.h"
+
+namespace {
+
+enum Column { ExtensionColumn, SizeColumn, FilesColumn, ShareColumn };
+
+// Sorts numeric columns by the raw value kept in Qt::UserRole rather than
+// by their formatted text.
+class TotalItem : public QTreeWidgetItem {
+public:
+  using QTreeWidgetItem::QTreeWidgetItem;
+
+  bool operator<(const QTreeWidgetItem &other) const override {
+    const int column = treeWidget() ? treeWidget()->sortColumn() : 0;
+    if (column == ExtensionColumn) {
+      return text(column).compare(other.text(column), Qt::CaseInsensitive) <
+             0;
+    }
+    return data(column, Qt::UserRole).toULongLong() <
+           other.data(column, Qt::UserRole).toULongLong();
+  }
+};
+
+} // namespace
+
+ExtensionStatsWidget::ExtensionStatsWidget(QWidget *parent)
+    : QWidget(parent) {
+  underSelectionCheck = new QCheckBox(tr("Under selection"), this);
+  underSelectionCheck->setToolTip(
+      tr("Count only files inside the selected folder"));
+  scopeLabel = new QLabel(this);
+  scopeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+  tree = new QTreeWidget(this);
+  tree->setColumnCount(4);
+  tree->setHeaderLabels({tr("Extension"), tr("Size"), tr("Files"), tr("%")});
+  tree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+  tree->setRootIsDecorated(false);
+  tree->setUniformRowHeights(true);
+  tree->setSortingEnabled(true);
+  tree->sortByColumn(SizeColumn, Qt::DescendingOrder);
+  tree->setToolTip(tr("Activate a row to filter by its extension"));
+
+  auto *layout = new QVBoxLayout(this);
+  layout->setContentsMargins(4, 4, 4, 4);
+  layout->addWidget(underSelectionCheck);
+  layout->addWidget(scopeLabel);
+  layout->addWidget(tree);
+
+  using Watcher = QFutureWatcher<std::vector<NodeTable::ExtensionTotal>>;
+  watcher = new Watcher(this);
+  connect(watcher, &Watcher::finished, this,
+          &ExtensionStatsWidget::showResult);
+  connect(underSelectionCheck, &QCheckBox::toggled, this,
+          &ExtensionStatsWidget::recompute);
+  connect(tree, &QTreeWidget::itemActivated, this,
+          [this](QTreeWidgetItem *item) { activateItem(item); });
+}
+
+void ExtensionStatsWidget::setNodeTable(
+    std::shared_ptr<const NodeTable> newTable) {
+  table = std::move(newTable);
+  scopeNode = nullptr;
+  recompute();
+}
+
+void ExtensionStatsWidget::setScopeNode(TreeNode *node) {
+  if (node == scopeNode) {
+    return;
+  }
+  scopeNode = node;
+  if (underSelectionCheck->isChecked()) {
+    recompute();
+  }
+}
+
+void ExtensionStatsWidget::showEvent(QShowEvent *event) {
+  QWidget::showEvent(event);
+  if (dirty) {
+    recompute();
+  }
+}
+
+void ExtensionStatsWidget::recompute() {
+  computedTable.reset();
+  if (!table || table->rowCount() == 0) {
+    tree->clear();
+    scopeLabel->clear();
+    dirty = false;
+    return;
+  }
+  if (!isVisible()) {
+    dirty = true;
+    return;
+  }
+  dirty = false;
+
+  const TreeNode *scope = nullptr;
+  if (underSelectionCheck->isChecked()) {
+    scope = scopeNode;
+  }
+  qint64 row = table->rowOf(scope);
+  if (row > 0 && !table->dirFlags[static_cast<size_t>(row)]) {
+    row = table->parents[static_cast<size_t>(row)];
+  }
+  const quint32 targetRow = row < 0 ? 0 : static_cast<quint32>(row);
+
+  scopeLabel->setText(
+      tr("Under %1").arg(Utils::buildFullPath(*table, targetRow)));
+
+  computedTable = table;
+  std::shared_ptr<const NodeTable> snapshot = table;
+  pending.cancel();
+  pending = TaskScheduler::CancelToken();
+  const TaskScheduler::CancelToken cancel = pending;
+  watcher->setFuture(TaskScheduler::run(
+      TaskScheduler::Priority::Normal, [snapshot, targetRow, cancel]() {
+        return snapshot->extensionTotals(targetRow, cancel);
+      }));
+}
+
+void ExtensionStatsWidget::showResult() {
+  if (watcher->isCanceled() || !table || computedTable != table) {
+    return;
+  }
+  const std::vector<NodeTable::ExtensionTotal> totals = watcher->result();
+
+  quint64 allBytes = 0;
+  for (const NodeTable::ExtensionTotal &total : totals) {
+    allBytes += total.bytes;
+  }
+
+  // Insert unsorted; re-enabling sorting orders everything once.
+  tree->setSortingEnabled(false);
+  tree->clear();
+  QList<QTreeWidgetItem *> items;
+  items.reserve(static_cast<qsizetype>(totals.size()));
+  for (const NodeTable::ExtensionTotal &total : totals) {
+    const double share =
+        allBytes > 0 ? 100.0 * double(total.bytes) / double(allBytes) : 0.0;
+    auto *item = new TotalItem(
+        QStringList{ExtensionTreemap::label(*table, total.extension),
+                    Utils::formatSize(total.bytes),
+                    QString::number(total.files),
+                    QString::number(share, 'f', 1)});
+    item->setData(ExtensionColumn, Qt::UserRole,
+                  QVariant::fromValue(static_cast<quint64>(total.extension)));
+    item->setData(SizeColumn, Qt::UserRole, QVariant::fromValue(total.bytes));
+    item->setData(FilesColumn, Qt::UserRole, QVariant::fromValue(total.files));
+    item->setData(ShareColumn, Qt::UserRole, QVariant::fromValue(total.bytes));
+    for (int column : {SizeColumn, FilesColumn, ShareColumn}) {
+      item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    }
+    items.push_back(item);
+  }
+  tree->addTopLevelItems(items);
+  tree->setSortingEnabled(true);
+}
+
+void ExtensionStatsWidget::activateItem(QTreeWidgetItem *item) {
+  if (!item || !table) {
+    return;
+  }
+  const quint64 extension =
+      item->data(ExtensionColumn, Qt::UserRole).toULongLong();
+  if (extension >= quint64(table->extensionNames.size())) {
+    return;
+  }
+  // Filter strings have no escapes; quote with whichever quote is unused.
+  const QString name = table->extensionNames[int(extension)];
+  const QChar quote = name.contains(QLatin1Char('"')) ? QLatin1Char('\'')
+                                                      : QLatin1Char('"');
+  if (name.contains(quote)) {
+    return;
+  }
+  emit filterRequested(
+      QStringLiteral("isFile && ext == %1%2%1").arg(quote).arg(name));
+}
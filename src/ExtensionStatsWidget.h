@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QFutureWatcher>
+#include <QWidget>
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+
+class QCheckBox;
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Sortable table of the bytes and file count per extension, for the whole
+// model or under the current selection. Totals are computed on a worker
+// thread and only while the panel is visible.
+class ExtensionStatsWidget : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit ExtensionStatsWidget(QWidget *parent = nullptr);
+
+  // Rows come from `table`; null clears the table.
+  void setNodeTable(std::shared_ptr<const NodeTable> table);
+  // Scope used when "Under selection" is checked.
+  void setScopeNode(TreeNode *node);
+
+signals:
+  // Filter expression matching the files of an activated extension.
+  void filterRequested(const QString &expression);
+
+protected:
+  void showEvent(QShowEvent *event) override;
+
+private:
+  void recompute();
+  void showResult();
+  void activateItem(QTreeWidgetItem *item);
+
+  QCheckBox *underSelectionCheck = nullptr;
+  QLabel *scopeLabel = nullptr;
+  QTreeWidget *tree = nullptr;
+
+  std::shared_ptr<const NodeTable> table;
+  TreeNode *scopeNode = nullptr;
+  QFutureWatcher<std::vector<NodeTable::ExtensionTotal>> *watcher = nullptr;
+  std::shared_ptr<const NodeTable> computedTable; // Table of the pending job
+  TaskScheduler::CancelToken pending; // Canceled when a newer job starts
+  bool dirty = true;
+};
@@ -0,0 +1,33 @@
+#include "ExtensionTreemap.h"
+
+namespace ExtensionTreemap {
+
+QString label(const NodeTable &table, quint32 extension) {
+  if (extension == 0 || extension >= quint32(table.extensionNames.size())) {
+    return QStringLiteral("(no extension)");
+  }
+  return QStringLiteral("*.") + table.extensionNames[extension];
+}
+
+std::shared_ptr<TreeModel>
+buildModel(const NodeTable &table,
+           const std::vector<NodeTable::ExtensionTotal> &totals) {
+  // The root has no name so paths built from these nodes stay relative and
+  // can never be mistaken for files on disk.
+  auto *root = new TreeNode();
+  root->isDir = true;
+  root->children.reserve(static_cast<qsizetype>(totals.size()));
+  for (const NodeTable::ExtensionTotal &total : totals) {
+    auto *node = new TreeNode();
+    node->name = label(table, total.extension);
+    node->size = total.bytes;
+    root->children.push_back(node);
+  }
+
+  auto model = std::make_shared<TreeModel>();
+  model->setRoot(root);
+  model->computeDerivedSizes();
+  return model;
+}
+
+} // namespace ExtensionTreemap
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+#include "TreeModel.h"
+
+namespace ExtensionTreemap {
+
+// Display name of an extension: "*.iso", or "(no extension)".
+QString label(const NodeTable &table, quint32 extension);
+
+// A model whose top-level items are extensions, each sized by the bytes its
+// files add up to. Its nodes do not name real paths.
+std::shared_ptr<TreeModel>
+buildModel(const NodeTable &table,
+           const std::vector<NodeTable::ExtensionTotal> &totals);
+
+} // namespace ExtensionTreemap
@@ -0,0 +1,109 @@
+#include "FileRemover.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+
+#include <vector>
+
+namespace FileRemover {
+
+namespace {
+
+constexpr quint64 kProgressInterval = 256;
+constexpr QDir::Filters kEntries =
+    QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot;
+
+} // namespace
+
+Result remove(const QString &path,
+              const std::function<bool(const Progress &)> &progress) {
+  Result result;
+  auto fail = [&result](const QString &item, const QString &reason) {
+    result.errors.push_back(QStringLiteral("%1: %2").arg(item, reason));
+  };
+  // Counts one removed item; false once the caller asked to stop.
+  auto removed = [&](quint64 bytes) {
+    ++result.removed.items;
+    result.removed.bytes += bytes;
+    if (progress && result.removed.items % kProgressInterval == 0 &&
+        !progress(result.removed)) {
+      result.canceled = true;
+    }
+    return !result.canceled;
+  };
+  // Anything but a real folder; links are removed, not followed.
+  auto removeEntry = [&](const QFileInfo &info) {
+    const quint64 bytes =
+        info.isSymLink() ? 0 : static_cast<quint64>(info.size());
+    QFile file(info.filePath());
+    if (!file.remove()) {
+      fail(info.filePath(), file.errorString());
+      return false;
+    }
+    removed(bytes);
+    return true;
+  };
+
+  const QFileInfo top(path);
+  if (!top.isDir() || top.isSymLink()) {
+    if (!top.exists() && !top.isSymLink()) {
+      fail(path, QObject::tr("not found"));
+    } else {
+      removeEntry(top);
+    }
+  } else {
+    struct Folder {
+      QString path;
+      size_t parent = 0; // Index in `stack`; the parent stays below
+      bool listed = false;
+      bool failed = false; // Something below it was left in place
+    };
+
+    // Files are removed as a folder is listed; its subfolders are pushed
+    // above it, so it is removed once they have been popped.
+    std::vector<Folder> stack{{path}};
+    while (!stack.empty() && !result.canceled) {
+      const size_t index = stack.size() - 1;
+      if (!stack[index].listed) {
+        stack[index].listed = true;
+        const QFileInfoList entries =
+            QDir(stack[index].path).entryInfoList(kEntries, QDir::NoSort);
+        for (const QFileInfo &entry : entries) {
+          if (result.canceled) {
+            break;
+          }
+          if (entry.isDir() && !entry.isSymLink()) {
+            stack.push_back({entry.filePath(), index});
+          } else if (!removeEntry(entry)) {
+            stack[index].failed = true;
+          }
+        }
+        continue;
+      }
+
+      const Folder folder = stack.back();
+      stack.pop_back();
+      bool kept = folder.failed;
+      if (!kept) {
+        kept = !QDir().rmdir(folder.path);
+        if (kept) {
+          fail(folder.path, QObject::tr("could not remove folder"));
+        } else {
+          removed(0);
+        }
+      }
+      if (kept && !stack.empty()) {
+        stack[folder.parent].failed = true;
+      }
+    }
+  }
+
+  if (progress && !result.canceled) {
+    progress(result.removed);
+  }
+  return result;
+}
+
+} // namespace FileRemover
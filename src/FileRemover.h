@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+namespace FileRemover {
+
+struct Progress {
+  quint64 items = 0; // Files, links and folders removed
+  quint64 bytes = 0; // Sizes of the removed files
+};
+
+struct Result {
+  Progress removed;
+  QStringList errors; // "path: reason" per item that was left in place
+  bool canceled = false;
+};
+
+// Remove `path`: a file, a symbolic link (never its target) or a folder
+// with everything below it, deepest first. Items that cannot be removed
+// are reported and skipped, as are the folders that still contain them.
+// `progress` gets the totals so far every few hundred items and returns
+// false to stop; whatever was removed by then stays removed.
+Result remove(const QString &path,
+              const std::function<bool(const Progress &)> &progress = {});
+
+} // namespace FileRemover
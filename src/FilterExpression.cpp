@@ -0,0 +1,468 @@
+#include "FilterExpression.h"
+
+#include <QObject>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "TaskScheduler.h"
+
+namespace {
+
+enum class Field { Size, Depth, Name, Ext, IsDir, IsFile };
+enum class CompareOp { Eq, Ne, Lt, Le, Gt, Ge, Glob };
+
+} // namespace
+
+struct FilterExpression::Node {
+  enum class Kind { And, Or, Not, Compare, Flag };
+
+  Kind kind = Kind::Flag;
+  std::unique_ptr<Node> left;
+  std::unique_ptr<Node> right;
+  Field field = Field::IsDir;
+  CompareOp op = CompareOp::Eq;
+  quint64 number = 0;
+  QString text;
+};
+
+namespace {
+
+using Node = FilterExpression::Node;
+
+// Fills out[0, end - begin) for rows [begin, end).
+using Kernel = std::function<void(size_t begin, size_t end, quint8 *out)>;
+
+constexpr size_t kBatchRows = 64 * 1024;
+
+struct Token {
+  enum class Type { End, Ident, Number, String, Op, And, Or, Not, Open, Close };
+
+  Type type = Type::End;
+  QString text;
+  quint64 number = 0;
+  CompareOp op = CompareOp::Eq;
+  qsizetype pos = 0;
+};
+
+bool tokenize(const QString &text, std::vector<Token> *tokens,
+              QString *errorOut) {
+  auto fail = [errorOut](qsizetype pos, const QString &message) {
+    if (errorOut) {
+      *errorOut = QObject::tr("Column %1: %2").arg(pos + 1).arg(message);
+    }
+    return false;
+  };
+
+  qsizetype i = 0;
+  const qsizetype n = text.size();
+  while (i < n) {
+    const QChar c = text[i];
+    if (c.isSpace()) {
+      ++i;
+      continue;
+    }
+
+    Token token;
+    token.pos = i;
+    auto twoChars = [&](const char *pair) {
+      return i + 1 < n && text[i] == QLatin1Char(pair[0]) &&
+             text[i + 1] == QLatin1Char(pair[1]);
+    };
+
+    if (twoChars("&&")) {
+      token.type = Token::Type::And;
+      i += 2;
+    } else if (twoChars("||")) {
+      token.type = Token::Type::Or;
+      i += 2;
+    } else if (twoChars("==") || twoChars("!=") || twoChars("<=") ||
+               twoChars(">=")) {
+      token.type = Token::Type::Op;
+      const QChar first = text[i];
+      token.op = first == QLatin1Char('=')   ? CompareOp::Eq
+                 : first == QLatin1Char('!') ? CompareOp::Ne
+                 : first == QLatin1Char('<') ? CompareOp::Le
+                                             : CompareOp::Ge;
+      i += 2;
+    } else if (c == QLatin1Char('<') || c == QLatin1Char('>') ||
+               c == QLatin1Char('~')) {
+      token.type = Token::Type::Op;
+      token.op = c == QLatin1Char('<')   ? CompareOp::Lt
+                 : c == QLatin1Char('>') ? CompareOp::Gt
+                                         : CompareOp::Glob;
+      ++i;
+    } else if (c == QLatin1Char('!')) {
+      token.type = Token::Type::Not;
+      ++i;
+    } else if (c == QLatin1Char('(')) {
+      token.type = Token::Type::Open;
+      ++i;
+    } else if (c == QLatin1Char(')')) {
+      token.type = Token::Type::Close;
+      ++i;
+    } else if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+      const qsizetype close = text.indexOf(c, i + 1);
+      if (close < 0) {
+        return fail(i, QObject::tr("unterminated string"));
+      }
+      token.type = Token::Type::String;
+      token.text = text.mid(i + 1, close - i - 1);
+      i = close + 1;
+    } else if (c.isDigit() || c == QLatin1Char('.')) {
+      qsizetype end = i;
+      while (end < n &&
+             (text[end].isDigit() || text[end] == QLatin1Char('.'))) {
+        ++end;
+      }
+      bool ok = false;
+      const double value = text.mid(i, end - i).toDouble(&ok);
+      if (!ok) {
+        return fail(i, QObject::tr("invalid number"));
+      }
+
+      double multiplier = 1.0;
+      if (end < n) {
+        const QChar suffix = text[end].toUpper();
+        const QString units = QStringLiteral("KMGT");
+        const qsizetype unit = units.indexOf(suffix);
+        if (unit >= 0) {
+          multiplier = std::pow(1024.0, static_cast<double>(unit + 1));
+          ++end;
+          if (end < n && text[end].toUpper() == QLatin1Char('B')) {
+            ++end;
+          }
+        } else if (suffix == QLatin1Char('B')) {
+          ++end;
+        }
+      }
+      if (end < n && text[end].isLetterOrNumber()) {
+        return fail(end, QObject::tr("unknown size unit"));
+      }
+
+      token.type = Token::Type::Number;
+      token.number = static_cast<quint64>(std::llround(value * multiplier));
+      i = end;
+    } else if (c.isLetter() || c == QLatin1Char('_')) {
+      qsizetype end = i;
+      while (end < n && (text[end].isLetterOrNumber() ||
+                         text[end] == QLatin1Char('_') ||
+                         text[end] == QLatin1Char('.') ||
+                         text[end] == QLatin1Char('*') ||
+                         text[end] == QLatin1Char('?'))) {
+        ++end;
+      }
+      token.type = Token::Type::Ident;
+      token.text = text.mid(i, end - i);
+      i = end;
+    } else {
+      return fail(i, QObject::tr("unexpected '%1'").arg(c));
+    }
+    tokens->push_back(token);
+  }
+
+  Token end;
+  end.pos = n;
+  tokens->push_back(end);
+  return true;
+}
+
+class Parser {
+public:
+  Parser(const std::vector<Token> &tokens, QString *errorOut)
+      : tokens(tokens), errorOut(errorOut) {}
+
+  std::unique_ptr<Node> parseAll() {
+    std::unique_ptr<Node> node = parseOr();
+    if (node && peek().type != Token::Type::End) {
+      return fail(QObject::tr("unexpected input"));
+    }
+    return node;
+  }
+
+private:
+  const Token &peek() const { return tokens[index]; }
+  const Token &take() { return tokens[index++]; }
+
+  std::unique_ptr<Node> fail(const QString &message) {
+    if (errorOut) {
+      *errorOut = QObject::tr("Column %1: %2").arg(peek().pos + 1).arg(message);
+    }
+    return nullptr;
+  }
+
+  static std::unique_ptr<Node> combine(Node::Kind kind,
+                                       std::unique_ptr<Node> left,
+                                       std::unique_ptr<Node> right) {
+    auto node = std::make_unique<Node>();
+    node->kind = kind;
+    node->left = std::move(left);
+    node->right = std::move(right);
+    return node;
+  }
+
+  std::unique_ptr<Node> parseOr() {
+    std::unique_ptr<Node> node = parseAnd();
+    while (node && peek().type == Token::Type::Or) {
+      take();
+      std::unique_ptr<Node> right = parseAnd();
+      if (!right) {
+        return nullptr;
+      }
+      node = combine(Node::Kind::Or, std::move(node), std::move(right));
+    }
+    return node;
+  }
+
+  std::unique_ptr<Node> parseAnd() {
+    std::unique_ptr<Node> node = parseUnary();
+    while (node && peek().type == Token::Type::And) {
+      take();
+      std::unique_ptr<Node> right = parseUnary();
+      if (!right) {
+        return nullptr;
+      }
+      node = combine(Node::Kind::And, std::move(node), std::move(right));
+    }
+    return node;
+  }
+
+  std::unique_ptr<Node> parseUnary() {
+    if (peek().type == Token::Type::Not) {
+      take();
+      std::unique_ptr<Node> operand = parseUnary();
+      if (!operand) {
+        return nullptr;
+      }
+      return combine(Node::Kind::Not, std::move(operand), nullptr);
+    }
+    if (peek().type == Token::Type::Open) {
+      take();
+      std::unique_ptr<Node> inner = parseOr();
+      if (!inner) {
+        return nullptr;
+      }
+      if (peek().type != Token::Type::Close) {
+        return fail(QObject::tr("expected ')'"));
+      }
+      take();
+      return inner;
+    }
+    return parseComparison();
+  }
+
+  std::unique_ptr<Node> parseComparison() {
+    if (peek().type != Token::Type::Ident) {
+      return fail(QObject::tr("expected a field name"));
+    }
+
+    const QString name = peek().text.toLower();
+    auto node = std::make_unique<Node>();
+    if (name == QLatin1String("size")) {
+      node->field = Field::Size;
+    } else if (name == QLatin1String("depth")) {
+      node->field = Field::Depth;
+    } else if (name == QLatin1String("name")) {
+      node->field = Field::Name;
+    } else if (name == QLatin1String("ext")) {
+      node->field = Field::Ext;
+    } else if (name == QLatin1String("isdir")) {
+      node->field = Field::IsDir;
+    } else if (name == QLatin1String("isfile")) {
+      node->field = Field::IsFile;
+    } else {
+      return fail(QObject::tr("unknown field '%1'").arg(peek().text));
+    }
+    take();
+
+    if (node->field == Field::IsDir || node->field == Field::IsFile) {
+      node->kind = Node::Kind::Flag;
+      return node;
+    }
+
+    node->kind = Node::Kind::Compare;
+    if (peek().type != Token::Type::Op) {
+      return fail(QObject::tr("expected a comparison"));
+    }
+    node->op = take().op;
+
+    const bool numeric =
+        node->field == Field::Size || node->field == Field::Depth;
+    if (numeric) {
+      if (node->op == CompareOp::Glob) {
+        return fail(QObject::tr("'~' needs a name or ext field"));
+      }
+      if (peek().type != Token::Type::Number) {
+        return fail(QObject::tr("expected a number"));
+      }
+      node->number = take().number;
+      return node;
+    }
+
+    if (node->op != CompareOp::Eq && node->op != CompareOp::Ne &&
+        node->op != CompareOp::Glob) {
+      return fail(QObject::tr("names only support ==, != and ~"));
+    }
+    if (peek().type != Token::Type::String &&
+        peek().type != Token::Type::Ident) {
+      return fail(QObject::tr("expected a string"));
+    }
+    node->text = take().text;
+    if (node->field == Field::Ext && node->text.startsWith(QLatin1Char('.'))) {
+      node->text.remove(0, 1);
+    }
+    return node;
+  }
+
+  const std::vector<Token> &tokens;
+  QString *errorOut = nullptr;
+  size_t index = 0;
+};
+
+template <typename T, typename Pred>
+Kernel scanColumn(const T *column, Pred pred) {
+  return [column, pred](size_t begin, size_t end, quint8 *out) {
+    for (size_t i = begin; i < end; ++i) {
+      out[i - begin] = pred(column[i]) ? 1 : 0;
+    }
+  };
+}
+
+template <typename T>
+Kernel compareColumn(const T *column, CompareOp op, quint64 value) {
+  switch (op) {
+  case CompareOp::Eq:
+    return scanColumn(column, [value](quint64 v) { return v == value; });
+  case CompareOp::Ne:
+    return scanColumn(column, [value](quint64 v) { return v != value; });
+  case CompareOp::Lt:
+    return scanColumn(column, [value](quint64 v) { return v < value; });
+  case CompareOp::Le:
+    return scanColumn(column, [value](quint64 v) { return v <= value; });
+  case CompareOp::Gt:
+    return scanColumn(column, [value](quint64 v) { return v > value; });
+  case CompareOp::Ge:
+  default:
+    return scanColumn(column, [value](quint64 v) { return v >= value; });
+  }
+}
+
+QRegularExpression globPattern(const QString &glob) {
+  return QRegularExpression(
+      QRegularExpression::wildcardToRegularExpression(glob),
+      QRegularExpression::CaseInsensitiveOption);
+}
+
+Kernel compile(const Node &node, const NodeTable &table) {
+  switch (node.kind) {
+  case Node::Kind::And:
+  case Node::Kind::Or: {
+    const Kernel left = compile(*node.left, table);
+    const Kernel right = compile(*node.right, table);
+    const bool isAnd = node.kind == Node::Kind::And;
+    return [left, right, isAnd](size_t begin, size_t end, quint8 *out) {
+      left(begin, end, out);
+      std::vector<quint8> other(end - begin);
+      right(begin, end, other.data());
+      for (size_t i = 0; i < other.size(); ++i) {
+        out[i] = isAnd ? (out[i] & other[i]) : (out[i] | other[i]);
+      }
+    };
+  }
+  case Node::Kind::Not: {
+    const Kernel operand = compile(*node.left, table);
+    return [operand](size_t begin, size_t end, quint8 *out) {
+      operand(begin, end, out);
+      for (size_t i = 0; i < end - begin; ++i) {
+        out[i] ^= 1;
+      }
+    };
+  }
+  case Node::Kind::Flag: {
+    const bool wantDir = node.field == Field::IsDir;
+    return scanColumn(table.dirFlags.data(),
+                      [wantDir](quint8 v) { return (v != 0) == wantDir; });
+  }
+  case Node::Kind::Compare:
+    break;
+  }
+
+  switch (node.field) {
+  case Field::Size:
+    return compareColumn(table.sizes.data(), node.op, node.number);
+  case Field::Depth:
+    return compareColumn(table.depths.data(), node.op, node.number);
+  case Field::Ext: {
+    // Resolve against the few distinct extensions once, then compare ids.
+    std::vector<quint8> matching(
+        static_cast<size_t>(table.extensionNames.size()), 0);
+    const QRegularExpression pattern = globPattern(node.text);
+    for (qsizetype id = 0; id < table.extensionNames.size(); ++id) {
+      const QString &extension = table.extensionNames[id];
+      const bool hit =
+          node.op == CompareOp::Glob
+              ? pattern.match(extension).hasMatch()
+              : extension.compare(node.text, Qt::CaseInsensitive) == 0;
+      matching[static_cast<size_t>(id)] =
+          (node.op == CompareOp::Ne ? !hit : hit) ? 1 : 0;
+    }
+    return scanColumn(table.extensions.data(),
+                      [matching = std::move(matching)](quint32 id) {
+                        return matching[id] != 0;
+                      });
+  }
+  case Field::Name:
+  default: {
+    const QString text = node.text;
+    const CompareOp op = node.op;
+    const QRegularExpression pattern = globPattern(text);
+    return scanColumn(table.nodes.data(),
+                      [text, op, pattern](const TreeNode *n) {
+                        if (op == CompareOp::Glob) {
+                          return pattern.match(n->name).hasMatch();
+                        }
+                        const bool equal =
+                            n->name.compare(text, Qt::CaseInsensitive) == 0;
+                        return op == CompareOp::Ne ? !equal : equal;
+                      });
+  }
+  }
+}
+
+} // namespace
+
+FilterExpression::~FilterExpression() = default;
+
+std::unique_ptr<FilterExpression>
+FilterExpression::parse(const QString &text, QString *errorOut) {
+  std::vector<Token> tokens;
+  if (!tokenize(text, &tokens, errorOut)) {
+    return nullptr;
+  }
+
+  Parser parser(tokens, errorOut);
+  std::unique_ptr<Node> root = parser.parseAll();
+  if (!root) {
+    return nullptr;
+  }
+
+  std::unique_ptr<FilterExpression> expression(new FilterExpression());
+  expression->root = std::move(root);
+  return expression;
+}
+
+std::vector<quint8> FilterExpression::evaluate(const NodeTable &table) const {
+  const size_t rows = table.rowCount();
+  std::vector<quint8> mask(rows, 0);
+  if (!root || rows == 0) {
+    return mask;
+  }
+
+  const Kernel kernel = compile(*root, table);
+  TaskScheduler::parallelFor(rows, kBatchRows, [&](size_t begin, size_t end) {
+    kernel(begin, end, mask.data() + begin);
+  });
+  return mask;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+
+// Small boolean filter language over node columns, for example
+//   size > 1G && ext == "iso"
+//   depth <= 4 && !isDir
+//   name ~ "*.log" || (isFile && size >= 100M)
+// Fields are size, depth, name, ext, isDir and isFile. Sizes accept K, M,
+// G and T suffixes (powers of 1024). `~` matches a glob, ignoring case, as
+// do == and != on names and extensions.
+class FilterExpression {
+public:
+  struct Node;
+
+  ~FilterExpression();
+
+  // Parse `text` once; returns null and sets `errorOut` on syntax errors.
+  static std::unique_ptr<FilterExpression> parse(const QString &text,
+                                                 QString *errorOut);
+
+  // One byte per row of `table`, 1 where the expression holds. The
+  // expression is compiled to column kernels and run over batches of rows
+  // in parallel.
+  std::vector<quint8> evaluate(const NodeTable &table) const;
+
+private:
+  FilterExpression() = default;
+
+  std::unique_ptr<Node> root;
+};
@@ -0,0 +1,54 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+FrameStats::FrameStats(int capacity)
+    : samples(static_cast<size_t>(std::max(capacity, 1))) {}
+
+void FrameStats::add(double value) {
+  samples[static_cast<size_t>(next)] = value;
+  next = (next + 1) % static_cast<int>(samples.size());
+  filled = std::min(filled + 1, static_cast<int>(samples.size()));
+}
+
+void FrameStats::clear() {
+  next = 0;
+  filled = 0;
+}
+
+double FrameStats::last() const {
+  if (filled == 0) {
+    return 0.0;
+  }
+  const int size = static_cast<int>(samples.size());
+  return samples[static_cast<size_t>((next + size - 1) % size)];
+}
+
+// Until the window wraps, the samples are the first `filled` slots; after
+// that every slot is in use, so the order inside the window never matters.
+double FrameStats::min() const {
+  if (filled == 0) {
+    return 0.0;
+  }
+  return *std::min_element(samples.begin(), samples.begin() + filled);
+}
+
+double FrameStats::average() const {
+  if (filled == 0) {
+    return 0.0;
+  }
+  return std::accumulate(samples.begin(), samples.begin() + filled, 0.0) /
+         filled;
+}
+
+double FrameStats::percentile95() const {
+  if (filled == 0) {
+    return 0.0;
+  }
+  std::vector<double> sorted(samples.begin(), samples.begin() + filled);
+  const auto rank = static_cast<size_t>(std::ceil(0.95 * filled)) - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
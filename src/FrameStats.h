@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+// The most recent samples of a per-frame measurement, such as raster time in
+// milliseconds. Older samples are overwritten once the window is full.
+class FrameStats {
+public:
+  explicit FrameStats(int capacity = 120);
+
+  void add(double value);
+  void clear();
+
+  int count() const { return filled; }
+  // All 0 while empty.
+  double last() const;
+  double min() const;
+  double average() const;
+  // Nearest-rank 95th percentile of the window.
+  double percentile95() const;
+
+private:
+  std::vector<double> samples;
+  int next = 0;
+  int filled = 0;
+};
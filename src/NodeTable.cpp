@@ -0,0 +1,272 @@
+#include "NodeTable.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "TaskScheduler.h"
+
+namespace {
+
+// Rows per parallel work item when scanning a subtree.
+constexpr quint32 kChunkRows = 64 * 1024;
+
+// rowsById entry of an id that has no row in the table.
+constexpr quint32 kNoRow = std::numeric_limits<quint32>::max();
+
+size_t chunkCount(quint32 rows, quint32 chunkRows) {
+  return (static_cast<size_t>(rows) + chunkRows - 1) / chunkRows;
+}
+
+// Keep the `count` largest rows in a min-heap ordered by size.
+class TopHeap {
+public:
+  TopHeap(const std::vector<quint64> &sizes, int count)
+      : sizes(&sizes), count(static_cast<size_t>(std::max(0, count))) {}
+
+  void offer(quint32 row) {
+    if (count == 0) {
+      return;
+    }
+    if (rows.size() < count) {
+      rows.push_back(row);
+      std::push_heap(rows.begin(), rows.end(), greater());
+    } else if ((*sizes)[row] > (*sizes)[rows.front()]) {
+      std::pop_heap(rows.begin(), rows.end(), greater());
+      rows.back() = row;
+      std::push_heap(rows.begin(), rows.end(), greater());
+    }
+  }
+
+  std::vector<quint32> sorted() const {
+    std::vector<quint32> result = rows;
+    std::sort(result.begin(), result.end(), greater());
+    return result;
+  }
+
+  std::vector<quint32> rows;
+
+private:
+  // Larger size first; ties keep depth-first order.
+  auto greater() const {
+    const std::vector<quint64> *s = sizes;
+    return [s](quint32 a, quint32 b) {
+      return (*s)[a] != (*s)[b] ? (*s)[a] > (*s)[b] : a < b;
+    };
+  }
+
+  const std::vector<quint64> *sizes;
+  size_t count;
+};
+
+} // namespace
+
+std::shared_ptr<NodeTable> NodeTable::create(TreeNode *root,
+                                             bool numberRows) {
+  auto table = std::make_shared<NodeTable>();
+  table->extensionNames.push_back(QString());
+  table->extensionIds.insert(QString(), 0);
+  if (!root) {
+    return table;
+  }
+
+  struct Pending {
+    TreeNode *node = nullptr;
+    quint32 parent = 0;
+    quint16 depth = 0;
+  };
+
+  // Rows are appended in pre-order; a row's subtree ends where the next
+  // row that is not its descendant starts, so close rows when popping back.
+  std::vector<Pending> pending{{root, 0, 0}};
+  std::vector<quint32> open;
+  while (!pending.empty()) {
+    const Pending current = pending.back();
+    pending.pop_back();
+
+    const auto row = static_cast<quint32>(table->nodes.size());
+    while (!open.empty() && table->depths[open.back()] >= current.depth) {
+      table->subtreeEnd[open.back()] = row;
+      open.pop_back();
+    }
+
+    TreeNode *node = current.node;
+    quint32 extension = 0;
+    if (!node->isDir) {
+      const QString key = extensionOf(node->name);
+      auto it = table->extensionIds.constFind(key);
+      if (it == table->extensionIds.constEnd()) {
+        extension = static_cast<quint32>(table->extensionNames.size());
+        table->extensionNames.push_back(key);
+        table->extensionIds.insert(key, extension);
+      } else {
+        extension = it.value();
+      }
+    }
+
+    if (numberRows) {
+      node->id = row;
+    }
+    if (node->id >= table->rowsById.size()) {
+      table->rowsById.resize(node->id + 1, kNoRow);
+    }
+    table->rowsById[node->id] = row;
+    table->nodes.push_back(node);
+    table->sizes.push_back(node->size);
+    table->parents.push_back(current.parent);
+    table->subtreeEnd.push_back(row + 1);
+    table->depths.push_back(current.depth);
+    table->dirFlags.push_back(node->isDir ? 1 : 0);
+    table->extensions.push_back(extension);
+    open.push_back(row);
+
+    const quint16 childDepth = static_cast<quint16>(
+        std::min<int>(current.depth + 1, std::numeric_limits<quint16>::max()));
+    for (auto it = node->children.crbegin(); it != node->children.crend();
+         ++it) {
+      if (*it) {
+        pending.push_back({*it, row, childDepth});
+      }
+    }
+  }
+
+  const auto rows = static_cast<quint32>(table->nodes.size());
+  for (quint32 row : open) {
+    table->subtreeEnd[row] = rows;
+  }
+  return table;
+}
+
+std::shared_ptr<const NodeTable> NodeTable::build(TreeNode *root) {
+  return create(root, true);
+}
+
+std::shared_ptr<const NodeTable>
+NodeTable::build(std::shared_ptr<const TreeModel> model) {
+  std::shared_ptr<NodeTable> table =
+      create(model ? model->root() : nullptr, false);
+  table->model = std::move(model);
+  return table;
+}
+
+int NodeTable::extensionId(const QString &extension) const {
+  const auto it = extensionIds.constFind(extension.toLower());
+  return it == extensionIds.constEnd() ? -1 : static_cast<int>(it.value());
+}
+
+qint64 NodeTable::rowOf(const TreeNode *node) const {
+  if (!node || node->id >= rowsById.size()) {
+    return -1;
+  }
+  const quint32 row = rowsById[node->id];
+  if (row == kNoRow || nodes[row] != node) {
+    return -1;
+  }
+  return row;
+}
+
+NodeTable::TopItems
+NodeTable::largestItems(quint32 row, int count,
+                        const TaskScheduler::CancelToken &cancel) const {
+  TopItems result;
+  if (row >= nodes.size()) {
+    return result;
+  }
+
+  struct Partial {
+    std::vector<quint32> files;
+    std::vector<quint32> folders;
+  };
+
+  // One partial per chunk, merged in row order so ties always break the same
+  // way whatever the thread count.
+  const quint32 begin = row + 1;
+  const quint32 rows = subtreeEnd[row] - std::min(begin, subtreeEnd[row]);
+  std::vector<Partial> partials(chunkCount(rows, kChunkRows));
+  TaskScheduler::parallelFor(
+      rows, kChunkRows, [&](size_t first, size_t last) {
+        TopHeap files(sizes, count);
+        TopHeap folders(sizes, count);
+        for (size_t r = begin + first; r < begin + last; ++r) {
+          (dirFlags[r] ? folders : files).offer(static_cast<quint32>(r));
+        }
+        partials[first / kChunkRows] = Partial{files.rows, folders.rows};
+      },
+      TaskScheduler::Priority::Normal, cancel);
+
+  TopHeap files(sizes, count);
+  TopHeap folders(sizes, count);
+  for (const Partial &part : partials) {
+    for (quint32 r : part.files) {
+      files.offer(r);
+    }
+    for (quint32 r : part.folders) {
+      folders.offer(r);
+    }
+  }
+  result.files = files.sorted();
+  result.folders = folders.sorted();
+  return result;
+}
+
+std::vector<NodeTable::ExtensionTotal>
+NodeTable::extensionTotals(quint32 row,
+                           const TaskScheduler::CancelToken &cancel) const {
+  std::vector<ExtensionTotal> result;
+  if (row >= nodes.size()) {
+    return result;
+  }
+
+  // Every partial is as long as the extension list, so use a few chunks per
+  // thread rather than many small ones.
+  const quint32 begin = row + 1;
+  const quint32 rows = subtreeEnd[row] - std::min(begin, subtreeEnd[row]);
+  const auto parts = static_cast<quint32>(TaskScheduler::threadCount() * 4);
+  const quint32 chunkRows = std::max(kChunkRows, rows / parts + 1);
+  const size_t extensionCount = static_cast<size_t>(extensionNames.size());
+
+  using Partial = std::vector<ExtensionTotal>;
+  std::vector<Partial> partials(chunkCount(rows, chunkRows));
+  TaskScheduler::parallelFor(
+      rows, chunkRows, [&](size_t first, size_t last) {
+        Partial part(extensionCount);
+        for (size_t r = begin + first; r < begin + last; ++r) {
+          if (!dirFlags[r]) {
+            ExtensionTotal &total = part[extensions[r]];
+            total.bytes += sizes[r];
+            ++total.files;
+          }
+        }
+        partials[first / chunkRows] = std::move(part);
+      },
+      TaskScheduler::Priority::Normal, cancel);
+
+  Partial merged(extensionCount);
+  for (const Partial &part : partials) {
+    // Skipped chunks of a canceled call stay empty.
+    for (size_t i = 0; i < part.size(); ++i) {
+      merged[i].bytes += part[i].bytes;
+      merged[i].files += part[i].files;
+    }
+  }
+
+  for (size_t i = 0; i < merged.size(); ++i) {
+    if (merged[i].files > 0) {
+      merged[i].extension = static_cast<quint32>(i);
+      result.push_back(merged[i]);
+    }
+  }
+  std::sort(result.begin(), result.end(),
+            [](const ExtensionTotal &a, const ExtensionTotal &b) {
+              return a.bytes != b.bytes ? a.bytes > b.bytes
+                                        : a.extension < b.extension;
+            });
+  return result;
+}
+
+QString NodeTable::extensionOf(const QString &name) {
+  const qsizetype dot = name.lastIndexOf(QLatin1Char('.'));
+  if (dot <= 0 || dot == name.size() - 1) {
+    return QString();
+  }
+  return name.mid(dot + 1).toLower();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+#include "TaskScheduler.h"
+#include "TreeModel.h"
+
+// Column-oriented copy of the per-node data that searches and filters look
+// at, one row per node in depth-first pre-order. A node's subtree is the row
+// range [row, subtreeEnd[row]).
+class NodeTable {
+public:
+  // Largest items of a subtree as rows, largest first.
+  struct TopItems {
+    std::vector<quint32> files;
+    std::vector<quint32> folders;
+  };
+
+  // Bytes and file count of one extension.
+  struct ExtensionTotal {
+    quint32 extension = 0; // Index into extensionNames
+    quint64 bytes = 0;
+    quint64 files = 0;
+  };
+
+  // Also stores each node's row in TreeNode::id, so the tree must not be
+  // part of a shared model.
+  static std::shared_ptr<const NodeTable> build(TreeNode *root);
+  // Also keeps `model` alive for as long as the table, so jobs holding the
+  // table see one consistent version of it.
+  static std::shared_ptr<const NodeTable>
+  build(std::shared_ptr<const TreeModel> model);
+
+  size_t rowCount() const { return nodes.size(); }
+
+  // Row of `node`, or -1 if it is not part of this table.
+  qint64 rowOf(const TreeNode *node) const;
+
+  // The `count` largest files and folders strictly below `row`, reduced in
+  // parallel from bounded per-chunk heaps. A canceled call returns partial
+  // results that the caller is expected to drop.
+  TopItems largestItems(quint32 row, int count,
+                        const TaskScheduler::CancelToken &cancel = {}) const;
+
+  // Totals per extension of the files below `row`, largest first. Chunks
+  // sum into arrays indexed by extension id that are added up at the end.
+  std::vector<ExtensionTotal>
+  extensionTotals(quint32 row,
+                  const TaskScheduler::CancelToken &cancel = {}) const;
+
+  // Extension id of `extension` (lowercase, no dot), or -1 if no node has
+  // it. Id 0 stands for "no extension".
+  int extensionId(const QString &extension) const;
+
+  // Lowercase extension of a file name, empty if it has none.
+  static QString extensionOf(const QString &name);
+
+  std::shared_ptr<const TreeModel> model; // Null if built from a bare tree
+  std::vector<TreeNode *> nodes;
+  std::vector<quint64> sizes;
+  std::vector<quint32> parents; // Row of the parent; 0 for the root itself
+  std::vector<quint32> subtreeEnd;
+  std::vector<quint16> depths;
+  std::vector<quint8> dirFlags;
+  std::vector<quint32> extensions; // Index into extensionNames
+  QStringList extensionNames;      // extensionNames[0] is empty
+
+private:
+  static std::shared_ptr<NodeTable> create(TreeNode *root, bool numberRows);
+
+  std::vector<quint32> rowsById; // Row of each TreeNode::id
+
+  QHash<QString, quint32> extensionIds;
+};
@@ -0,0 +1,103 @@
+#include "OverviewWidget.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+
+#include "CanvasWidget.h"
+
+OverviewWidget::OverviewWidget(CanvasWidget *canvas, QWidget *parent)
+    : QWidget(parent), canvas(canvas) {
+  setMinimumSize(120, 80);
+  setCursor(Qt::PointingHandCursor);
+}
+
+QSize OverviewWidget::sizeHint() const { return QSize(240, 160); }
+
+void OverviewWidget::setModel(std::shared_ptr<TreeModel> newModel) {
+  model = std::move(newModel);
+  focusNode = nullptr;
+  invalidate();
+}
+
+void OverviewWidget::setFocusNode(TreeNode *node) {
+  if (focusNode != node) {
+    focusNode = node;
+    update();
+  }
+}
+
+void OverviewWidget::invalidate() {
+  dirty = true;
+  update();
+}
+
+void OverviewWidget::resizeEvent(QResizeEvent *event) {
+  QWidget::resizeEvent(event);
+  invalidate();
+}
+
+void OverviewWidget::paintEvent(QPaintEvent *event) {
+  Q_UNUSED(event);
+  QPainter painter(this);
+  painter.fillRect(rect(), Qt::black);
+
+  if (!model || !model->root() || !canvas) {
+    return;
+  }
+
+  // Rendering happens lazily, so a hidden dock costs nothing.
+  if (dirty) {
+    folderRects.clear();
+    cachedImage = canvas->renderOverview(size(), &folderRects);
+    dirty = false;
+  }
+  painter.drawImage(0, 0, cachedImage);
+
+  if (!focusNode || focusNode == model->root()) {
+    return;
+  }
+
+  // Folders below one overview pixel are not recorded; mark the nearest
+  // ancestor that is.
+  for (TreeNode *cur = focusNode; cur; cur = model->parentOf(cur)) {
+    auto it = folderRects.constFind(cur);
+    if (it != folderRects.constEnd()) {
+      const QRectF marker = toWidgetRect(it.value());
+      painter.fillRect(marker, QColor(255, 255, 0, 64));
+      painter.setPen(QPen(Qt::yellow, 2));
+      painter.setBrush(Qt::NoBrush);
+      painter.drawRect(marker.adjusted(1, 1, -1, -1));
+      break;
+    }
+  }
+}
+
+void OverviewWidget::mousePressEvent(QMouseEvent *event) {
+  if (!model || !model->root() || dirty) {
+    return;
+  }
+
+  const QPointF pos(event->position().x(), height() - event->position().y());
+
+  // Nested folders shrink with depth, so the smallest folder containing the
+  // point is the deepest one visible here.
+  TreeNode *target = nullptr;
+  double targetArea = 0.0;
+  for (auto it = folderRects.constBegin(); it != folderRects.constEnd();
+       ++it) {
+    const QRectF &r = it.value();
+    const double area = r.width() * r.height();
+    if (r.contains(pos) && (!target || area < targetArea)) {
+      target = it.key();
+      targetArea = area;
+    }
+  }
+
+  emit navigateRequested(target ? target : model->root());
+}
+
+QRectF OverviewWidget::toWidgetRect(const QRectF &layoutRect) const {
+  QRectF r = layoutRect;
+  r.moveTop(height() - layoutRect.y() - layoutRect.height());
+  return r;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QRectF>
+#include <QWidget>
+#include <memory>
+
+#include "TreeModel.h"
+
+class CanvasWidget;
+
+// Small navigator showing the whole model at low resolution. The image is
+// rendered once through the canvas pipeline and only redrawn when the model
+// or its appearance changes; the focus marker is painted on top of it.
+class OverviewWidget : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit OverviewWidget(CanvasWidget *canvas, QWidget *parent = nullptr);
+
+  void setModel(std::shared_ptr<TreeModel> model);
+  void setFocusNode(TreeNode *node);
+
+  // Re-render the cached image, e.g. after a palette change.
+  void invalidate();
+
+  QSize sizeHint() const override;
+
+signals:
+  void navigateRequested(TreeNode *node);
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+
+private:
+  QRectF toWidgetRect(const QRectF &layoutRect) const;
+
+  CanvasWidget *canvas = nullptr;
+  std::shared_ptr<TreeModel> model;
+  TreeNode *focusNode = nullptr;
+  QImage cachedImage;
+  QHash<TreeNode *, QRectF> folderRects;
+  bool dirty = true;
+};
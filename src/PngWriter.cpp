@@ -0,0 +1,224 @@
+#include "PngWriter.h"
+
+#include <QObject>
+
+#include <cstring>
+
+#include <zlib.h>
+
+namespace {
+
+constexpr qsizetype kIdatChunkSize = 64 * 1024;
+
+void appendBigEndian(QByteArray &out, quint32 value) {
+  out.append(static_cast<char>((value >> 24) & 0xff));
+  out.append(static_cast<char>((value >> 16) & 0xff));
+  out.append(static_cast<char>((value >> 8) & 0xff));
+  out.append(static_cast<char>(value & 0xff));
+}
+
+bool fail(QString *errorOut, const QString &message) {
+  if (errorOut) {
+    *errorOut = message;
+  }
+  return false;
+}
+
+} // namespace
+
+PngWriter::PngWriter() = default;
+
+PngWriter::~PngWriter() {
+  if (stream) {
+    deflateEnd(stream.get());
+  }
+}
+
+bool PngWriter::open(const QString &path, int width, int height,
+                     QString *errorOut) {
+  if (width <= 0 || height <= 0) {
+    return fail(errorOut, QObject::tr("Invalid image size %1x%2.")
+                              .arg(width)
+                              .arg(height));
+  }
+
+  file.setFileName(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return fail(errorOut, QObject::tr("Failed to open %1 for writing.")
+                              .arg(path));
+  }
+
+  stream = std::make_unique<z_stream>();
+  std::memset(stream.get(), 0, sizeof(z_stream));
+  if (deflateInit(stream.get(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+    stream.reset();
+    abort();
+    return fail(errorOut, QObject::tr("Failed to initialize PNG encoder."));
+  }
+
+  imageWidth = width;
+  imageHeight = height;
+  rowsWritten = 0;
+  rowBytes.resize(1 + static_cast<qsizetype>(width) * 3);
+  idat.resize(kIdatChunkSize);
+  idatUsed = 0;
+
+  static const char kSignature[] = "\x89PNG\r\n\x1a\n";
+  QByteArray header;
+  appendBigEndian(header, static_cast<quint32>(width));
+  appendBigEndian(header, static_cast<quint32>(height));
+  header.append(static_cast<char>(8)); // Bit depth
+  header.append(static_cast<char>(2)); // Truecolor RGB
+  header.append(static_cast<char>(0)); // Deflate compression
+  header.append(static_cast<char>(0)); // Adaptive filtering
+  header.append(static_cast<char>(0)); // No interlace
+
+  if (file.write(kSignature, 8) != 8 ||
+      !writeChunk("IHDR", header.constData(), header.size())) {
+    abort();
+    return fail(errorOut, QObject::tr("Failed to write %1.").arg(path));
+  }
+  return true;
+}
+
+bool PngWriter::writeRows(const QImage &rows, QString *errorOut) {
+  if (!stream) {
+    return fail(errorOut, QObject::tr("PNG encoder is not open."));
+  }
+  if (rows.width() != imageWidth ||
+      rowsWritten + rows.height() > imageHeight) {
+    return fail(errorOut, QObject::tr("Rows do not fit the PNG image."));
+  }
+
+  const QImage rgb = rows.format() == QImage::Format_RGB32
+                         ? rows
+                         : rows.convertToFormat(QImage::Format_RGB32);
+
+  auto *dst = reinterpret_cast<unsigned char *>(rowBytes.data());
+  for (int y = 0; y < rgb.height(); ++y) {
+    const auto *src = reinterpret_cast<const QRgb *>(rgb.constScanLine(y));
+
+    // Filter type 1 (Sub) stores each byte as the difference to the pixel on
+    // its left; flat runs of color become zeros that deflate very well.
+    dst[0] = 1;
+    unsigned char prevR = 0;
+    unsigned char prevG = 0;
+    unsigned char prevB = 0;
+    for (int x = 0; x < imageWidth; ++x) {
+      const auto r = static_cast<unsigned char>(qRed(src[x]));
+      const auto g = static_cast<unsigned char>(qGreen(src[x]));
+      const auto b = static_cast<unsigned char>(qBlue(src[x]));
+      dst[1 + 3 * x] = static_cast<unsigned char>(r - prevR);
+      dst[2 + 3 * x] = static_cast<unsigned char>(g - prevG);
+      dst[3 + 3 * x] = static_cast<unsigned char>(b - prevB);
+      prevR = r;
+      prevG = g;
+      prevB = b;
+    }
+
+    stream->next_in = dst;
+    stream->avail_in = static_cast<uInt>(rowBytes.size());
+    if (!deflatePending(Z_NO_FLUSH)) {
+      return fail(errorOut, QObject::tr("Failed to compress PNG data."));
+    }
+  }
+
+  rowsWritten += rgb.height();
+  return true;
+}
+
+bool PngWriter::finish(QString *errorOut) {
+  if (!stream) {
+    return fail(errorOut, QObject::tr("PNG encoder is not open."));
+  }
+  if (rowsWritten != imageHeight) {
+    return fail(errorOut, QObject::tr("Only %1 of %2 rows were written.")
+                              .arg(rowsWritten)
+                              .arg(imageHeight));
+  }
+
+  stream->next_in = nullptr;
+  stream->avail_in = 0;
+  const bool compressed = deflatePending(Z_FINISH);
+  deflateEnd(stream.get());
+  stream.reset();
+
+  if (!compressed || !writeChunk("IEND", nullptr, 0)) {
+    abort();
+    return fail(errorOut, QObject::tr("Failed to write %1.")
+                              .arg(file.fileName()));
+  }
+
+  file.close();
+  if (file.error() != QFileDevice::NoError) {
+    return fail(errorOut, QObject::tr("Failed to write %1.")
+                              .arg(file.fileName()));
+  }
+  return true;
+}
+
+void PngWriter::abort() {
+  if (stream) {
+    deflateEnd(stream.get());
+    stream.reset();
+  }
+  if (file.isOpen()) {
+    file.close();
+    file.remove();
+  }
+}
+
+bool PngWriter::deflatePending(int flush) {
+  for (;;) {
+    stream->next_out = reinterpret_cast<Bytef *>(idat.data() + idatUsed);
+    stream->avail_out = static_cast<uInt>(idat.size() - idatUsed);
+
+    const int result = deflate(stream.get(), flush);
+    if (result == Z_STREAM_ERROR) {
+      return false;
+    }
+    idatUsed = idat.size() - static_cast<qsizetype>(stream->avail_out);
+
+    if (idatUsed == idat.size()) {
+      // Output buffer full: emit a chunk and let deflate continue.
+      if (!flushIdat()) {
+        return false;
+      }
+      continue;
+    }
+    if (flush != Z_FINISH || result == Z_STREAM_END) {
+      break;
+    }
+  }
+
+  return flush == Z_FINISH ? flushIdat() : true;
+}
+
+bool PngWriter::flushIdat() {
+  if (idatUsed == 0) {
+    return true;
+  }
+  const bool ok = writeChunk("IDAT", idat.constData(), idatUsed);
+  idatUsed = 0;
+  return ok;
+}
+
+bool PngWriter::writeChunk(const char *type, const char *data,
+                           qsizetype size) {
+  QByteArray header;
+  appendBigEndian(header, static_cast<quint32>(size));
+  header.append(type, 4);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<const Bytef *>(type), 4);
+  if (size > 0) {
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(data),
+                static_cast<uInt>(size));
+  }
+  QByteArray trailer;
+  appendBigEndian(trailer, static_cast<quint32>(crc));
+
+  return file.write(header) == header.size() &&
+         (size == 0 || file.write(data, size) == size) &&
+         file.write(trailer) == trailer.size();
+}
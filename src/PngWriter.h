@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+#include <memory>
+
+struct z_stream_s;
+
+// Streaming PNG encoder. Rows are filtered, compressed and written as they
+// arrive, so memory stays proportional to the rows passed in at once rather
+// than to the whole image.
+class PngWriter {
+public:
+  PngWriter();
+  ~PngWriter();
+
+  PngWriter(const PngWriter &) = delete;
+  PngWriter &operator=(const PngWriter &) = delete;
+
+  bool open(const QString &path, int width, int height, QString *errorOut);
+
+  // Append the next rows of the image, top to bottom. `rows` must be exactly
+  // as wide as the image.
+  bool writeRows(const QImage &rows, QString *errorOut);
+
+  // Complete the file once every row has been written.
+  bool finish(QString *errorOut);
+
+  // Stop writing and remove the partially written file.
+  void abort();
+
+private:
+  bool deflatePending(int flush);
+  bool flushIdat();
+  bool writeChunk(const char *type, const char *data, qsizetype size);
+
+  QFile file;
+  std::unique_ptr<z_stream_s> stream;
+  int imageWidth = 0;
+  int imageHeight = 0;
+  int rowsWritten = 0;
+  QByteArray rowBytes; // Filter byte followed by RGB triplets of one row
+  QByteArray idat;     // Compressed data waiting for its IDAT chunk
+  qsizetype idatUsed = 0;
+};
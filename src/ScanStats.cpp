@@ -0,0 +1,200 @@
+#include "ScanStats.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QObject>
+
+#include <algorithm>
+
+#include "Utils.h"
+
+namespace {
+
+// The top-N lists are min-heaps so the smallest kept entry is evicted first.
+bool largerEntry(const ScanStats::Entry &a, const ScanStats::Entry &b) {
+  if (a.size != b.size) {
+    return a.size > b.size;
+  }
+  return a.path < b.path;
+}
+
+QString extensionOf(QStringView name) {
+  const qsizetype dot = name.lastIndexOf(QLatin1Char('.'));
+  if (dot <= 0 || dot == name.size() - 1) {
+    return QString();
+  }
+  return name.mid(dot + 1).toString().toLower();
+}
+
+QJsonArray entriesToJson(const QVector<ScanStats::Entry> &entries) {
+  QJsonArray array;
+  for (const ScanStats::Entry &entry : entries) {
+    QJsonObject object;
+    object.insert(QStringLiteral("path"), entry.path);
+    object.insert(QStringLiteral("size"), static_cast<qint64>(entry.size));
+    array.append(object);
+  }
+  return array;
+}
+
+} // namespace
+
+ScanStats::ScanStats(int topCount) : topCount(std::max(0, topCount)) {}
+
+void ScanStats::startNode(const QString &name, quint64 size, bool isDir) {
+  Frame frame;
+  frame.pathLength = path.size();
+  frame.ownSize = size;
+  frame.isDir = isDir;
+
+  if (!stack.empty()) {
+    stack.back().hasChildren = true;
+    if (!path.endsWith(QLatin1Char('/'))) {
+      path += QLatin1Char('/');
+    }
+  }
+  frame.nameOffset = path.size();
+  path += name;
+  stack.push_back(frame);
+}
+
+void ScanStats::endNode() {
+  if (stack.empty()) {
+    return;
+  }
+  const Frame frame = stack.back();
+  stack.pop_back();
+
+  // Same rule as TreeModel::computeSize: an explicit folder size wins.
+  const quint64 size = frame.hasChildren && frame.ownSize == 0
+                           ? frame.childTotal
+                           : frame.ownSize;
+
+  if (frame.isDir) {
+    ++folders;
+    offer(folderHeap, size);
+  } else {
+    ++files;
+    offer(fileHeap, size);
+
+    const QString extension =
+        extensionOf(QStringView(path).mid(frame.nameOffset));
+    ExtensionTotal &entry = extensionTotals[extension];
+    entry.extension = extension;
+    entry.size += size;
+    ++entry.files;
+  }
+
+  if (stack.empty()) {
+    total += size;
+  } else {
+    stack.back().childTotal += size;
+  }
+  path.truncate(frame.pathLength);
+}
+
+void ScanStats::offer(std::vector<Entry> &heap, quint64 size) const {
+  if (topCount == 0) {
+    return;
+  }
+  if (static_cast<int>(heap.size()) < topCount) {
+    heap.push_back({path, size});
+    std::push_heap(heap.begin(), heap.end(), largerEntry);
+  } else if (size > heap.front().size) {
+    std::pop_heap(heap.begin(), heap.end(), largerEntry);
+    heap.back() = {path, size};
+    std::push_heap(heap.begin(), heap.end(), largerEntry);
+  }
+}
+
+QVector<ScanStats::Entry> ScanStats::sorted(const std::vector<Entry> &heap) {
+  QVector<Entry> entries(heap.begin(), heap.end());
+  std::sort(entries.begin(), entries.end(), largerEntry);
+  return entries;
+}
+
+QVector<ScanStats::Entry> ScanStats::largestFiles() const {
+  return sorted(fileHeap);
+}
+
+QVector<ScanStats::Entry> ScanStats::largestFolders() const {
+  return sorted(folderHeap);
+}
+
+QVector<ScanStats::ExtensionTotal> ScanStats::extensions() const {
+  QVector<ExtensionTotal> result;
+  result.reserve(extensionTotals.size());
+  for (const ExtensionTotal &entry : extensionTotals) {
+    result.push_back(entry);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const ExtensionTotal &a, const ExtensionTotal &b) {
+              if (a.size != b.size) {
+                return a.size > b.size;
+              }
+              return a.extension < b.extension;
+            });
+  return result;
+}
+
+QString ScanStats::toText() const {
+  QString text;
+  text += QObject::tr("Total size: %1 (%2 bytes)\n")
+              .arg(Utils::formatSize(total))
+              .arg(total);
+  text += QObject::tr("Files: %1\n").arg(files);
+  text += QObject::tr("Folders: %1\n").arg(folders);
+
+  auto appendEntries = [&text](const QString &title,
+                               const QVector<Entry> &entries) {
+    text += QStringLiteral("\n") + title + QStringLiteral("\n");
+    for (const Entry &entry : entries) {
+      text += QStringLiteral("  %1  %2\n")
+                  .arg(Utils::formatSize(entry.size), 10)
+                  .arg(entry.path);
+    }
+  };
+  appendEntries(QObject::tr("Largest files:"), largestFiles());
+  appendEntries(QObject::tr("Largest folders:"), largestFolders());
+
+  text += QStringLiteral("\n") + QObject::tr("Size by extension:") +
+          QStringLiteral("\n");
+  for (const ExtensionTotal &entry : extensions()) {
+    const QString name = entry.extension.isEmpty()
+                             ? QObject::tr("(none)")
+                             : QStringLiteral(".") + entry.extension;
+    text += QStringLiteral("  %1  %2  ")
+                .arg(Utils::formatSize(entry.size), 10)
+                .arg(name) +
+            QObject::tr("(%1 files)").arg(entry.files) +
+            QStringLiteral("\n");
+  }
+  return text;
+}
+
+QJsonObject ScanStats::toJsonObject() const {
+  QJsonArray extensionArray;
+  for (const ExtensionTotal &entry : extensions()) {
+    QJsonObject object;
+    object.insert(QStringLiteral("extension"), entry.extension);
+    object.insert(QStringLiteral("size"), static_cast<qint64>(entry.size));
+    object.insert(QStringLiteral("files"), static_cast<qint64>(entry.files));
+    extensionArray.append(object);
+  }
+
+  QJsonObject root;
+  root.insert(QStringLiteral("totalSize"), static_cast<qint64>(total));
+  root.insert(QStringLiteral("files"), static_cast<qint64>(files));
+  root.insert(QStringLiteral("folders"), static_cast<qint64>(folders));
+  root.insert(QStringLiteral("largestFiles"), entriesToJson(largestFiles()));
+  root.insert(QStringLiteral("largestFolders"),
+              entriesToJson(largestFolders()));
+  root.insert(QStringLiteral("extensions"), extensionArray);
+  return root;
+}
+
+QString ScanStats::toJson() const {
+  return QString::fromUtf8(
+      QJsonDocument(toJsonObject()).toJson(QJsonDocument::Indented));
+}
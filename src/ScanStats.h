@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+#include "TreeReader.h"
+
+// Totals of a scan gathered straight from the reader's event stream. Only
+// the current folder path and bounded top-N lists are kept, so a scan of any
+// size is summarized without building a TreeModel.
+class ScanStats : public TreeReader::Handler {
+public:
+  struct Entry {
+    QString path;
+    quint64 size = 0;
+  };
+
+  struct ExtensionTotal {
+    QString extension; // Empty for files without an extension
+    quint64 size = 0;
+    quint64 files = 0;
+  };
+
+  explicit ScanStats(int topCount = 10);
+
+  void startNode(const QString &name, quint64 size, bool isDir) override;
+  void endNode() override;
+
+  quint64 totalSize() const { return total; }
+  quint64 fileCount() const { return files; }
+  quint64 folderCount() const { return folders; }
+
+  // Largest first.
+  QVector<Entry> largestFiles() const;
+  QVector<Entry> largestFolders() const;
+  QVector<ExtensionTotal> extensions() const;
+
+  QString toText() const;
+  QJsonObject toJsonObject() const;
+  QString toJson() const;
+
+private:
+  struct Frame {
+    qsizetype pathLength = 0; // Length of the parent's path
+    qsizetype nameOffset = 0;
+    quint64 ownSize = 0;
+    quint64 childTotal = 0;
+    bool hasChildren = false;
+    bool isDir = false;
+  };
+
+  void offer(std::vector<Entry> &heap, quint64 size) const;
+  static QVector<Entry> sorted(const std::vector<Entry> &heap);
+
+  int topCount;
+  QString path; // Path of the innermost open item
+  std::vector<Frame> stack;
+  std::vector<Entry> fileHeap;
+  std::vector<Entry> folderHeap;
+  QHash<QString, ExtensionTotal> extensionTotals;
+  quint64 total = 0;
+  quint64 files = 0;
+  quint64 folders = 0;
+};
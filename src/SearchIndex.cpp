@@ -0,0 +1,157 @@
+#include "SearchIndex.h"
+
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+quint64 trigramKey(QChar a, QChar b, QChar c) {
+  return (static_cast<quint64>(a.toCaseFolded().unicode()) << 32) |
+         (static_cast<quint64>(b.toCaseFolded().unicode()) << 16) |
+         static_cast<quint64>(c.toCaseFolded().unicode());
+}
+
+void collectTrigrams(QStringView text, std::vector<quint64> &keys) {
+  for (qsizetype i = 0; i + 2 < text.size(); ++i) {
+    keys.push_back(trigramKey(text[i], text[i + 1], text[i + 2]));
+  }
+}
+
+// Literal runs of a glob pattern; wildcards and bracket expressions split
+// them.
+QStringList globLiterals(const QString &pattern) {
+  QStringList literals;
+  QString current;
+  for (qsizetype i = 0; i < pattern.size(); ++i) {
+    const QChar c = pattern[i];
+    if (c == QLatin1Char('*') || c == QLatin1Char('?') ||
+        c == QLatin1Char('[')) {
+      if (!current.isEmpty()) {
+        literals.push_back(current);
+        current.clear();
+      }
+      if (c == QLatin1Char('[')) {
+        const qsizetype close = pattern.indexOf(QLatin1Char(']'), i + 2);
+        if (close < 0) {
+          break;
+        }
+        i = close;
+      }
+    } else {
+      current += c;
+    }
+  }
+  if (!current.isEmpty()) {
+    literals.push_back(current);
+  }
+  return literals;
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(std::shared_ptr<const NodeTable> nodeTable)
+    : table(std::move(nodeTable)) {
+  // Rows are in depth-first pre-order, so index order is also result order.
+  const std::vector<TreeNode *> &nodes = table->nodes;
+  std::vector<quint64> keys;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    keys.clear();
+    collectTrigrams(nodes[i]->name, keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (quint64 key : keys) {
+      postings[key].push_back(static_cast<quint32>(i));
+    }
+  }
+}
+
+bool SearchIndex::isGlob(const QString &query) {
+  return query.contains(QLatin1Char('*')) || query.contains(QLatin1Char('?')) ||
+         query.contains(QLatin1Char('['));
+}
+
+std::vector<quint32> SearchIndex::candidates(const QStringList &literals,
+                                             bool *allNodes) const {
+  std::vector<quint64> keys;
+  for (const QString &literal : literals) {
+    collectTrigrams(literal, keys);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  *allNodes = keys.empty();
+  if (keys.empty()) {
+    return {};
+  }
+
+  std::vector<const std::vector<quint32> *> lists;
+  lists.reserve(keys.size());
+  for (quint64 key : keys) {
+    const auto it = postings.constFind(key);
+    if (it == postings.constEnd()) {
+      return {};
+    }
+    lists.push_back(&it.value());
+  }
+
+  // Intersect starting from the rarest trigram to keep the working set small.
+  std::sort(lists.begin(), lists.end(),
+            [](const auto *a, const auto *b) { return a->size() < b->size(); });
+  std::vector<quint32> result = *lists.front();
+  std::vector<quint32> next;
+  for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+    next.clear();
+    std::set_intersection(result.begin(), result.end(), lists[i]->begin(),
+                          lists[i]->end(), std::back_inserter(next));
+    result.swap(next);
+  }
+  return result;
+}
+
+QVector<TreeNode *> SearchIndex::find(const QString &query) const {
+  QVector<TreeNode *> matches;
+  const QString trimmed = query.trimmed();
+  if (trimmed.isEmpty()) {
+    return matches;
+  }
+
+  const bool glob = isGlob(trimmed);
+  QRegularExpression pattern;
+  if (glob) {
+    pattern = QRegularExpression(
+        QRegularExpression::wildcardToRegularExpression(trimmed),
+        QRegularExpression::CaseInsensitiveOption);
+    if (!pattern.isValid()) {
+      return matches;
+    }
+  }
+
+  auto matchesName = [&](const TreeNode *node) {
+    return glob ? pattern.match(node->name).hasMatch()
+                : node->name.contains(trimmed, Qt::CaseInsensitive);
+  };
+
+  bool allNodes = false;
+  const std::vector<quint32> indices =
+      candidates(glob ? globLiterals(trimmed) : QStringList{trimmed},
+                 &allNodes);
+  const std::vector<TreeNode *> &nodes = table->nodes;
+  if (allNodes) {
+    for (TreeNode *node : nodes) {
+      if (matchesName(node)) {
+        matches.push_back(node);
+      }
+    }
+    return matches;
+  }
+
+  for (quint32 index : indices) {
+    if (matchesName(nodes[index])) {
+      matches.push_back(nodes[index]);
+    }
+  }
+  return matches;
+}
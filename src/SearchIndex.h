@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+
+// Trigram index over node names. Building it is meant for a worker thread;
+// the tree must not change while it is built or used, which a table built
+// from a shared TreeModel guarantees.
+class SearchIndex {
+public:
+  explicit SearchIndex(std::shared_ptr<const NodeTable> table);
+
+  // Nodes whose name contains `query`, ignoring case. A query with glob
+  // characters (*, ? or [...]) must match the whole name instead. Results
+  // are in depth-first order.
+  QVector<TreeNode *> find(const QString &query) const;
+
+  const std::shared_ptr<const NodeTable> &nodeTable() const { return table; }
+  TreeNode *root() const {
+    return table->nodes.empty() ? nullptr : table->nodes.front();
+  }
+  int nodeCount() const { return static_cast<int>(table->rowCount()); }
+
+  static bool isGlob(const QString &query);
+
+private:
+  // Indices into `nodes` of the candidates for `literals`; all nodes when no
+  // literal is long enough to have a trigram.
+  std::vector<quint32> candidates(const QStringList &literals,
+                                  bool *allNodes) const;
+
+  std::shared_ptr<const NodeTable> table;
+  // Case-folded trigram -> ascending node indices.
+  QHash<quint64, std::vector<quint32>> postings;
+};
@@ -0,0 +1,224 @@
+#include "SnapshotPool.h"
+
+#include <QObject>
+
+#include <algorithm>
+
+#include "TreeReader.h"
+
+namespace {
+
+quint64 combine(quint64 seed, quint64 value) {
+  seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+  return seed;
+}
+
+} // namespace
+
+// Interns nodes bottom-up as the reader closes them. Finished children of
+// the open folders wait in one shared vector, so each folder's children are
+// a contiguous run at its end.
+class SnapshotPool::Builder : public TreeReader::Handler {
+public:
+  explicit Builder(SnapshotPool &pool) : pool(pool) {}
+
+  void startNode(const QString &name, quint64 size, bool isDir) override {
+    open.push_back({name, size, isDir, pendingChildren.size()});
+    ++nodeCount;
+  }
+
+  void endNode() override {
+    if (open.empty()) {
+      return;
+    }
+    const Frame frame = open.back();
+    open.pop_back();
+
+    const quint32 *children = pendingChildren.data() + frame.childStart;
+    const auto childCount =
+        static_cast<quint32>(pendingChildren.size() - frame.childStart);
+    // Same rule as TreeModel::computeSize(): folders without a recorded
+    // size get the total of their children.
+    quint64 size = frame.size;
+    if (childCount > 0 && size == 0) {
+      for (quint32 i = 0; i < childCount; ++i) {
+        size += pool.entries[children[i]].size;
+      }
+    }
+    const quint32 id =
+        pool.intern(frame.name, size, frame.isDir, children, childCount);
+    pendingChildren.resize(frame.childStart);
+    if (open.empty()) {
+      root = id;
+      hasRoot = true;
+    } else {
+      pendingChildren.push_back(id);
+    }
+  }
+
+  void sizeMeasure(TreeModel::SizeMeasure value) override {
+    measure = value;
+  }
+
+  quint32 root = 0;
+  bool hasRoot = false;
+  quint64 nodeCount = 0;
+  TreeModel::SizeMeasure measure = TreeModel::SizeMeasure::Logical;
+
+private:
+  struct Frame {
+    QString name;
+    quint64 size = 0;
+    bool isDir = false;
+    size_t childStart = 0;
+  };
+
+  SnapshotPool &pool;
+  std::vector<Frame> open;
+  std::vector<quint32> pendingChildren;
+};
+
+bool SnapshotPool::addFile(const QString &path, QString *errorOut) {
+  const size_t entryCount = entries.size();
+  const size_t childIdCount = childIds.size();
+  Builder builder(*this);
+  bool ok = TreeReader::parseFile(path, builder, errorOut);
+  if (ok && !builder.hasRoot) {
+    if (errorOut) {
+      *errorOut = QObject::tr("No root node found in XML.");
+    }
+    ok = false;
+  }
+  if (!ok) {
+    rollback(entryCount, childIdCount);
+    return false;
+  }
+  snapshotList.push_back(
+      {path, builder.root, builder.nodeCount, builder.measure});
+  return true;
+}
+
+void SnapshotPool::addTree(const TreeNode *root, const QString &label) {
+  if (!root) {
+    return;
+  }
+  Builder builder(*this);
+
+  // Replay the tree as reader events; a null marks a node's end.
+  std::vector<const TreeNode *> pending{root};
+  while (!pending.empty()) {
+    const TreeNode *node = pending.back();
+    pending.pop_back();
+    if (!node) {
+      builder.endNode();
+      continue;
+    }
+    builder.startNode(node->name, node->size, node->isDir);
+    pending.push_back(nullptr);
+    for (auto it = node->children.crbegin(); it != node->children.crend();
+         ++it) {
+      if (*it) {
+        pending.push_back(*it);
+      }
+    }
+  }
+  snapshotList.push_back({label, builder.root, builder.nodeCount});
+}
+
+quint64 SnapshotPool::snapshotHash(int index) const {
+  if (index < 0 || index >= static_cast<int>(snapshotList.size())) {
+    return 0;
+  }
+  return entries[snapshotList[static_cast<size_t>(index)].root].hash;
+}
+
+quint32 SnapshotPool::intern(const QString &name, quint64 size, bool isDir,
+                             const quint32 *children, quint32 childCount) {
+  quint64 hash = combine(qHash(name), size);
+  hash = combine(hash, isDir ? 1 : 0);
+  for (quint32 i = 0; i < childCount; ++i) {
+    hash = combine(hash, entries[children[i]].hash);
+  }
+
+  // Children are interned first, so equal subtrees have equal child ids
+  // and a hash collision is caught by comparing them.
+  const auto head = firstByHash.constFind(hash);
+  const quint32 first = head == firstByHash.constEnd() ? kNoEntry : *head;
+  for (quint32 id = first; id != kNoEntry; id = entries[id].nextSameHash) {
+    const Entry &entry = entries[id];
+    if (entry.size == size && entry.isDir == isDir &&
+        entry.childCount == childCount && entry.name == name &&
+        std::equal(children, children + childCount,
+                   childIds.begin() + entry.firstChild)) {
+      return id;
+    }
+  }
+
+  Entry entry;
+  entry.name = name;
+  entry.size = size;
+  entry.hash = hash;
+  entry.isDir = isDir;
+  entry.firstChild = static_cast<quint32>(childIds.size());
+  entry.childCount = childCount;
+  entry.nextSameHash = first;
+  childIds.insert(childIds.end(), children, children + childCount);
+
+  const auto id = static_cast<quint32>(entries.size());
+  entries.push_back(std::move(entry));
+  firstByHash.insert(hash, id);
+  return id;
+}
+
+void SnapshotPool::rollback(size_t entryCount, size_t childIdCount) {
+  // Newer entries head their chains, so undo them newest first.
+  for (size_t id = entries.size(); id-- > entryCount;) {
+    const Entry &entry = entries[id];
+    if (entry.nextSameHash == kNoEntry) {
+      firstByHash.remove(entry.hash);
+    } else {
+      firstByHash.insert(entry.hash, entry.nextSameHash);
+    }
+  }
+  entries.resize(entryCount);
+  childIds.resize(childIdCount);
+}
+
+std::shared_ptr<TreeModel> SnapshotPool::materialize(int index) const {
+  if (index < 0 || index >= static_cast<int>(snapshotList.size())) {
+    return nullptr;
+  }
+
+  struct Pending {
+    quint32 entry = 0;
+    TreeNode *parent = nullptr;
+  };
+
+  const Snapshot &snapshot = snapshotList[static_cast<size_t>(index)];
+  auto model = std::make_shared<TreeModel>();
+  model->setSizeMeasure(snapshot.sizeMeasure);
+  std::vector<Pending> pending{{snapshot.root, nullptr}};
+  while (!pending.empty()) {
+    const Pending current = pending.back();
+    pending.pop_back();
+
+    const Entry &entry = entries[current.entry];
+    auto *node = new TreeNode();
+    node->name = entry.name;
+    node->size = entry.size;
+    node->isDir = entry.isDir;
+    node->children.reserve(static_cast<qsizetype>(entry.childCount));
+    if (current.parent) {
+      current.parent->children.push_back(node);
+    } else {
+      model->setRoot(node);
+    }
+
+    // Pushed in reverse so children are appended in their original order.
+    for (quint32 i = entry.childCount; i-- > 0;) {
+      pending.push_back({childIds[entry.firstChild + i], node});
+    }
+  }
+  model->computeDerivedSizes();
+  return model;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "TreeModel.h"
+
+// Many scans of the same volume held at once. Every subtree is interned by
+// a content hash of its name, size, type and children's hashes, so a
+// subtree that is identical in several scans is stored once and memory
+// grows with the churn between scans rather than with their number.
+// TreeNode carries per-view state (parent, layout rectangle, filter flags),
+// so the pool keeps its own compact immutable entries and a scan is viewed
+// by materializing it into a TreeModel. Loading is single-threaded; once
+// loaded, the pool may be read from any thread.
+class SnapshotPool {
+public:
+  struct Snapshot {
+    QString label;
+    quint32 root = 0;      // Entry of the top-level folder
+    quint64 nodeCount = 0; // Nodes the scan has when materialized
+    TreeModel::SizeMeasure sizeMeasure = TreeModel::SizeMeasure::Logical;
+  };
+
+  // Stream the scan at `path` into the pool without building a TreeModel.
+  // On failure nothing is added.
+  bool addFile(const QString &path, QString *errorOut);
+  // Intern an in-memory tree as a snapshot labelled `label`.
+  void addTree(const TreeNode *root, const QString &label);
+
+  const std::vector<Snapshot> &snapshots() const { return snapshotList; }
+  // Distinct subtrees stored for all snapshots together.
+  size_t uniqueNodeCount() const { return entries.size(); }
+  // Content hash of a snapshot's whole tree; equal trees hash equally.
+  quint64 snapshotHash(int index) const;
+
+  // A standalone copy of snapshot `index` for viewing, or null if there is
+  // no such snapshot.
+  std::shared_ptr<TreeModel> materialize(int index) const;
+
+private:
+  class Builder;
+
+  static constexpr quint32 kNoEntry = 0xffffffffu;
+
+  struct Entry {
+    QString name;
+    quint64 size = 0;
+    quint64 hash = 0;
+    quint32 firstChild = 0; // Index into childIds
+    quint32 childCount = 0;
+    quint32 nextSameHash = kNoEntry;
+    bool isDir = false;
+  };
+
+  // Id of the entry equal to the given one, adding it if there is none.
+  quint32 intern(const QString &name, quint64 size, bool isDir,
+                 const quint32 *children, quint32 childCount);
+  // Drop entries added after `entryCount` entries existed.
+  void rollback(size_t entryCount, size_t childIdCount);
+
+  std::vector<Entry> entries;
+  std::vector<quint32> childIds;
+  QHash<quint64, quint32> firstByHash; // Head of each same-hash chain
+  std::vector<Snapshot> snapshotList;
+};
@@ -0,0 +1,136 @@
+#include "TaskScheduler.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+
+namespace TaskScheduler {
+
+namespace {
+
+std::atomic<int> configuredThreads{0};
+
+// Shared with helpers that may only start after the loop has returned; they
+// then find nothing left to claim and never touch `body`.
+struct LoopState {
+  const std::function<void(size_t, size_t)> *body = nullptr;
+  CancelToken cancel;
+  size_t count = 0;
+  size_t chunkSize = 1;
+  size_t chunks = 0;
+  int priority = 0;
+  std::atomic<size_t> next{0};
+  std::atomic<bool> skipped{false};
+  QMutex mutex;
+  QWaitCondition finished;
+  size_t done = 0;
+};
+
+// Runs the next unstarted range; false once none are left.
+bool runNextChunk(LoopState &state) {
+  const size_t chunk = state.next.fetch_add(1);
+  if (chunk >= state.chunks) {
+    return false;
+  }
+  if (state.cancel.isCanceled()) {
+    state.skipped.store(true);
+  } else {
+    const size_t begin = chunk * state.chunkSize;
+    (*state.body)(begin, std::min(begin + state.chunkSize, state.count));
+  }
+  QMutexLocker lock(&state.mutex);
+  if (++state.done == state.chunks) {
+    state.finished.wakeAll();
+  }
+  return true;
+}
+
+// One range per pool task; the successor queues behind whatever arrived
+// meanwhile instead of holding the worker for the whole loop.
+void startHelper(const std::shared_ptr<LoopState> &state) {
+  pool()->start(
+      [state]() {
+        if (runNextChunk(*state) &&
+            state->next.load(std::memory_order_relaxed) < state->chunks) {
+          startHelper(state);
+        }
+      },
+      state->priority);
+}
+
+} // namespace
+
+void setThreadCount(int count) {
+  count = std::max(0, count);
+  configuredThreads.store(count, std::memory_order_relaxed);
+  // Background jobs need a worker even when loops run inline.
+  pool()->setMaxThreadCount(std::max(1, threadCount()));
+}
+
+int threadCount() {
+  const int count = configuredThreads.load(std::memory_order_relaxed);
+  return count > 0 ? count : std::max(1, QThread::idealThreadCount());
+}
+
+bool parseThreadCount(const QString &text, int *count) {
+  bool ok = false;
+  const int value = text.trimmed().toInt(&ok);
+  if (!ok || value < 0) {
+    return false;
+  }
+  *count = value;
+  return true;
+}
+
+QThreadPool *pool() { return QThreadPool::globalInstance(); }
+
+QThreadPool *reservedPool() {
+  static QThreadPool reserved;
+  static const bool sized = (reserved.setMaxThreadCount(2), true);
+  static_cast<void>(sized);
+  return &reserved;
+}
+
+bool parallelFor(size_t count, size_t chunkSize,
+                 const std::function<void(size_t begin, size_t end)> &body,
+                 Priority priority, const CancelToken &cancel) {
+  chunkSize = std::max<size_t>(chunkSize, 1);
+  const size_t chunks = (count + chunkSize - 1) / chunkSize;
+  const size_t helpers =
+      std::min(static_cast<size_t>(threadCount() - 1),
+               chunks > 0 ? chunks - 1 : 0);
+
+  if (helpers == 0) {
+    for (size_t begin = 0; begin < count; begin += chunkSize) {
+      if (cancel.isCanceled()) {
+        return false;
+      }
+      body(begin, std::min(begin + chunkSize, count));
+    }
+    return true;
+  }
+
+  auto state = std::make_shared<LoopState>();
+  state->body = &body;
+  state->cancel = cancel;
+  state->count = count;
+  state->chunkSize = chunkSize;
+  state->chunks = chunks;
+  state->priority = static_cast<int>(priority);
+
+  for (size_t i = 0; i < helpers; ++i) {
+    startHelper(state);
+  }
+  while (runNextChunk(*state)) {
+  }
+
+  QMutexLocker lock(&state->mutex);
+  while (state->done < chunks) {
+    state->finished.wait(&state->mutex);
+  }
+  return !state->skipped.load();
+}
+
+} // namespace TaskScheduler
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QString>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+
+// The one pool behind every parallel loop and background job, so they share
+// a single concurrency limit instead of each sizing threads of their own. A
+// small reserved pool beside it keeps interactive jobs and releases from
+// queueing behind long background loops.
+namespace TaskScheduler {
+
+// Queued work with a higher priority starts first.
+enum class Priority { Background = 0, Normal = 1, Interactive = 2 };
+
+// Cooperative cancellation; copies share one flag.
+class CancelToken {
+public:
+  CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void cancel() const { flag->store(true, std::memory_order_relaxed); }
+  bool isCanceled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+  std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Threads used for parallel work, including the one waiting on a loop. 0
+// picks one per CPU. With 1, loops run inline in order, so their results do
+// not depend on timing.
+void setThreadCount(int count);
+int threadCount();
+
+// A --threads or GPSCAN_VIEWER_THREADS value; 0 means one per CPU.
+bool parseThreadCount(const QString &text, int *count);
+
+QThreadPool *pool();
+// Two threads that only interactive jobs and background releases use.
+QThreadPool *reservedPool();
+
+// Run `function` on the shared pool, or on the reserved one when it is
+// Interactive; the future carries its result.
+template <typename Function>
+auto run(Priority priority, Function &&function) {
+  QThreadPool *target =
+      priority == Priority::Interactive ? reservedPool() : pool();
+  return QtConcurrent::task(std::forward<Function>(function))
+      .onThreadPool(*target)
+      .withPriority(static_cast<int>(priority))
+      .spawn();
+}
+
+// A handle to `object` whose last copy, wherever it is dropped, destroys
+// the object on the reserved pool instead, so releasing a large tree never
+// stalls the thread that happened to hold the last reference, nor waits
+// behind a busy shared pool.
+template <typename T>
+std::shared_ptr<T> destroyInBackground(std::shared_ptr<T> object) {
+  T *raw = object.get();
+  if (!raw) {
+    return object;
+  }
+  return std::shared_ptr<T>(raw, [owner = std::move(object)](T *) mutable {
+    auto release = [owner = std::move(owner)]() mutable { owner.reset(); };
+    // Nothing waits for the release.
+    static_cast<void>(QtConcurrent::task(std::move(release))
+                          .onThreadPool(*reservedPool())
+                          .withPriority(static_cast<int>(Priority::Background))
+                          .spawn());
+  });
+}
+
+// Call body(begin, end) on consecutive ranges of at most `chunkSize` that
+// cover [0, count). The caller takes ranges too and idle workers claim the
+// next unstarted one, so nested loops cannot starve. Each pool task runs a
+// single range and then queues its successor, so other work of a higher
+// priority can start between ranges. Returns once every range has finished,
+// or false if `cancel` fired and some were skipped.
+bool parallelFor(size_t count, size_t chunkSize,
+                 const std::function<void(size_t begin, size_t end)> &body,
+                 Priority priority = Priority::Normal,
+                 const CancelToken &cancel = CancelToken());
+
+} // namespace TaskScheduler
@@ -0,0 +1,158 @@
+#include "TopItemsWidget.h"
+
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "Utils.h"
+
+TopItemsWidget::TopItemsWidget(QWidget *parent) : QWidget(parent) {
+  underSelectionCheck = new QCheckBox(tr("Under selection"), this);
+  underSelectionCheck->setToolTip(
+      tr("Rank only items inside the selected folder"));
+  countSpin = new QSpinBox(this);
+  countSpin->setRange(1, 1000);
+  countSpin->setValue(20);
+  countSpin->setToolTip(tr("Entries per list"));
+  scopeLabel = new QLabel(this);
+  scopeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+  tree = new QTreeWidget(this);
+  tree->setColumnCount(2);
+  tree->setHeaderLabels({tr("Size"), tr("Path")});
+  tree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+  tree->setRootIsDecorated(true);
+  tree->setUniformRowHeights(true);
+
+  auto *options = new QHBoxLayout();
+  options->addWidget(underSelectionCheck);
+  options->addStretch();
+  options->addWidget(new QLabel(tr("Top"), this));
+  options->addWidget(countSpin);
+
+  auto *layout = new QVBoxLayout(this);
+  layout->setContentsMargins(4, 4, 4, 4);
+  layout->addLayout(options);
+  layout->addWidget(scopeLabel);
+  layout->addWidget(tree);
+
+  watcher = new QFutureWatcher<NodeTable::TopItems>(this);
+  connect(watcher, &QFutureWatcher<NodeTable::TopItems>::finished, this,
+          &TopItemsWidget::showResult);
+  connect(underSelectionCheck, &QCheckBox::toggled, this,
+          &TopItemsWidget::recompute);
+  connect(countSpin, QOverload<int>::of(&QSpinBox::valueChanged), this,
+          &TopItemsWidget::recompute);
+  connect(tree, &QTreeWidget::itemActivated, this,
+          [this](QTreeWidgetItem *item) { activateItem(item); });
+  connect(tree, &QTreeWidget::itemClicked, this,
+          [this](QTreeWidgetItem *item) { activateItem(item); });
+}
+
+void TopItemsWidget::setNodeTable(std::shared_ptr<const NodeTable> newTable) {
+  table = std::move(newTable);
+  scopeNode = nullptr;
+  recompute();
+}
+
+void TopItemsWidget::setScopeNode(TreeNode *node) {
+  // Clicking a row selects it on the canvas; keep the list that was clicked.
+  if (activating || node == scopeNode) {
+    return;
+  }
+  scopeNode = node;
+  if (underSelectionCheck->isChecked()) {
+    recompute();
+  }
+}
+
+void TopItemsWidget::showEvent(QShowEvent *event) {
+  QWidget::showEvent(event);
+  if (dirty) {
+    recompute();
+  }
+}
+
+void TopItemsWidget::recompute() {
+  computedTable.reset();
+  if (!table || table->rowCount() == 0) {
+    tree->clear();
+    scopeLabel->clear();
+    dirty = false;
+    return;
+  }
+  if (!isVisible()) {
+    dirty = true;
+    return;
+  }
+  dirty = false;
+
+  // Files have nothing below them; rank their folder instead.
+  const TreeNode *scope = nullptr;
+  if (underSelectionCheck->isChecked()) {
+    scope = scopeNode;
+  }
+  qint64 row = table->rowOf(scope);
+  if (row > 0 && !table->dirFlags[static_cast<size_t>(row)]) {
+    row = table->parents[static_cast<size_t>(row)];
+  }
+  const quint32 targetRow = row < 0 ? 0 : static_cast<quint32>(row);
+
+  scopeLabel->setText(
+      tr("Under %1").arg(Utils::buildFullPath(*table, targetRow)));
+
+  // The worker keeps the table alive; a newer request replaces the future
+  // and the stale result is never shown.
+  computedTable = table;
+  std::shared_ptr<const NodeTable> snapshot = table;
+  const int count = countSpin->value();
+  pending.cancel();
+  pending = TaskScheduler::CancelToken();
+  const TaskScheduler::CancelToken cancel = pending;
+  watcher->setFuture(TaskScheduler::run(
+      TaskScheduler::Priority::Normal, [snapshot, targetRow, count, cancel]() {
+        return snapshot->largestItems(targetRow, count, cancel);
+      }));
+}
+
+void TopItemsWidget::showResult() {
+  if (watcher->isCanceled() || !table || computedTable != table) {
+    return;
+  }
+  const NodeTable::TopItems items = watcher->result();
+
+  tree->clear();
+  auto addGroup = [this](const QString &title,
+                         const std::vector<quint32> &rows) {
+    auto *group = new QTreeWidgetItem(tree, {title});
+    group->setFirstColumnSpanned(true);
+    for (quint32 row : rows) {
+      auto *item = new QTreeWidgetItem(
+          group, {Utils::formatSize(table->sizes[row]),
+                  Utils::buildFullPath(*table, row)});
+      item->setTextAlignment(0, Qt::AlignRight | Qt::AlignVCenter);
+      item->setData(0, Qt::UserRole,
+                    QVariant::fromValue(static_cast<quint64>(row)));
+    }
+    group->setExpanded(true);
+  };
+  addGroup(tr("Largest files"), items.files);
+  addGroup(tr("Largest folders"), items.folders);
+}
+
+void TopItemsWidget::activateItem(QTreeWidgetItem *item) {
+  if (!item || !item->parent() || !table) {
+    return;
+  }
+  const quint64 row = item->data(0, Qt::UserRole).toULongLong();
+  if (row >= table->rowCount()) {
+    return;
+  }
+  activating = true;
+  emit nodeActivated(table->nodes[row]);
+  activating = false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QFutureWatcher>
+#include <QWidget>
+#include <memory>
+
+#include "NodeTable.h"
+
+class QCheckBox;
+class QLabel;
+class QSpinBox;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Ranked lists of the largest files and folders, for the whole model or
+// under the current selection. Lists are computed on a worker thread and
+// only while the panel is visible.
+class TopItemsWidget : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit TopItemsWidget(QWidget *parent = nullptr);
+
+  // Rows come from `table`; null clears the lists.
+  void setNodeTable(std::shared_ptr<const NodeTable> table);
+  // Scope used when "Under selection" is checked.
+  void setScopeNode(TreeNode *node);
+
+signals:
+  void nodeActivated(TreeNode *node);
+
+protected:
+  void showEvent(QShowEvent *event) override;
+
+private:
+  void recompute();
+  void showResult();
+  void activateItem(QTreeWidgetItem *item);
+
+  QCheckBox *underSelectionCheck = nullptr;
+  QSpinBox *countSpin = nullptr;
+  QLabel *scopeLabel = nullptr;
+  QTreeWidget *tree = nullptr;
+
+  std::shared_ptr<const NodeTable> table;
+  TreeNode *scopeNode = nullptr;
+  QFutureWatcher<NodeTable::TopItems> *watcher = nullptr;
+  std::shared_ptr<const NodeTable> computedTable; // Table of the pending job
+  TaskScheduler::CancelToken pending; // Canceled when a newer job starts
+  bool dirty = true;
+  bool activating = false;
+};
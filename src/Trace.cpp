@@ -0,0 +1,197 @@
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStringList>
+#include <QThread>
+
+#include <vector>
+
+namespace Trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+} // namespace detail
+
+namespace {
+
+struct Event {
+  const char *name = nullptr;
+  char phase = 'X'; // 'X' for a span, 'C' for a counter
+  qint64 begin = 0; // Nanoseconds since start()
+  qint64 duration = 0;
+  int thread = 0;
+  const char *argName = nullptr;
+  qint64 argValue = 0;
+};
+
+struct Recorder {
+  QMutex mutex;
+  QElapsedTimer clock;
+  QString path;
+  std::vector<Event> events;
+  QStringList threadNames; // Indexed by Event::thread
+  bool flushRegistered = false;
+};
+
+Recorder &recorder() {
+  static Recorder instance;
+  return instance;
+}
+
+// Small ids keep the trace readable; names are taken on first use. Called
+// with the recorder locked.
+int currentThread(Recorder &r) {
+  thread_local int id = -1;
+  if (id < 0) {
+    id = static_cast<int>(r.threadNames.size());
+    QThread *thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if (QCoreApplication::instance() &&
+        thread == QCoreApplication::instance()->thread()) {
+      name = QStringLiteral("main");
+    } else if (name.isEmpty()) {
+      name = QStringLiteral("worker %1").arg(id);
+    }
+    r.threadNames.push_back(name);
+  }
+  return id;
+}
+
+void record(Event event) {
+  Recorder &r = recorder();
+  QMutexLocker lock(&r.mutex);
+  // finish() may have run since the caller checked.
+  if (!isEnabled()) {
+    return;
+  }
+  event.thread = currentThread(r);
+  r.events.push_back(event);
+}
+
+void flushAtExit() {
+  QString error;
+  if (!finish(&error)) {
+    qWarning("Failed to write trace: %s", qPrintable(error));
+  }
+}
+
+} // namespace
+
+qint64 detail::now() { return recorder().clock.nsecsElapsed(); }
+
+void detail::complete(const char *name, qint64 begin, const char *argName,
+                      qint64 argValue) {
+  Event event;
+  event.name = name;
+  event.begin = begin;
+  event.duration = now() - begin;
+  event.argName = argName;
+  event.argValue = argValue;
+  record(event);
+}
+
+bool start(const QString &path, QString *errorOut) {
+  if (path.isEmpty()) {
+    if (errorOut) {
+      *errorOut = QObject::tr("No trace file given.");
+    }
+    return false;
+  }
+  Recorder &r = recorder();
+  QMutexLocker lock(&r.mutex);
+  r.path = path;
+  r.events.clear();
+  r.clock.start();
+  if (!r.flushRegistered) {
+    qAddPostRoutine(flushAtExit);
+    r.flushRegistered = true;
+  }
+  detail::enabled.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+bool finish(QString *errorOut) {
+  Recorder &r = recorder();
+  std::vector<Event> events;
+  QStringList threadNames;
+  QString path;
+  {
+    QMutexLocker lock(&r.mutex);
+    if (!isEnabled()) {
+      return true;
+    }
+    detail::enabled.store(false, std::memory_order_relaxed);
+    events.swap(r.events);
+    threadNames = r.threadNames;
+    path = r.path;
+  }
+
+  const qint64 pid = QCoreApplication::applicationPid();
+  QJsonArray traceEvents;
+  for (qsizetype i = 0; i < threadNames.size(); ++i) {
+    QJsonObject args;
+    args.insert(QStringLiteral("name"), threadNames[i]);
+    QJsonObject metadata;
+    metadata.insert(QStringLiteral("ph"), QStringLiteral("M"));
+    metadata.insert(QStringLiteral("name"), QStringLiteral("thread_name"));
+    metadata.insert(QStringLiteral("pid"), pid);
+    metadata.insert(QStringLiteral("tid"), static_cast<int>(i));
+    metadata.insert(QStringLiteral("args"), args);
+    traceEvents.append(metadata);
+  }
+  // Timestamps are in microseconds.
+  for (const Event &event : events) {
+    QJsonObject object;
+    object.insert(QStringLiteral("name"), QString::fromLatin1(event.name));
+    object.insert(QStringLiteral("ph"), QString(QLatin1Char(event.phase)));
+    object.insert(QStringLiteral("ts"),
+                  static_cast<double>(event.begin) / 1e3);
+    if (event.phase == 'X') {
+      object.insert(QStringLiteral("dur"),
+                    static_cast<double>(event.duration) / 1e3);
+    }
+    object.insert(QStringLiteral("pid"), pid);
+    object.insert(QStringLiteral("tid"), event.thread);
+    if (event.argName) {
+      QJsonObject args;
+      args.insert(QString::fromLatin1(event.argName), event.argValue);
+      object.insert(QStringLiteral("args"), args);
+    }
+    traceEvents.append(object);
+  }
+  QJsonObject root;
+  root.insert(QStringLiteral("traceEvents"), traceEvents);
+  root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 ||
+      !file.commit()) {
+    if (errorOut) {
+      *errorOut = QStringLiteral("%1: %2").arg(path, file.errorString());
+    }
+    return false;
+  }
+  return true;
+}
+
+void counter(const char *name, qint64 value) {
+  if (!isEnabled()) {
+    return;
+  }
+  Event event;
+  event.name = name;
+  event.phase = 'C';
+  event.begin = detail::now();
+  event.argName = name;
+  event.argValue = value;
+  record(event);
+}
+
+} // namespace Trace
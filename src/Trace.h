@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Spans and counters written as a Chrome trace (the JSON "Trace Event
+// Format" that chrome://tracing and Perfetto open). Recording is off unless
+// start() was called, and a span then costs a single relaxed load.
+namespace Trace {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+qint64 now();
+void complete(const char *name, qint64 begin, const char *argName,
+              qint64 argValue);
+} // namespace detail
+
+inline bool isEnabled() {
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Record from now on and write the trace to `path` when the application
+// object is destroyed, or earlier through finish().
+bool start(const QString &path, QString *errorOut);
+
+// Write what was recorded and stop; false if the file could not be written.
+bool finish(QString *errorOut);
+
+// A named value over time, such as bytes read so far.
+void counter(const char *name, qint64 value);
+
+// Times its own lifetime. `label` must be a string literal. One numeric
+// argument, such as the node count handled, may be attached before the
+// scope ends.
+class Scope {
+public:
+  explicit Scope(const char *label)
+      : name(isEnabled() ? label : nullptr),
+        begin(name ? detail::now() : 0) {}
+  ~Scope() {
+    if (name) {
+      detail::complete(name, begin, argName, argValue);
+    }
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  void setArg(const char *key, qint64 value) {
+    argName = key;
+    argValue = value;
+  }
+
+private:
+  const char *name;
+  qint64 begin;
+  const char *argName = nullptr;
+  qint64 argValue = 0;
+};
+
+} // namespace Trace
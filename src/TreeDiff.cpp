@@ -0,0 +1,94 @@
+#include "TreeDiff.h"
+
+#include <utility>
+
+std::shared_ptr<const TreeDiff>
+TreeDiff::compute(std::shared_ptr<const NodeTable> current,
+                  const TreeNode *baseline) {
+  std::shared_ptr<TreeDiff> diff(new TreeDiff());
+  diff->table = std::move(current);
+  const NodeTable &table = *diff->table;
+
+  // Everything starts out as added; paired rows are overwritten below.
+  const size_t rows = table.rowCount();
+  diff->deltas.resize(rows);
+  for (size_t row = 0; row < rows; ++row) {
+    diff->deltas[row] = static_cast<qint64>(table.sizes[row]);
+  }
+  diff->changes.assign(rows, static_cast<quint8>(Change::Added));
+  if (rows == 0 || !baseline) {
+    return diff;
+  }
+
+  // The roots are paired even if the volume was scanned under another name.
+  struct Pair {
+    quint32 row = 0;
+    const TreeNode *baseline = nullptr;
+  };
+  std::vector<Pair> pending{{0, baseline}};
+  QHash<QString, const TreeNode *> byName;
+  while (!pending.empty()) {
+    const Pair pair = pending.back();
+    pending.pop_back();
+
+    const TreeNode *node = table.nodes[pair.row];
+    const qint64 delta = static_cast<qint64>(node->size) -
+                         static_cast<qint64>(pair.baseline->size);
+    Change change = delta > 0   ? Change::Grew
+                    : delta < 0 ? Change::Shrank
+                                : Change::Unchanged;
+
+    if (node->isDir && !pair.baseline->children.isEmpty()) {
+      byName.clear();
+      byName.reserve(pair.baseline->children.size());
+      for (const TreeNode *old : pair.baseline->children) {
+        if (old) {
+          byName.insert(old->name, old);
+        }
+      }
+      for (const TreeNode *child : node->children) {
+        if (!child) {
+          continue;
+        }
+        const auto it = byName.constFind(child->name);
+        if (it != byName.constEnd() && it.value()->isDir == child->isDir) {
+          pending.push_back(
+              {static_cast<quint32>(table.rowOf(child)), it.value()});
+          byName.erase(it);
+        }
+      }
+
+      // Baseline children left unpaired are gone (or changed type).
+      quint64 removed = 0;
+      for (const TreeNode *old : std::as_const(byName)) {
+        removed += old->size;
+      }
+      if (removed > 0) {
+        diff->removedBytes.insert(pair.row, removed);
+        if (delta <= 0) {
+          change = Change::Removed;
+        }
+      }
+    }
+
+    diff->deltas[pair.row] = delta;
+    diff->changes[pair.row] = static_cast<quint8>(change);
+  }
+  return diff;
+}
+
+TreeDiff::Change TreeDiff::changeOf(const TreeNode *node) const {
+  const qint64 row = table->rowOf(node);
+  return row < 0 ? Change::Unchanged
+                 : static_cast<Change>(changes[static_cast<size_t>(row)]);
+}
+
+qint64 TreeDiff::deltaOf(const TreeNode *node) const {
+  const qint64 row = table->rowOf(node);
+  return row < 0 ? 0 : deltas[static_cast<size_t>(row)];
+}
+
+quint64 TreeDiff::removedBytesOf(const TreeNode *node) const {
+  const qint64 row = table->rowOf(node);
+  return row < 0 ? 0 : removedBytes.value(static_cast<quint32>(row));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QHash>
+#include <memory>
+#include <vector>
+
+#include "NodeTable.h"
+#include "TreeModel.h"
+
+// Changes of a scan relative to an earlier baseline scan of the same volume.
+// Items are paired by path: each folder's children are joined by name
+// against a hash table of its baseline counterpart's children, so the diff
+// is linear in the size of both trees and never builds full paths. Meant
+// for a worker thread; neither tree may change while it is computed.
+class TreeDiff {
+public:
+  enum class Change : quint8 {
+    Unchanged,
+    Grew,
+    Shrank,
+    Added,   // No item at this path in the baseline
+    Removed, // Folder that lost baseline items and did not grow overall
+  };
+
+  static std::shared_ptr<const TreeDiff>
+  compute(std::shared_ptr<const NodeTable> current, const TreeNode *baseline);
+
+  // Nodes that are not rows of nodeTable() report Unchanged and no delta.
+  Change changeOf(const TreeNode *node) const;
+  // Bytes gained since the baseline (negative when lost); the whole size
+  // for added items.
+  qint64 deltaOf(const TreeNode *node) const;
+  // Bytes of the baseline items directly inside `node` that are gone.
+  quint64 removedBytesOf(const TreeNode *node) const;
+
+  const std::shared_ptr<const NodeTable> &nodeTable() const { return table; }
+
+private:
+  TreeDiff() = default;
+
+  std::shared_ptr<const NodeTable> table;
+  std::vector<qint64> deltas;  // Per row
+  std::vector<quint8> changes; // Per row, a Change
+  QHash<quint32, quint64> removedBytes;
+};
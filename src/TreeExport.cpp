@@ -0,0 +1,267 @@
+#include "TreeExport.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+
+namespace TreeExport {
+
+namespace {
+
+constexpr qsizetype kBufferSize = 1024 * 1024;
+constexpr quint64 kProgressInterval = 64 * 1024;
+
+bool fail(QString *errorOut, const QString &message) {
+  if (errorOut) {
+    *errorOut = message;
+  }
+  return false;
+}
+
+// Buffered file output, optionally gzip-compressed on the fly.
+class OutputSink {
+public:
+  ~OutputSink() {
+    if (gzip) {
+      deflateEnd(&stream);
+    }
+  }
+
+  bool open(const QString &path, bool compress) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      return false;
+    }
+    created = true;
+    if (compress) {
+      std::memset(&stream, 0, sizeof(stream));
+      if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      gzip = true;
+      compressed.resize(kBufferSize);
+    }
+    buffer.reserve(kBufferSize + 4096);
+    return true;
+  }
+
+  QByteArray &data() { return buffer; }
+
+  // Hand the buffered rows to the file once enough have accumulated.
+  bool maybeFlush() { return buffer.size() < kBufferSize || flush(Z_NO_FLUSH); }
+
+  bool finish() {
+    if (!flush(Z_FINISH)) {
+      return false;
+    }
+    file.close();
+    return file.error() == QFileDevice::NoError;
+  }
+
+  // Drop the partially written file.
+  void abort() {
+    file.close();
+    if (created) {
+      file.remove();
+    }
+  }
+
+private:
+  bool flush(int mode) {
+    if (!gzip) {
+      const bool ok = buffer.isEmpty() || file.write(buffer) == buffer.size();
+      buffer.clear();
+      return ok;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(buffer.data());
+    stream.avail_in = static_cast<uInt>(buffer.size());
+    int result = Z_OK;
+    do {
+      stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+      stream.avail_out = static_cast<uInt>(compressed.size());
+      result = deflate(&stream, mode);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      const qsizetype produced =
+          compressed.size() - static_cast<qsizetype>(stream.avail_out);
+      if (produced > 0 &&
+          file.write(compressed.constData(), produced) != produced) {
+        return false;
+      }
+    } while (stream.avail_out == 0 ||
+             (mode == Z_FINISH && result != Z_STREAM_END));
+    buffer.clear();
+    return true;
+  }
+
+  QFile file;
+  QByteArray buffer;
+  QByteArray compressed;
+  z_stream stream;
+  bool gzip = false;
+  bool created = false;
+};
+
+void appendCsvField(QByteArray &out, const QByteArray &field) {
+  if (field.indexOf(',') < 0 && field.indexOf('"') < 0 &&
+      field.indexOf('\n') < 0 && field.indexOf('\r') < 0) {
+    out += field;
+    return;
+  }
+  out += '"';
+  for (char c : field) {
+    if (c == '"') {
+      out += '"';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+void appendJsonString(QByteArray &out, const QByteArray &text) {
+  static const char kHex[] = "0123456789abcdef";
+  out += '"';
+  for (char c : text) {
+    const auto byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (byte < 0x20) {
+      out += "\\u00";
+      out += kHex[byte >> 4];
+      out += kHex[byte & 0xf];
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+void appendRow(QByteArray &out, Format format, const QByteArray &path,
+               const TreeNode *node, int depth) {
+  const char *type = node->isDir ? "folder" : "file";
+  if (format == Format::Csv) {
+    appendCsvField(out, path);
+    out += ',';
+    out += QByteArray::number(node->size);
+    out += ',';
+    out += type;
+    out += ',';
+    out += QByteArray::number(depth);
+    out += '\n';
+    return;
+  }
+
+  out += "{\"path\":";
+  appendJsonString(out, path);
+  out += ",\"size\":";
+  out += QByteArray::number(node->size);
+  out += ",\"type\":\"";
+  out += type;
+  out += "\",\"depth\":";
+  out += QByteArray::number(depth);
+  out += "}\n";
+}
+
+} // namespace
+
+Format formatForPath(const QString &path) {
+  QString name = path.toLower();
+  if (name.endsWith(QLatin1String(".gz"))) {
+    name.chop(3);
+  }
+  if (name.endsWith(QLatin1String(".ndjson")) ||
+      name.endsWith(QLatin1String(".jsonl"))) {
+    return Format::NdJson;
+  }
+  return Format::Csv;
+}
+
+bool exportTree(const TreeNode *root, const QString &path, Format format,
+                QString *errorOut,
+                const std::function<bool(quint64)> &progress) {
+  if (!root) {
+    return fail(errorOut, QObject::tr("Nothing to export."));
+  }
+
+  OutputSink sink;
+  if (!sink.open(path, path.endsWith(QLatin1String(".gz"),
+                                     Qt::CaseInsensitive))) {
+    sink.abort();
+    return fail(errorOut,
+                QObject::tr("Failed to open %1 for writing.").arg(path));
+  }
+  if (format == Format::Csv) {
+    sink.data() += "path,size,type,depth\n";
+  }
+
+  struct Frame {
+    const TreeNode *node = nullptr;
+    qsizetype pathLength = 0; // Length of the parent's path
+    qsizetype nextChild = 0;
+  };
+
+  // Siblings share their parent's prefix: the path buffer is only ever
+  // appended to on the way down and truncated on the way back up.
+  QByteArray pathBuffer;
+  std::vector<Frame> stack;
+  quint64 rows = 0;
+
+  auto enter = [&](const TreeNode *node) {
+    Frame frame;
+    frame.node = node;
+    frame.pathLength = pathBuffer.size();
+    if (!stack.empty() && !pathBuffer.endsWith('/')) {
+      pathBuffer += '/';
+    }
+    pathBuffer += node->name.toUtf8();
+    appendRow(sink.data(), format, pathBuffer, node,
+              static_cast<int>(stack.size()));
+    stack.push_back(frame);
+    ++rows;
+  };
+
+  enter(root);
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+    if (frame.nextChild == frame.node->children.size()) {
+      pathBuffer.truncate(frame.pathLength);
+      stack.pop_back();
+      continue;
+    }
+
+    const TreeNode *child = frame.node->children[frame.nextChild++];
+    if (!child) {
+      continue;
+    }
+    enter(child);
+
+    if (!sink.maybeFlush()) {
+      sink.abort();
+      return fail(errorOut, QObject::tr("Failed to write %1.").arg(path));
+    }
+    if (progress && rows % kProgressInterval == 0 && !progress(rows)) {
+      sink.abort();
+      return fail(errorOut, QObject::tr("Export cancelled."));
+    }
+  }
+
+  if (!sink.finish()) {
+    sink.abort();
+    return fail(errorOut, QObject::tr("Failed to write %1.").arg(path));
+  }
+  if (progress) {
+    progress(rows);
+  }
+  return true;
+}
+
+} // namespace TreeExport
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+#include <functional>
+
+#include "TreeModel.h"
+
+namespace TreeExport {
+
+enum class Format {
+  Csv,
+  NdJson,
+};
+
+// ".ndjson" and ".jsonl" (optionally followed by ".gz") select NDJSON;
+// anything else is CSV.
+Format formatForPath(const QString &path);
+
+// Write path, size, type and depth of every node under `root` in one
+// depth-first pass. Output is buffered and gzip-compressed when `path` ends
+// in ".gz". `progress` gets the rows written so far and returns false to
+// cancel.
+bool exportTree(const TreeNode *root, const QString &path, Format format,
+                QString *errorOut,
+                const std::function<bool(quint64 rows)> &progress = {});
+
+} // namespace TreeExport
@@ -4,23 +4,19 @@
 #include <memory>
 #include <queue>
 
-namespace {
+#include "AllocStats.h"
+#include "Trace.h"
 
-void mirrorRects(TreeNode *node, const QRectF &rootBounds) {
-  if (!node) {
-    return;
-  }
+namespace {
 
-  const QRectF r = node->rect;
+// GrandPerspective-compatible orientation: mirror both X and Y within the
+// root bounds.
+QRectF mirrorRect(const QRectF &r, const QRectF &rootBounds) {
   const double newX = rootBounds.x() + rootBounds.width() -
                       (r.x() - rootBounds.x()) - r.width();
   const double newY = rootBounds.y() + rootBounds.height() -
                       (r.y() - rootBounds.y()) - r.height();
-  node->rect = QRectF(newX, newY, r.width(), r.height());
-
-  for (TreeNode *child : node->children) {
-    mirrorRects(child, rootBounds);
-  }
+  return QRectF(newX, newY, r.width(), r.height());
 }
 
 struct LayoutNode {
@@ -30,9 +26,30 @@ struct LayoutNode {
   double size = 0.0;
 };
 
+struct Placement {
+  TreeNode *node = nullptr;
+  QRectF rect;
+};
+
+struct LayoutContext {
+  std::vector<std::unique_ptr<LayoutNode>> storage;
+  QRectF rootBounds;
+  // Without a visitor the layout is written to `rects`.
+  const TreeLayout::Visitor *visitor = nullptr;
+  double minSize = 0.0;
+  QRectF clip;
+  // Filter state the sizes come from; nothing is hidden without one.
+  const TreeLayout::ViewState *view = nullptr;
+  std::vector<QRectF> *rects = nullptr;
+
+  quint64 sizeOf(const TreeNode *node) const {
+    return view ? view->visibleSize(node) : node->size;
+  }
+};
+
 LayoutNode *
-buildBalancedTree(const QVector<TreeNode *> &items,
-                  std::vector<std::unique_ptr<LayoutNode>> &storage) {
+buildBalancedTree(const QVector<TreeNode *> &items, LayoutContext &ctx) {
+  std::vector<std::unique_ptr<LayoutNode>> &storage = ctx.storage;
   auto makeNode = [&](TreeNode *leaf, LayoutNode *left, LayoutNode *right,
                       double size) {
     storage.emplace_back(std::make_unique<LayoutNode>());
@@ -58,11 +75,12 @@ buildBalancedTree(const QVector<TreeNode *> &items,
   std::priority_queue<NodeRef, std::vector<NodeRef>, Compare> queue;
 
   for (TreeNode *item : items) {
-    if (!item || item->size == 0) {
+    const quint64 itemSize = item ? ctx.sizeOf(item) : 0;
+    if (itemSize == 0) {
       continue;
     }
     LayoutNode *leaf =
-        makeNode(item, nullptr, nullptr, static_cast<double>(item->size));
+        makeNode(item, nullptr, nullptr, static_cast<double>(itemSize));
     queue.push({leaf, leaf->size});
   }
 
@@ -84,14 +102,13 @@ buildBalancedTree(const QVector<TreeNode *> &items,
 }
 
 void layoutBinary(LayoutNode *node, const QRectF &rect,
-                  QVector<TreeNode *> &leaves) {
+                  QVector<Placement> &leaves) {
   if (!node) {
     return;
   }
 
   if (node->leaf) {
-    node->leaf->rect = rect;
-    leaves.push_back(node->leaf);
+    leaves.push_back({node->leaf, rect});
     return;
   }
 
@@ -121,15 +138,30 @@ void layoutBinary(LayoutNode *node, const QRectF &rect,
 }
 
 void layoutGroup(const QVector<TreeNode *> &items, const QRectF &bounds,
-                 std::vector<std::unique_ptr<LayoutNode>> &storage);
+                 int depth, LayoutContext &ctx);
 
-void layoutNode(TreeNode *node, const QRectF &bounds,
-                std::vector<std::unique_ptr<LayoutNode>> &storage) {
+void layoutNode(TreeNode *node, const QRectF &bounds, int depth,
+                LayoutContext &ctx) {
   if (!node) {
     return;
   }
 
-  node->rect = bounds;
+  if (ctx.visitor) {
+    if (bounds.width() < ctx.minSize || bounds.height() < ctx.minSize) {
+      return;
+    }
+    const QRectF rect = mirrorRect(bounds, ctx.rootBounds);
+    if (!ctx.clip.isNull() && !rect.intersects(ctx.clip)) {
+      return;
+    }
+    (*ctx.visitor)(node, rect, depth);
+  } else {
+    if (node->id >= ctx.rects->size()) {
+      ctx.rects->resize(node->id + 1);
+    }
+    (*ctx.rects)[node->id] = mirrorRect(bounds, ctx.rootBounds);
+  }
+
   if (node->children.isEmpty()) {
     return;
   }
@@ -143,15 +175,16 @@ void layoutNode(TreeNode *node, const QRectF &bounds,
   double dirSize = 0.0;
 
   for (TreeNode *child : node->children) {
-    if (!child || child->size == 0) {
+    const quint64 childSize = child ? ctx.sizeOf(child) : 0;
+    if (childSize == 0) {
       continue;
     }
     if (child->isDir) {
       dirs.push_back(child);
-      dirSize += static_cast<double>(child->size);
+      dirSize += static_cast<double>(childSize);
     } else {
       files.push_back(child);
-      fileSize += static_cast<double>(child->size);
+      fileSize += static_cast<double>(childSize);
     }
   }
 
@@ -167,50 +200,88 @@ void layoutNode(TreeNode *node, const QRectF &bounds,
       QRectF fileRect(bounds.x(), bounds.y(), w, bounds.height());
       QRectF dirRect(bounds.x() + w, bounds.y(), bounds.width() - w,
                      bounds.height());
-      layoutGroup(files, fileRect, storage);
-      layoutGroup(dirs, dirRect, storage);
+      layoutGroup(files, fileRect, depth, ctx);
+      layoutGroup(dirs, dirRect, depth, ctx);
     } else {
       double h = bounds.height() * ratio;
       QRectF fileRect(bounds.x(), bounds.y(), bounds.width(), h);
       QRectF dirRect(bounds.x(), bounds.y() + h, bounds.width(),
                      bounds.height() - h);
-      layoutGroup(files, fileRect, storage);
-      layoutGroup(dirs, dirRect, storage);
+      layoutGroup(files, fileRect, depth, ctx);
+      layoutGroup(dirs, dirRect, depth, ctx);
     }
   } else {
     // Either only files or only dirs
     QVector<TreeNode *> all = files;
     all += dirs;
-    layoutGroup(all, bounds, storage);
+    layoutGroup(all, bounds, depth, ctx);
   }
 }
 
 void layoutGroup(const QVector<TreeNode *> &items, const QRectF &bounds,
-                 std::vector<std::unique_ptr<LayoutNode>> &storage) {
+                 int depth, LayoutContext &ctx) {
   if (items.isEmpty()) {
     return;
   }
 
-  LayoutNode *root = buildBalancedTree(items, storage);
+  // The balanced tree is only needed to place this group; release it before
+  // descending so storage never holds more than one group.
+  const size_t mark = ctx.storage.size();
+  LayoutNode *root = buildBalancedTree(items, ctx);
   if (!root) {
     return;
   }
 
-  QVector<TreeNode *> leaves;
+  QVector<Placement> leaves;
   layoutBinary(root, bounds, leaves);
+  ctx.storage.resize(mark);
 
-  for (TreeNode *leaf : leaves) {
-    layoutNode(leaf, leaf->rect, storage);
+  for (const Placement &leaf : leaves) {
+    layoutNode(leaf.node, leaf.rect, depth + 1, ctx);
   }
 }
 
 } // namespace
 
-void TreeLayout::layout(TreeNode *root, const QRectF &bounds) {
-  std::vector<std::unique_ptr<LayoutNode>> storage;
-  layoutNode(root, bounds, storage);
+void TreeLayout::layout(TreeNode *root, const QRectF &bounds,
+                        ViewState &view) {
+  Trace::Scope trace("TreeLayout::layout");
+  AllocStats::Scope allocations("layout");
+  LayoutContext ctx;
+  ctx.rootBounds = bounds;
+  ctx.view = &view;
+  ctx.rects = &view.rects;
+  layoutNode(root, bounds, 0, ctx);
+}
 
-  // GrandPerspective-compatible orientation: mirror both X and Y within the
-  // root bounds.
-  mirrorRects(root, bounds);
+void TreeLayout::visit(TreeNode *root, const QRectF &bounds, double minSize,
+                       const Visitor &visitor, const QRectF &clip,
+                       const ViewState *view) {
+  LayoutContext ctx;
+  ctx.rootBounds = bounds;
+  ctx.visitor = &visitor;
+  ctx.minSize = minSize;
+  ctx.clip = clip;
+  ctx.view = view;
+  layoutNode(root, bounds, 0, ctx);
+}
+
+TreeNode *TreeLayout::nodeAt(TreeNode *root, const QPointF &pos,
+                             const ViewState &view) {
+  if (!root || !view.rect(root).contains(pos)) {
+    return nullptr;
+  }
+
+  TreeNode *node = root;
+  for (bool descended = true; descended;) {
+    descended = false;
+    for (TreeNode *child : node->children) {
+      if (!view.isHidden(child) && view.rect(child).contains(pos)) {
+        node = child;
+        descended = true;
+        break;
+      }
+    }
+  }
+  return node;
 }
@@ -2,9 +2,56 @@
 
 #include <QRectF>
 
+#include <functional>
+#include <vector>
+
 #include "TreeModel.h"
 
 class TreeLayout {
 public:
-  static void layout(TreeNode *root, const QRectF &bounds);
+  // What one view shows of a model, indexed by TreeNode::id: its filter
+  // state and the rectangles of its last layout. Nodes are shared between
+  // model versions, so none of this is kept in them.
+  struct ViewState {
+    std::vector<QRectF> rects;
+    std::vector<quint8> hidden;       // Filtered out of the treemap
+    std::vector<quint64> hiddenSizes; // Bytes of hidden items below a node
+
+    QRectF rect(const TreeNode *node) const {
+      return node->id < rects.size() ? rects[node->id] : QRectF();
+    }
+    bool isHidden(const TreeNode *node) const {
+      return node->id < hidden.size() && hidden[node->id] != 0;
+    }
+    // Size the treemap gives `node` once hidden items are left out.
+    quint64 visibleSize(const TreeNode *node) const {
+      if (isHidden(node)) {
+        return 0;
+      }
+      const quint64 removed =
+          node->id < hiddenSizes.size() ? hiddenSizes[node->id] : 0;
+      return removed >= node->size ? 0 : node->size - removed;
+    }
+  };
+
+  // Called for every laid-out node, parents before their children. `depth` is
+  // relative to the root passed to visit().
+  using Visitor =
+      std::function<void(TreeNode *node, const QRectF &rect, int depth)>;
+
+  // Store the rectangles of the whole subtree under `root` in `view`,
+  // leaving out what its filter hides.
+  static void layout(TreeNode *root, const QRectF &bounds, ViewState &view);
+
+  // Compute the same layout without storing it. Subtrees whose rectangle is
+  // narrower or shorter than `minSize`, or that lie outside a non-null
+  // `clip`, are pruned. Without a `view` nothing is filtered out.
+  static void visit(TreeNode *root, const QRectF &bounds, double minSize,
+                    const Visitor &visitor, const QRectF &clip = QRectF(),
+                    const ViewState *view = nullptr);
+
+  // Deepest visible node under `root` whose rectangle in `view` contains
+  // `pos`, or null if that of `root` does not.
+  static TreeNode *nodeAt(TreeNode *root, const QPointF &pos,
+                          const ViewState &view);
 };
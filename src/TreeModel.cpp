@@ -1,19 +1,122 @@
 #include "TreeModel.h"
 
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "Trace.h"
+
+namespace {
+
+constexpr quint32 kNoParent = 0xffffffffu;
+constexpr quint32 kIdsPerChunk = 4096;
+
+} // namespace
+
 TreeModel::~TreeModel() {
   deleteSubtree(rootNode);
   rootNode = nullptr;
 }
 
 void TreeModel::deleteSubtree(TreeNode *node) {
-  if (!node) {
-    return;
+  std::vector<TreeNode *> pending;
+  if (node) {
+    pending.push_back(node);
   }
+  while (!pending.empty()) {
+    TreeNode *current = pending.back();
+    pending.pop_back();
+    if (current->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      continue;
+    }
+    for (TreeNode *child : current->children) {
+      if (child) {
+        pending.push_back(child);
+      }
+    }
+    delete current;
+  }
+}
 
-  for (TreeNode *child : node->children) {
-    deleteSubtree(child);
+TreeNode *TreeModel::byId(quint32 id) const {
+  if (id >= idLimit) {
+    return nullptr;
+  }
+  return (*nodesById[id / kIdsPerChunk])[id % kIdsPerChunk];
+}
+
+void TreeModel::setById(quint32 id, TreeNode *node) {
+  // A chunk still held by another version is copied before the write.
+  std::shared_ptr<IdChunk> &chunk = nodesById[id / kIdsPerChunk];
+  if (chunk.use_count() > 1) {
+    chunk = std::make_shared<IdChunk>(*chunk);
+  }
+  (*chunk)[id % kIdsPerChunk] = node;
+}
+
+TreeNode *TreeModel::parentOf(const TreeNode *node) const {
+  if (!contains(node)) {
+    return nullptr;
+  }
+  const quint32 parent = (*parentIds)[node->id];
+  return parent == kNoParent ? nullptr : byId(parent);
+}
+
+bool TreeModel::contains(const TreeNode *node) const {
+  return node && byId(node->id) == node;
+}
+
+int TreeModel::depthOf(const TreeNode *node) const {
+  if (!contains(node)) {
+    return 0;
+  }
+  int depth = 0;
+  for (quint32 id = (*parentIds)[node->id]; id != kNoParent;
+       id = (*parentIds)[id]) {
+    ++depth;
+  }
+  return depth;
+}
+
+void TreeModel::numberNodes() {
+  struct Pending {
+    TreeNode *node = nullptr;
+    quint32 parent = kNoParent;
+  };
+
+  std::vector<TreeNode *> order;
+  auto parents = std::make_shared<std::vector<quint32>>();
+  std::vector<Pending> pending;
+  if (rootNode) {
+    pending.push_back({rootNode, kNoParent});
+  }
+  while (!pending.empty()) {
+    const Pending current = pending.back();
+    pending.pop_back();
+
+    const auto id = static_cast<quint32>(order.size());
+    current.node->id = id;
+    order.push_back(current.node);
+    parents->push_back(current.parent);
+    for (auto it = current.node->children.crbegin();
+         it != current.node->children.crend(); ++it) {
+      if (*it) {
+        pending.push_back({*it, id});
+      }
+    }
   }
-  delete node;
+
+  nodesById.clear();
+  for (size_t first = 0; first < order.size(); first += kIdsPerChunk) {
+    const size_t last = std::min(order.size(), first + kIdsPerChunk);
+    nodesById.push_back(std::make_shared<IdChunk>(order.begin() + first,
+                                                  order.begin() + last));
+  }
+  parentIds = std::move(parents);
+  idLimit = static_cast<quint32>(order.size());
 }
 
 quint64 TreeModel::computeSize(TreeNode *node) {
@@ -37,4 +140,126 @@ quint64 TreeModel::computeSize(TreeNode *node) {
   return node->size;
 }
 
-void TreeModel::computeDerivedSizes() { computeSize(rootNode); }
+TreeModel::MemoryReport TreeModel::memoryReport(const TreeNode *node) {
+  // Allocated arrays carry a header in front of their elements.
+  auto arrayBytes = [](qsizetype capacity, size_t elementSize) -> quint64 {
+    return capacity > 0 ? sizeof(QArrayData) +
+                              static_cast<quint64>(capacity) * elementSize
+                        : 0;
+  };
+
+  MemoryReport report;
+  std::vector<const TreeNode *> pending;
+  if (node) {
+    pending.push_back(node);
+  }
+  while (!pending.empty()) {
+    const TreeNode *current = pending.back();
+    pending.pop_back();
+    ++report.nodes;
+    report.nodeBytes += sizeof(TreeNode);
+    report.childBytes +=
+        arrayBytes(current->children.capacity(), sizeof(TreeNode *));
+    report.nameBytes += arrayBytes(current->name.capacity(), sizeof(QChar));
+    for (const TreeNode *child : current->children) {
+      pending.push_back(child);
+    }
+  }
+  return report;
+}
+
+std::shared_ptr<TreeModel>
+TreeModel::withoutSubtrees(const TreeModel &model,
+                           const std::vector<const TreeNode *> &removed) {
+  Trace::Scope trace("TreeModel::withoutSubtrees");
+  auto copy = std::make_shared<TreeModel>();
+  copy->revision = model.revision + 1;
+  copy->measure = model.measure;
+
+  TreeNode *root = model.root();
+  QSet<const TreeNode *> requested;
+  for (const TreeNode *node : removed) {
+    if (model.contains(node)) {
+      requested.insert(node);
+    }
+  }
+  if (!root || requested.contains(root)) {
+    return copy;
+  }
+  copy->nodesById = model.nodesById;
+  copy->parentIds = model.parentIds;
+  copy->idLimit = model.idLimit;
+
+  // Bytes each ancestor loses. A node inside another removed subtree is
+  // already accounted for by that one. The ancestors are the only nodes
+  // that get copied.
+  QSet<const TreeNode *> tops;
+  QHash<const TreeNode *, quint64> lost;
+  for (const TreeNode *node : std::as_const(requested)) {
+    const TreeNode *cur = model.parentOf(node);
+    while (cur && !requested.contains(cur)) {
+      cur = model.parentOf(cur);
+    }
+    if (cur) {
+      continue;
+    }
+    tops.insert(node);
+    for (cur = model.parentOf(node); cur; cur = model.parentOf(cur)) {
+      lost[cur] += node->size;
+    }
+  }
+
+  QHash<const TreeNode *, TreeNode *> copies;
+  copies.reserve(lost.size());
+  for (auto it = lost.cbegin(); it != lost.cend(); ++it) {
+    auto *node = new TreeNode();
+    node->name = it.key()->name;
+    node->isDir = it.key()->isDir;
+    node->size = it.key()->size - it.value();
+    node->id = it.key()->id;
+    copies.insert(it.key(), node);
+  }
+
+  // Copies point at each other along the paths and share everything else.
+  for (auto it = copies.cbegin(); it != copies.cend(); ++it) {
+    TreeNode *node = it.value();
+    node->children.reserve(it.key()->children.size());
+    for (TreeNode *child : it.key()->children) {
+      if (!child || tops.contains(child)) {
+        continue;
+      }
+      TreeNode *path = copies.value(child);
+      if (!path) {
+        child->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+      node->children.push_back(path ? path : child);
+    }
+    copy->setById(node->id, node);
+  }
+
+  copy->rootNode = copies.value(root);
+  if (!copy->rootNode) {
+    root->refs.fetch_add(1, std::memory_order_relaxed);
+    copy->rootNode = root;
+  }
+
+  // Ids of removed nodes no longer resolve in the new version.
+  std::vector<const TreeNode *> pending(tops.cbegin(), tops.cend());
+  while (!pending.empty()) {
+    const TreeNode *node = pending.back();
+    pending.pop_back();
+    copy->setById(node->id, nullptr);
+    for (const TreeNode *child : node->children) {
+      if (child) {
+        pending.push_back(child);
+      }
+    }
+  }
+  return copy;
+}
+
+void TreeModel::computeDerivedSizes() {
+  Trace::Scope trace("TreeModel::computeDerivedSizes");
+  computeSize(rootNode);
+  numberNodes();
+}
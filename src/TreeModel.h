@@ -1,32 +1,103 @@
 #pragma once
 
-#include <QRectF>
 #include <QString>
 #include <QVector>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Nodes are shared between the versions of a model: an edit copies only the
+// nodes on the paths from the edited places up to the root and points the
+// copies at the untouched subtrees of the old version. Apart from its atomic
+// reference count a shared node never changes, so background jobs may read
+// nodes without locks. A parent depends on the version, so it is found
+// through TreeModel::parentOf(); rectangles and filter state belong to a
+// view (see TreeLayout::ViewState).
 struct TreeNode {
   QString name;
   quint64 size = 0;
   bool isDir = false;
-
-  TreeNode *parent = nullptr;
+  quint32 id = 0; // Pre-order number; copies in later versions keep it
+  // Parents and models holding this node; see TreeModel::deleteSubtree().
+  std::atomic<quint32> refs{1};
   QVector<TreeNode *> children;
-  QRectF rect;
 };
 
 class TreeModel {
 public:
+  // How the scan measured file sizes, from ScanInfo's fileSizeMeasure.
+  enum class SizeMeasure {
+    Logical,  // Bytes of data, as st_size
+    Physical, // Bytes of the blocks allocated on disk
+  };
+
   TreeModel() = default;
   ~TreeModel();
 
   TreeNode *root() const { return rootNode; }
+  // Takes over the caller's reference to `node`.
   void setRoot(TreeNode *node) { rootNode = node; }
 
+  // Sum folder sizes and number the nodes for parentOf(). Call once the
+  // tree is built, before the model is shared.
   void computeDerivedSizes();
 
+  // Parent of `node` in this version, or null for the root and for nodes
+  // this version does not contain.
+  TreeNode *parentOf(const TreeNode *node) const;
+  // Whether `node` belongs to this version rather than another one.
+  bool contains(const TreeNode *node) const;
+  // Levels between the root and `node`; 0 for the root.
+  int depthOf(const TreeNode *node) const;
+  // One past the largest TreeNode::id; per-view arrays are sized to it.
+  quint32 nodeIdLimit() const { return idLimit; }
+
+  SizeMeasure sizeMeasure() const { return measure; }
+  void setSizeMeasure(SizeMeasure value) { measure = value; }
+
+  // Edits applied since the scan was loaded; each edit makes a new model.
+  quint64 version() const { return revision; }
+
+  // A version of `model` without the subtrees under `removed` and with the
+  // sizes of their ancestors reduced to match. Only those ancestors are
+  // copied; every other subtree is shared with `model`, which is only read,
+  // so jobs still holding it are unaffected.
+  static std::shared_ptr<TreeModel>
+  withoutSubtrees(const TreeModel &model,
+                  const std::vector<const TreeNode *> &removed);
+
+  // Drop one reference to `node`, deleting whatever part of its subtree no
+  // other parent or model still holds.
   static void deleteSubtree(TreeNode *node);
   static quint64 computeSize(TreeNode *node);
 
+  // Approximate heap bytes held by a subtree, by what they are spent on.
+  struct MemoryReport {
+    quint64 nodes = 0;
+    quint64 nodeBytes = 0;  // TreeNode structs
+    quint64 childBytes = 0; // Child pointer arrays
+    quint64 nameBytes = 0;
+
+    quint64 totalBytes() const { return nodeBytes + childBytes + nameBytes; }
+  };
+
+  static MemoryReport memoryReport(const TreeNode *node);
+
 private:
+  using IdChunk = std::vector<TreeNode *>;
+
+  TreeNode *byId(quint32 id) const;
+  void setById(quint32 id, TreeNode *node);
+  void numberNodes();
+
   TreeNode *rootNode = nullptr;
+  // Node of each id in this version, in chunks that versions share until
+  // one of them writes to a chunk.
+  std::vector<std::shared_ptr<IdChunk>> nodesById;
+  // Parent id of each id; the same for every version of a scan.
+  std::shared_ptr<const std::vector<quint32>> parentIds;
+  quint32 idLimit = 0;
+  quint64 revision = 0;
+  SizeMeasure measure = SizeMeasure::Logical;
 };
@@ -4,163 +4,265 @@
 #include <QFile>
 #include <QXmlStreamReader>
 
+#include <cstring>
+
 #include <zlib.h>
 
-static bool isTreeElement(const QString &name) {
+#include "AllocStats.h"
+#include "Trace.h"
+
+namespace {
+
+constexpr qint64 kChunkSize = 256 * 1024;
+
+bool isTreeElement(QStringView name) {
   return name == QLatin1String("Folder") || name == QLatin1String("File");
 }
 
-static bool isGzipData(const QByteArray &data) {
+bool isGzipData(const QByteArray &data) {
   return data.size() >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
          static_cast<unsigned char>(data[1]) == 0x8b;
 }
 
-static QByteArray inflateGzip(const QByteArray &compressed, QString *errorOut) {
-  if (compressed.isEmpty()) {
-    return QByteArray();
+void setError(QString *errorOut, const QString &message) {
+  if (errorOut) {
+    *errorOut = message;
   }
+}
 
-  z_stream stream;
-  std::memset(&stream, 0, sizeof(stream));
+// Yields the XML of a plain or gzip-compressed file one chunk at a time.
+class XmlSource {
+public:
+  ~XmlSource() {
+    if (gzip) {
+      inflateEnd(&stream);
+    }
+  }
 
-  int initResult = inflateInit2(&stream, 15 + 16);
-  if (initResult != Z_OK) {
-    if (errorOut) {
-      *errorOut = QObject::tr("Failed to initialize gzip decoder.");
+  bool open(const QString &path, QString *errorOut) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+      setError(errorOut, QObject::tr("Failed to open file."));
+      return false;
     }
-    return QByteArray();
+
+    pending = file.read(kChunkSize);
+    if (pending.isEmpty()) {
+      setError(errorOut, QObject::tr("File is empty."));
+      return false;
+    }
+
+    if (isGzipData(pending)) {
+      std::memset(&stream, 0, sizeof(stream));
+      if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        setError(errorOut, QObject::tr("Failed to initialize gzip decoder."));
+        return false;
+      }
+      gzip = true;
+      stream.next_in = reinterpret_cast<Bytef *>(pending.data());
+      stream.avail_in = static_cast<uInt>(pending.size());
+    }
+    return true;
   }
 
-  stream.next_in =
-      reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
-  stream.avail_in = static_cast<uInt>(compressed.size());
-
-  QByteArray output;
-  const int chunkSize = 64 * 1024;
-  int inflateResult = Z_OK;
-
-  while (inflateResult == Z_OK) {
-    int oldSize = output.size();
-    output.resize(oldSize + chunkSize);
-    stream.next_out = reinterpret_cast<Bytef *>(output.data() + oldSize);
-    stream.avail_out = static_cast<uInt>(chunkSize);
-
-    inflateResult = inflate(&stream, Z_NO_FLUSH);
-    if (inflateResult != Z_OK && inflateResult != Z_STREAM_END) {
-      if (errorOut) {
-        *errorOut = QObject::tr("Failed to decompress gzip data (code %1).")
-                        .arg(inflateResult);
+  // Read the next piece of XML; an empty result marks the end of input.
+  bool read(QByteArray *out, QString *errorOut) {
+    if (!gzip) {
+      if (!pending.isEmpty()) {
+        *out = std::move(pending);
+        pending.clear();
+      } else {
+        *out = file.read(kChunkSize);
       }
-      inflateEnd(&stream);
-      return QByteArray();
+      return true;
     }
 
-    int produced = chunkSize - static_cast<int>(stream.avail_out);
-    output.resize(oldSize + produced);
+    Trace::Scope trace("TreeReader::inflate");
+    out->clear();
+    while (out->isEmpty() && !finished) {
+      if (stream.avail_in == 0) {
+        pending = file.read(kChunkSize);
+        if (pending.isEmpty()) {
+          setError(errorOut,
+                   QObject::tr("Failed to decompress gzip data (code %1).")
+                       .arg(Z_BUF_ERROR));
+          return false;
+        }
+        stream.next_in = reinterpret_cast<Bytef *>(pending.data());
+        stream.avail_in = static_cast<uInt>(pending.size());
+      }
+
+      out->resize(kChunkSize);
+      stream.next_out = reinterpret_cast<Bytef *>(out->data());
+      stream.avail_out = static_cast<uInt>(kChunkSize);
+
+      const int result = inflate(&stream, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END) {
+        setError(errorOut,
+                 QObject::tr("Failed to decompress gzip data (code %1).")
+                     .arg(result));
+        return false;
+      }
+      out->resize(kChunkSize - static_cast<qsizetype>(stream.avail_out));
+      finished = result == Z_STREAM_END;
+    }
+    trace.setArg("bytes", out->size());
+    return true;
   }
 
-  inflateEnd(&stream);
-  return output;
-}
+  // Bytes of the file consumed so far, compressed or not.
+  qint64 position() const { return file.pos(); }
+
+private:
+  QFile file;
+  QByteArray pending;
+  z_stream stream;
+  bool gzip = false;
+  bool finished = false;
+};
+
+// Builds a TreeModel from the reader's events.
+class ModelBuilder : public TreeReader::Handler {
+public:
+  explicit ModelBuilder(TreeModel &model) : model(model) {}
+
+  void startNode(const QString &name, quint64 size, bool isDir) override {
+    TreeNode *node = new TreeNode();
+    node->name = name;
+    node->size = size;
+    node->isDir = isDir;
+
+    if (!stack.isEmpty()) {
+      stack.last()->children.push_back(node);
+    } else {
+      model.setRoot(node);
+    }
+    stack.push_back(node);
+  }
+
+  void endNode() override {
+    if (!stack.isEmpty()) {
+      stack.removeLast();
+    }
+  }
+
+  void sizeMeasure(TreeModel::SizeMeasure measure) override {
+    model.setSizeMeasure(measure);
+  }
+
+private:
+  TreeModel &model;
+  QVector<TreeNode *> stack;
+};
+
+} // namespace
 
 std::shared_ptr<TreeModel> TreeReader::readFromFile(const QString &path,
                                                     QString *errorOut) {
-  QFile file(path);
-  if (!file.open(QIODevice::ReadOnly)) {
-    if (errorOut) {
-      *errorOut = QObject::tr("Failed to open file.");
-    }
+  Trace::Scope trace("TreeReader::readFromFile");
+  AllocStats::Scope allocations("load");
+  auto model = std::make_shared<TreeModel>();
+  ModelBuilder builder(*model);
+  if (!parseFile(path, builder, errorOut)) {
     return nullptr;
   }
 
-  const QByteArray rawData = file.readAll();
-  if (rawData.isEmpty()) {
-    if (errorOut) {
-      *errorOut = QObject::tr("File is empty.");
-    }
+  if (!model->root()) {
+    setError(errorOut, QObject::tr("No root node found in XML."));
     return nullptr;
   }
 
-  QByteArray xmlData;
-  QString decompressError;
-  if (isGzipData(rawData)) {
-    xmlData = inflateGzip(rawData, &decompressError);
-    if (xmlData.isEmpty()) {
-      if (errorOut) {
-        *errorOut = decompressError.isEmpty()
-                        ? QObject::tr("Failed to decompress file.")
-                        : decompressError;
-      }
-      return nullptr;
-    }
-  } else {
-    xmlData = rawData;
+  model->computeDerivedSizes();
+  return model;
+}
+
+bool TreeReader::parseFile(const QString &path, Handler &handler,
+                           QString *errorOut) {
+  Trace::Scope trace("TreeReader::parseFile");
+  XmlSource source;
+  if (!source.open(path, errorOut)) {
+    return false;
   }
 
-  QXmlStreamReader xml(xmlData);
-  auto model = std::make_shared<TreeModel>();
-  QVector<TreeNode *> stack;
+  QXmlStreamReader xml;
   QString volumePath;
+  int depth = 0;
+  qint64 nodes = 0;
+  qint64 xmlBytes = 0;
+  bool inputDone = false;
 
-  while (!xml.atEnd()) {
+  for (;;) {
     xml.readNext();
 
+    // The reader reports a premature end whenever it runs out of data;
+    // feed it the next chunk and carry on.
+    if (xml.error() == QXmlStreamReader::PrematureEndOfDocumentError &&
+        !inputDone) {
+      QByteArray chunk;
+      if (!source.read(&chunk, errorOut)) {
+        return false;
+      }
+      if (chunk.isEmpty()) {
+        inputDone = true;
+      } else {
+        xmlBytes += chunk.size();
+        Trace::counter("fileBytes", source.position());
+        Trace::counter("xmlBytes", xmlBytes);
+        Trace::counter("nodes", nodes);
+        xml.addData(chunk);
+      }
+      continue;
+    }
+    if (xml.atEnd()) {
+      break;
+    }
+
     if (xml.isStartElement()) {
-      const QString elementName = xml.name().toString();
+      const QStringView elementName = xml.name();
       if (elementName == QLatin1String("ScanInfo")) {
         const QXmlStreamAttributes attrs = xml.attributes();
         volumePath = attrs.value(QLatin1String("volumePath")).toString();
         volumePath = QDir::cleanPath(volumePath);
+        const QStringView measure =
+            attrs.value(QLatin1String("fileSizeMeasure"));
+        if (!measure.isEmpty()) {
+          handler.sizeMeasure(measure == QLatin1String("physical")
+                                  ? TreeModel::SizeMeasure::Physical
+                                  : TreeModel::SizeMeasure::Logical);
+        }
       }
       if (isTreeElement(elementName)) {
         const bool isDir = (elementName == QLatin1String("Folder"));
         const QXmlStreamAttributes attrs = xml.attributes();
+        QString name = attrs.value(QLatin1String("name")).toString();
+        const quint64 size = attrs.value(QLatin1String("size")).toULongLong();
 
-        TreeNode *node = new TreeNode();
-        node->name = attrs.value(QLatin1String("name")).toString();
-        node->size = attrs.value(QLatin1String("size")).toULongLong();
-        node->isDir = isDir;
-
-        if (!stack.isEmpty()) {
-          node->parent = stack.last();
-          stack.last()->children.push_back(node);
-        } else {
-          if (!volumePath.isEmpty()) {
-            const QString rootName = node->name.trimmed();
-            if (rootName.isEmpty() || rootName == QLatin1String("/")) {
-              node->name = volumePath;
-            } else if (!QDir::isAbsolutePath(rootName)) {
-              node->name = QDir(volumePath).filePath(rootName);
-            }
+        if (depth == 0 && !volumePath.isEmpty()) {
+          const QString rootName = name.trimmed();
+          if (rootName.isEmpty() || rootName == QLatin1String("/")) {
+            name = volumePath;
+          } else if (!QDir::isAbsolutePath(rootName)) {
+            name = QDir(volumePath).filePath(rootName);
           }
-          model->setRoot(node);
         }
 
-        stack.push_back(node);
+        handler.startNode(name, size, isDir);
+        ++depth;
+        ++nodes;
       }
     } else if (xml.isEndElement()) {
-      if (isTreeElement(xml.name().toString())) {
-        if (!stack.isEmpty()) {
-          stack.removeLast();
-        }
+      if (isTreeElement(xml.name()) && depth > 0) {
+        --depth;
+        handler.endNode();
       }
     }
   }
 
+  trace.setArg("nodes", nodes);
   if (xml.hasError()) {
-    if (errorOut) {
-      *errorOut = QObject::tr("XML parse error: %1").arg(xml.errorString());
-    }
-    return nullptr;
+    setError(errorOut,
+             QObject::tr("XML parse error: %1").arg(xml.errorString()));
+    return false;
   }
-
-  if (!model->root()) {
-    if (errorOut) {
-      *errorOut = QObject::tr("No root node found in XML.");
-    }
-    return nullptr;
-  }
-
-  model->computeDerivedSizes();
-  return model;
+  return true;
 }
@@ -1,11 +1,32 @@
 #pragma once
 
+#include <QString>
 #include <memory>
 
 #include "TreeModel.h"
 
 class TreeReader {
 public:
+  // Receives the scan as a stream of events in document order. Every
+  // startNode() is matched by an endNode() once the item's children have
+  // been reported. The top-level name is already resolved against the
+  // volume path.
+  class Handler {
+  public:
+    virtual ~Handler() = default;
+    virtual void startNode(const QString &name, quint64 size, bool isDir) = 0;
+    virtual void endNode() = 0;
+    // Reported before the first node if the scan names its size measure.
+    virtual void sizeMeasure(TreeModel::SizeMeasure measure) {
+      Q_UNUSED(measure);
+    }
+  };
+
   static std::shared_ptr<TreeModel> readFromFile(const QString &path,
                                                  QString *errorOut);
+
+  // Parse `path` in fixed-size chunks without building a tree, so memory
+  // does not grow with the size of the scan.
+  static bool parseFile(const QString &path, Handler &handler,
+                        QString *errorOut);
 };
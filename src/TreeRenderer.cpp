@@ -0,0 +1,545 @@
+#include "TreeRenderer.h"
+
+#include <QObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "PngWriter.h"
+#include "TreeLayout.h"
+
+namespace {
+
+constexpr int kGradientSteps = 256;
+
+// Pixels per strip when exporting to PNG (16 MB of RGB32).
+constexpr qint64 kStripPixels = 4 * 1024 * 1024;
+
+std::array<QRgb, kGradientSteps> buildGradientColors(const QColor &base,
+                                                     double colorGradient) {
+  std::array<QRgb, kGradientSteps> colors{};
+
+  float hue = 0.0f;
+  float saturation = 0.0f;
+  float brightness = 0.0f;
+  float alpha = 1.0f;
+  QColor hsv = base.toHsv();
+  hsv.getHsvF(&hue, &saturation, &brightness, &alpha);
+  if (hue < 0.0f) {
+    hue = 0.0f;
+  }
+
+  auto clamp01 = [](double v) { return std::clamp(v, 0.0, 1.0); };
+
+  // Darker colors (0..127)
+  for (int j = 0; j < 128; ++j) {
+    double adjust = colorGradient * (128.0 - static_cast<double>(j)) / 128.0;
+    double b = clamp01(static_cast<double>(brightness) * (1.0 - adjust));
+    QColor mod = QColor::fromHsvF(hue, clamp01(saturation), b, clamp01(alpha));
+    colors[j] = mod.rgb();
+  }
+
+  // Lighter colors (128..255)
+  for (int j = 0; j < 128; ++j) {
+    double adjust = colorGradient * static_cast<double>(j) / 128.0;
+    double dif = 1.0 - static_cast<double>(brightness);
+    double absAdjust = (dif + saturation) * adjust;
+    double b = brightness;
+    double s = saturation;
+
+    if (absAdjust < dif) {
+      b = clamp01(static_cast<double>(brightness) + absAdjust);
+    } else {
+      s = clamp01(saturation + dif - absAdjust);
+      b = 1.0;
+    }
+
+    QColor mod = QColor::fromHsvF(hue, clamp01(s), clamp01(b), clamp01(alpha));
+    colors[128 + j] = mod.rgb();
+  }
+
+  return colors;
+}
+
+struct ModeName {
+  const char *name;
+  TreeRenderer::ColorMappingMode mode;
+};
+
+constexpr ModeName kModeNames[] = {
+    {"extension", TreeRenderer::ColorMappingMode::Extension},
+    {"name", TreeRenderer::ColorMappingMode::Name},
+    {"folder", TreeRenderer::ColorMappingMode::Folder},
+    {"top-folder", TreeRenderer::ColorMappingMode::TopFolder},
+    {"level", TreeRenderer::ColorMappingMode::Level},
+    {"nothing", TreeRenderer::ColorMappingMode::Nothing},
+    {"change", TreeRenderer::ColorMappingMode::Change},
+};
+
+// Change-mode colors in TreeDiff::Change order: unchanged, grew, shrank,
+// added, removed. They do not depend on the palette.
+const QColor kChangeColors[] = {
+    QColor(128, 128, 128), QColor(220, 60, 50), QColor(60, 170, 80),
+    QColor(240, 190, 40),  QColor(90, 110, 220),
+};
+
+} // namespace
+
+TreeRenderer::TreeRenderer() { setPalette(QVector<QColor>()); }
+
+void TreeRenderer::setPalette(const QVector<QColor> &colors) {
+  // GrandPerspective derives a gradient palette from each base color; build
+  // them once per palette instead of once per rectangle.
+  constexpr double kDefaultColorGradient = 0.5;
+
+  palette = colors;
+  gradientTables.clear();
+  gradientTables.reserve(static_cast<size_t>(palette.size()) + 1 +
+                         std::size(kChangeColors));
+  for (const QColor &color : palette) {
+    gradientTables.push_back(buildGradientColors(color, kDefaultColorGradient));
+  }
+  if (gradientTables.empty()) {
+    gradientTables.push_back(
+        buildGradientColors(QColor(128, 128, 128), kDefaultColorGradient));
+  }
+  changeGradientBase = gradientTables.size();
+  for (const QColor &color : kChangeColors) {
+    gradientTables.push_back(buildGradientColors(color, kDefaultColorGradient));
+  }
+}
+
+void TreeRenderer::setDiff(std::shared_ptr<const TreeDiff> newDiff) {
+  diff = std::move(newDiff);
+}
+
+void TreeRenderer::setModel(std::shared_ptr<const TreeModel> newModel) {
+  model = std::move(newModel);
+}
+
+void TreeRenderer::setColorMappingMode(ColorMappingMode newMode) {
+  mode = newMode;
+}
+
+void TreeRenderer::buildDisplayList(TreeNode *root,
+                                    const TreeLayout::ViewState &view,
+                                    qreal scale,
+                                    std::vector<DisplayItem> &items,
+                                    size_t *culled) const {
+  items.clear();
+  if (culled) {
+    *culled = 0;
+  }
+  if (!root) {
+    return;
+  }
+
+  struct Pending {
+    TreeNode *node = nullptr;
+    int depth = 0;
+  };
+
+  // Skip hidden nodes (their rects are stale) and rectangles smaller than 1
+  // device pixel, together with their subtrees.
+  auto isDrawable = [&view, scale](const TreeNode *node) {
+    if (!node || view.isHidden(node)) {
+      return false;
+    }
+    const QRectF rect = view.rect(node);
+    return rect.width() * scale >= 1.0 && rect.height() * scale >= 1.0;
+  };
+
+  // Depth stays absolute for subtrees so level coloring does not shift.
+  const int rootDepth = model ? model->depthOf(root) : 0;
+
+  // Breadth-first walk; the pending vector doubles as the queue.
+  std::vector<Pending> pending;
+  if (isDrawable(root)) {
+    pending.push_back({root, rootDepth});
+  }
+
+  size_t dropped = 0;
+  for (size_t head = 0; head < pending.size(); ++head) {
+    const Pending current = pending[head];
+    const QRectF layoutRect = view.rect(current.node);
+    const QRect pixelRect = toPixelRect(
+        QRectF(layoutRect.x() * scale, layoutRect.y() * scale,
+               layoutRect.width() * scale, layoutRect.height() * scale));
+    if (pixelRect.isEmpty()) {
+      ++dropped;
+      continue;
+    }
+
+    DisplayItem item;
+    item.node = current.node;
+    item.rect = pixelRect;
+    item.paletteIndex = paletteIndexForNode(current.node, current.depth);
+    item.depth = current.depth;
+    items.push_back(item);
+
+    for (TreeNode *child : current.node->children) {
+      if (isDrawable(child)) {
+        pending.push_back({child, current.depth + 1});
+      } else if (child && !view.isHidden(child)) {
+        ++dropped;
+      }
+    }
+  }
+  if (culled) {
+    *culled = dropped;
+  }
+}
+
+QImage TreeRenderer::render(TreeNode *root, const QSize &size,
+                            QHash<TreeNode *, QRectF> *folderRects,
+                            const TreeLayout::ViewState *view) const {
+  QImage image(size, QImage::Format_RGB32);
+  if (image.isNull()) {
+    return image;
+  }
+  image.fill(Qt::black);
+  if (!root) {
+    return image;
+  }
+
+  const int rootDepth = model ? model->depthOf(root) : 0;
+
+  // Depth-first pre-order also puts parents before their children.
+  const QRectF bounds(0, 0, image.width(), image.height());
+  TreeLayout::visit(root, bounds, 1.0,
+                    [&](TreeNode *node, const QRectF &rect, int depth) {
+                      const QRect pixelRect = toPixelRect(rect);
+                      if (pixelRect.isEmpty()) {
+                        return;
+                      }
+                      const int index =
+                          paletteIndexForNode(node, rootDepth + depth);
+                      drawBevelRect(image, nullptr, 0, pixelRect,
+                                    gradient(index));
+                      if (folderRects && node->isDir) {
+                        folderRects->insert(node, rect);
+                      }
+                    },
+                    QRectF(), view);
+
+  return image;
+}
+
+bool TreeRenderer::renderToPng(TreeNode *root, const QSize &size,
+                               const QString &path, QString *errorOut,
+                               const std::function<bool(int)> &progress,
+                               int stripHeight,
+                               const TreeLayout::ViewState *view) const {
+  const int width = size.width();
+  const int height = size.height();
+  if (stripHeight <= 0) {
+    stripHeight = static_cast<int>(kStripPixels / std::max(1, width));
+  }
+  stripHeight = std::clamp(stripHeight, 1, std::max(1, height));
+
+  PngWriter writer;
+  if (!writer.open(path, width, height, errorOut)) {
+    return false;
+  }
+
+  QImage strip(width, stripHeight, QImage::Format_RGB32);
+  if (strip.isNull()) {
+    writer.abort();
+    if (errorOut) {
+      *errorOut = QObject::tr("Cannot allocate a %1x%2 image strip.")
+                      .arg(width)
+                      .arg(stripHeight);
+    }
+    return false;
+  }
+
+  // Lay out once and keep the drawable rectangles in pre-order, each filed
+  // under the first strip it reaches, so parents still come before their
+  // children within every strip.
+  struct StripItem {
+    QRect rect; // Full-image layout pixels, Y axis up
+    int paletteIndex = 0;
+    int lastStrip = 0;
+  };
+  const int strips = (height + stripHeight - 1) / stripHeight;
+  std::vector<StripItem> items;
+  std::vector<std::vector<quint32>> startsIn(static_cast<size_t>(strips));
+  if (root) {
+    const int rootDepth = model ? model->depthOf(root) : 0;
+    TreeLayout::visit(
+        root, QRectF(0, 0, width, height), 1.0,
+        [&](TreeNode *node, const QRectF &rect, int depth) {
+          const QRect pixelRect = toPixelRect(rect);
+          // Image rows are counted from the top, layout rows from the bottom.
+          const int firstRow =
+              std::max(0, height - pixelRect.y() - pixelRect.height());
+          const int lastRow = std::min(height - 1, height - 1 - pixelRect.y());
+          if (pixelRect.isEmpty() || firstRow > lastRow) {
+            return;
+          }
+          startsIn[static_cast<size_t>(firstRow / stripHeight)].push_back(
+              static_cast<quint32>(items.size()));
+          items.push_back({pixelRect,
+                           paletteIndexForNode(node, rootDepth + depth),
+                           lastRow / stripHeight});
+        },
+        QRectF(), view);
+  }
+
+  // Items of the current strip in pre-order: those carried over from
+  // earlier strips merged with those starting here.
+  std::vector<quint32> active;
+  std::vector<quint32> merged;
+  for (int index = 0, top = 0; index < strips; ++index, top += stripHeight) {
+    const int rows = std::min(stripHeight, height - top);
+    if (rows != strip.height()) {
+      strip = QImage(width, rows, QImage::Format_RGB32);
+    }
+    strip.fill(Qt::black);
+
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](quint32 item) {
+                                  return items[item].lastStrip < index;
+                                }),
+                 active.end());
+    std::vector<quint32> &starting = startsIn[static_cast<size_t>(index)];
+    merged.clear();
+    std::merge(active.begin(), active.end(), starting.begin(), starting.end(),
+               std::back_inserter(merged));
+    active.swap(merged);
+    std::vector<quint32>().swap(starting);
+
+    // The layout Y axis points up, so image rows [top, top + rows) are
+    // layout rows [bandY, bandY + rows).
+    const int bandY = height - top - rows;
+    for (quint32 item : active) {
+      drawBevelRect(strip, nullptr, 0, items[item].rect.translated(0, -bandY),
+                    gradient(items[item].paletteIndex));
+    }
+
+    if (!writer.writeRows(strip, errorOut)) {
+      writer.abort();
+      return false;
+    }
+    if (progress && !progress(top + rows)) {
+      writer.abort();
+      if (errorOut) {
+        *errorOut = QObject::tr("Export cancelled.");
+      }
+      return false;
+    }
+  }
+
+  return writer.finish(errorOut);
+}
+
+QRect TreeRenderer::toPixelRect(const QRectF &r) {
+  const int x0 = static_cast<int>(r.x() + 0.5);
+  const int y0 = static_cast<int>(r.y() + 0.5);
+  const int x1 = static_cast<int>(r.x() + r.width() + 0.5);
+  const int y1 = static_cast<int>(r.y() + r.height() + 0.5);
+  return QRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void TreeRenderer::drawBevelRect(QImage &image, quint32 *idBuffer, quint32 id,
+                                 const QRect &rect,
+                                 const GradientTable &gradientColors) {
+  const int x0 = rect.x();
+  const int y0 = rect.y();
+  const int rectWidth = rect.width();
+  const int rectHeight = rect.height();
+
+  if (rectWidth <= 0 || rectHeight <= 0) {
+    return;
+  }
+
+  const int imgWidth = image.width();
+  const int imgHeight = image.height();
+
+  // GrandPerspective original algorithm: two triangles filled by horizontal and
+  // vertical gradient lines, using a gradient palette derived from the base
+  // color.
+  QRgb *data = reinterpret_cast<QRgb *>(image.bits());
+  const qsizetype stride =
+      image.bytesPerLine() / static_cast<qsizetype>(sizeof(QRgb));
+
+  // Horizontal lines: upper-left triangle
+  const int xBegin = std::max(0, -x0);
+  for (int y = 0; y < rectHeight; ++y) {
+    const int yWrite =
+        imgHeight - y0 - y - 1; // Match original bitmap's flipped Y-axis
+    if (yWrite < 0 || yWrite >= imgHeight) {
+      continue;
+    }
+
+    double gradient = 256.0 * (y + 0.5) / rectHeight;
+    int gradientIndex =
+        std::clamp(static_cast<int>(std::lround(gradient)), 0, 255);
+    const QRgb color = gradientColors[gradientIndex];
+
+    const int maxX = static_cast<int>(static_cast<qint64>(rectHeight - y - 1) *
+                                      rectWidth / rectHeight);
+    const int xEnd = std::min(maxX, imgWidth - x0);
+    QRgb *line = data + yWrite * stride;
+    for (int x = xBegin; x < xEnd; ++x) {
+      line[x0 + x] = color;
+    }
+    if (idBuffer) {
+      quint32 *idLine = idBuffer + static_cast<qsizetype>(yWrite) * imgWidth;
+      std::fill(idLine + x0 + xBegin, idLine + x0 + std::max(xBegin, xEnd),
+                id);
+    }
+  }
+
+  // Vertical lines: lower-right triangle
+  const int startY = imgHeight - y0 - rectHeight;
+  for (int x = 0; x < rectWidth; ++x) {
+    const int xWrite = x0 + x;
+    if (xWrite < 0 || xWrite >= imgWidth) {
+      continue;
+    }
+
+    double gradient = 256.0 * (1.0 - (x + 0.5) / rectWidth);
+    int gradientIndex =
+        std::clamp(static_cast<int>(std::lround(gradient)), 0, 255);
+    const QRgb color = gradientColors[gradientIndex];
+
+    const int minY = static_cast<int>(static_cast<qint64>(rectWidth - x - 1) *
+                                      rectHeight / rectWidth);
+    const int rows = rectHeight - minY;
+    const int yBegin = std::max(0, -startY);
+    const int yEnd = std::min(rows, imgHeight - startY);
+    for (int y = yBegin; y < yEnd; ++y) {
+      data[(startY + y) * stride + xWrite] = color;
+    }
+    if (idBuffer) {
+      for (int y = yBegin; y < yEnd; ++y) {
+        idBuffer[static_cast<qsizetype>(startY + y) * imgWidth + xWrite] = id;
+      }
+    }
+  }
+}
+
+int TreeRenderer::paletteIndexForNode(const TreeNode *node, int depth) const {
+  if (mode == ColorMappingMode::Change) {
+    const TreeDiff::Change change =
+        diff ? diff->changeOf(node) : TreeDiff::Change::Unchanged;
+    return static_cast<int>(changeGradientBase) + static_cast<int>(change);
+  }
+  if (!node || palette.isEmpty()) {
+    return 0;
+  }
+
+  auto extensionKey = [](const QString &name) -> QString {
+    int dot = name.lastIndexOf('.');
+    if (dot <= 0 || dot == name.size() - 1) {
+      return QString();
+    }
+    return name.mid(dot + 1).toLower();
+  };
+
+  // Without a model no node has a parent.
+  const TreeModel *tree = model.get();
+  auto parentOf = [tree](const TreeNode *n) -> const TreeNode * {
+    return tree ? tree->parentOf(n) : nullptr;
+  };
+
+  auto folderKey = [&parentOf](const TreeNode *n) -> QString {
+    if (!n) {
+      return QString();
+    }
+    if (n->isDir) {
+      return n->name;
+    }
+    const TreeNode *parent = parentOf(n);
+    return parent ? parent->name : QString();
+  };
+
+  auto topFolderKey = [&parentOf](const TreeNode *n) -> QString {
+    if (!n) {
+      return QString();
+    }
+    const TreeNode *cur = n;
+    // Walk to the node directly under the root.
+    for (const TreeNode *parent = parentOf(cur);
+         parent && parentOf(parent); parent = parentOf(cur)) {
+      cur = parent;
+    }
+    // If the root has name "/", cur might still be a file; use its parent when
+    // possible.
+    const TreeNode *parent = parentOf(cur);
+    if (!cur->isDir && parent) {
+      return parent->name;
+    }
+    return cur->name;
+  };
+
+  int index = 0;
+  switch (mode) {
+  case ColorMappingMode::Extension: {
+    // Matches GrandPerspective's "extension" mapping idea.
+    QString key = node->isDir ? node->name : extensionKey(node->name);
+    if (key.isEmpty()) {
+      key = node->name;
+    }
+    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
+    break;
+  }
+  case ColorMappingMode::Name: {
+    index =
+        static_cast<int>(qHash(node->name) % static_cast<uint>(palette.size()));
+    break;
+  }
+  case ColorMappingMode::Folder: {
+    QString key = folderKey(node);
+    if (key.isEmpty()) {
+      key = node->name;
+    }
+    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
+    break;
+  }
+  case ColorMappingMode::TopFolder: {
+    QString key = topFolderKey(node);
+    if (key.isEmpty()) {
+      key = node->name;
+    }
+    index = static_cast<int>(qHash(key) % static_cast<uint>(palette.size()));
+    break;
+  }
+  case ColorMappingMode::Level: {
+    // Similar to GrandPerspective's level mapping: clamp to last color.
+    index = std::min(depth, static_cast<int>(palette.size()) - 1);
+    break;
+  }
+  case ColorMappingMode::Nothing:
+  default:
+    index = 0;
+    break;
+  }
+
+  return index;
+}
+
+bool TreeRenderer::parseColorMappingMode(const QString &name,
+                                         ColorMappingMode *modeOut) {
+  const QString key = name.trimmed().toLower();
+  for (const ModeName &entry : kModeNames) {
+    if (key == QLatin1String(entry.name)) {
+      if (modeOut) {
+        *modeOut = entry.mode;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+QStringList TreeRenderer::colorMappingModeNames() {
+  QStringList names;
+  for (const ModeName &entry : kModeNames) {
+    names.push_back(QLatin1String(entry.name));
+  }
+  return names;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "TreeDiff.h"
+#include "TreeLayout.h"
+#include "TreeModel.h"
+
+// Widget-free treemap rasterizer shared by the canvas, the overview and
+// headless rendering.
+class TreeRenderer {
+public:
+  enum class ColorMappingMode {
+    Extension,
+    Name,
+    Folder,
+    TopFolder,
+    Level,
+    Nothing,
+    Change, // Growth since a baseline scan; see setDiff()
+  };
+
+  using GradientTable = std::array<QRgb, 256>;
+
+  // One drawable rectangle of a layout.
+  struct DisplayItem {
+    TreeNode *node = nullptr;
+    QRect rect; // Device-pixel rect in layout orientation (Y axis up)
+    int paletteIndex = 0;
+    int depth = 0;
+  };
+
+  TreeRenderer();
+
+  void setPalette(const QVector<QColor> &colors);
+  void setColorMappingMode(ColorMappingMode mode);
+  ColorMappingMode colorMappingMode() const { return mode; }
+
+  // Changes shown by ColorMappingMode::Change; without a diff everything
+  // is drawn as unchanged.
+  void setDiff(std::shared_ptr<const TreeDiff> newDiff);
+  const std::shared_ptr<const TreeDiff> &treeDiff() const { return diff; }
+
+  // Model the drawn nodes belong to, for the parents the Folder and Top
+  // Folder colors use and the absolute depth of a zoomed-in root.
+  void setModel(std::shared_ptr<const TreeModel> newModel);
+
+  int paletteIndexForNode(const TreeNode *node, int depth) const;
+  const GradientTable &gradient(int paletteIndex) const {
+    return gradientTables[static_cast<size_t>(paletteIndex)];
+  }
+
+  // Flatten the subtree under `root` as laid out in `view` (rectangles
+  // scaled by `scale`) into its drawable rectangles, breadth-first so
+  // parents precede the children drawn over them. Rectangles below one pixel
+  // are culled with their subtrees; `culled` receives how many subtrees were
+  // dropped.
+  void buildDisplayList(TreeNode *root, const TreeLayout::ViewState &view,
+                        qreal scale, std::vector<DisplayItem> &items,
+                        size_t *culled = nullptr) const;
+
+  // Lay out `root` into an image of `size` and rasterize it without storing
+  // the layout, leaving out what `view` hides. Drawn folders are reported
+  // in layout coordinates.
+  QImage render(TreeNode *root, const QSize &size,
+                QHash<TreeNode *, QRectF> *folderRects = nullptr,
+                const TreeLayout::ViewState *view = nullptr) const;
+
+  // Rasterize like render(), but in horizontal strips encoded straight into
+  // the PNG at `path`, so the pixels never have to fit in memory. The tree
+  // is laid out once; only a small record per drawn rectangle is kept.
+  // `progress` gets the rows written so far and returns false to cancel.
+  // A `stripHeight` of 0 picks one from the image width.
+  bool renderToPng(TreeNode *root, const QSize &size, const QString &path,
+                   QString *errorOut,
+                   const std::function<bool(int rowsDone)> &progress = {},
+                   int stripHeight = 0,
+                   const TreeLayout::ViewState *view = nullptr) const;
+
+  // Snap a layout rectangle to whole pixels the way GrandPerspective does.
+  static QRect toPixelRect(const QRectF &rect);
+
+  // Draw rectangle with GrandPerspective-style two-triangle gradient. When
+  // `idBuffer` is set, every pixel written also gets `id` there.
+  static void drawBevelRect(QImage &image, quint32 *idBuffer, quint32 id,
+                            const QRect &rect, const GradientTable &gradient);
+
+  // Parse a command-line color mode name such as "extension" or
+  // "top-folder".
+  static bool parseColorMappingMode(const QString &name,
+                                    ColorMappingMode *modeOut);
+  static QStringList colorMappingModeNames();
+
+private:
+  QVector<QColor> palette;
+  std::vector<GradientTable> gradientTables;
+  size_t changeGradientBase = 0; // Fixed Change-mode gradients start here
+  ColorMappingMode mode = ColorMappingMode::Extension;
+  std::shared_ptr<const TreeDiff> diff;
+  std::shared_ptr<const TreeModel> model;
+};
@@ -1,7 +1,12 @@
 #include "Utils.h"
 
+#include <QObject>
 #include <QStringList>
 
+#include <algorithm>
+
+#include "NodeTable.h"
+
 namespace Utils {
 
 QString formatSize(quint64 bytes) {
@@ -25,35 +30,155 @@ QString formatSize(quint64 bytes) {
   return QString::number(bytes) + " B";
 }
 
-QString buildFullPath(const TreeNode *node) {
+namespace {
+
+// Full path of `node`, walking up through `parentOf`.
+template <typename ParentOf>
+QString joinPath(const TreeNode *node, const ParentOf &parentOf) {
   if (!node) {
     return QString();
   }
 
-  QStringList parts;
-  const TreeNode *current = node;
-
-  while (current) {
+  // Measure first, then fill a single allocation from the back.
+  qsizetype nameLength = 0;
+  int parts = 0;
+  const TreeNode *top = nullptr;
+  for (const TreeNode *current = node; current;
+       current = parentOf(current)) {
     if (!current->name.isEmpty()) {
-      parts.prepend(current->name);
+      nameLength += current->name.size();
+      ++parts;
+      top = current;
     }
-    current = current->parent;
   }
 
-  if (parts.isEmpty()) {
+  if (parts == 0) {
     return QStringLiteral("/");
   }
 
-  // Avoid duplication when the root is "/".
-  if (parts.first() == QStringLiteral("/")) {
-    if (parts.size() == 1) {
-      return QStringLiteral("/");
+  // Avoid duplication when the root is "/": it becomes the leading separator.
+  const bool slashRoot = top->name == QStringLiteral("/");
+  if (slashRoot && parts == 1) {
+    return QStringLiteral("/");
+  }
+
+  const qsizetype length = nameLength + parts - 1 - (slashRoot ? 1 : 0);
+  QString path(length, Qt::Uninitialized);
+  QChar *out = path.data();
+  qsizetype pos = length;
+  int remaining = parts;
+  for (const TreeNode *current = node; current;
+       current = parentOf(current)) {
+    if (current->name.isEmpty()) {
+      continue;
+    }
+    if (slashRoot && remaining == 1) {
+      break;
+    }
+    pos -= current->name.size();
+    std::copy(current->name.cbegin(), current->name.cend(), out + pos);
+    if (--remaining > 0) {
+      out[--pos] = QLatin1Char('/');
     }
-    parts.removeFirst();
-    return QStringLiteral("/") + parts.join(QStringLiteral("/"));
   }
 
-  return parts.join(QStringLiteral("/"));
+  return path;
+}
+
+} // namespace
+
+QString buildFullPath(const TreeModel &model, const TreeNode *node) {
+  return joinPath(node, [&model](const TreeNode *current) {
+    return model.parentOf(current);
+  });
+}
+
+QString buildFullPath(const NodeTable &table, quint32 row) {
+  if (row >= table.rowCount()) {
+    return QString();
+  }
+  return joinPath(table.nodes[row],
+                  [&table](const TreeNode *current) -> const TreeNode * {
+                    const qint64 at = table.rowOf(current);
+                    return at > 0 ? table.nodes[table.parents[at]] : nullptr;
+                  });
+}
+
+TreeNode *findNode(const TreeModel &model, const QString &path) {
+  TreeNode *root = model.root();
+  if (!root) {
+    return nullptr;
+  }
+  const QString rootPath = buildFullPath(model, root);
+  if (path == rootPath) {
+    return root;
+  }
+  const QString prefix = rootPath.endsWith(QLatin1Char('/'))
+                             ? rootPath
+                             : rootPath + QLatin1Char('/');
+  if (!path.startsWith(prefix)) {
+    return nullptr;
+  }
+
+  TreeNode *current = root;
+  const QStringList parts = path.mid(prefix.size())
+                                .split(QLatin1Char('/'), Qt::SkipEmptyParts);
+  for (const QString &part : parts) {
+    TreeNode *next = nullptr;
+    for (TreeNode *child : current->children) {
+      if (child->name == part) {
+        next = child;
+        break;
+      }
+    }
+    if (!next) {
+      return nullptr;
+    }
+    current = next;
+  }
+  return current;
+}
+
+void applyHiddenMask(TreeLayout::ViewState &view, const NodeTable &table,
+                     const std::vector<quint8> &mask) {
+  const std::vector<TreeNode *> &nodes = table.nodes;
+  const size_t ids =
+      table.model ? table.model->nodeIdLimit() : table.rowCount();
+  view.hidden.assign(ids, 0);
+  view.hiddenSizes.assign(ids, 0);
+  const size_t rows = std::min(nodes.size(), mask.size());
+  for (size_t row = 1; row < rows; ++row) {
+    view.hidden[nodes[row]->id] = mask[row] != 0 ? 1 : 0;
+  }
+
+  // Reverse pre-order visits every child before its parent.
+  for (size_t row = nodes.size(); row-- > 1;) {
+    const TreeNode *node = nodes[row];
+    const quint64 removed = node->size - view.visibleSize(node);
+    if (removed > 0) {
+      view.hiddenSizes[nodes[table.parents[row]]->id] += removed;
+    }
+  }
+}
+
+void clearHidden(TreeLayout::ViewState &view) {
+  view.hidden.clear();
+  view.hiddenSizes.clear();
+}
+
+QString formatMemoryReport(const TreeModel::MemoryReport &report) {
+  QString text = QObject::tr("Model memory: ~%1 for %2 nodes\n")
+                     .arg(formatSize(report.totalBytes()))
+                     .arg(report.nodes);
+  auto line = [&text](const QString &label, quint64 bytes) {
+    text += QStringLiteral("  %1  %2\n")
+                .arg(label, -12)
+                .arg(formatSize(bytes), 10);
+  };
+  line(QObject::tr("Node structs"), report.nodeBytes);
+  line(QObject::tr("Child lists"), report.childBytes);
+  line(QObject::tr("Names"), report.nameBytes);
+  return text;
 }
 
 } // namespace Utils
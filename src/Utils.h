@@ -1,15 +1,36 @@
 #pragma once
 
 #include <QString>
+#include <vector>
 
+#include "TreeLayout.h"
 #include "TreeModel.h"
 
+class NodeTable;
+
 namespace Utils {
 
 // Convert bytes to a human-readable format (e.g., 1024 -> "1.0 KB")
 QString formatSize(quint64 bytes);
 
-// Build the full path for a node
-QString buildFullPath(const TreeNode *node);
+// Build the full path for a node of `model`
+QString buildFullPath(const TreeModel &model, const TreeNode *node);
+// Same for a row of `table`, e.g. from a job that only holds the table.
+QString buildFullPath(const NodeTable &table, quint32 row);
+
+// The node of `model` whose buildFullPath() is `path`, or nullptr.
+TreeNode *findNode(const TreeModel &model, const QString &path);
+
+// Hide the nodes whose row in `table` is set in `mask` from `view` and
+// recompute the visible sizes of their ancestors. The root row is never
+// hidden.
+void applyHiddenMask(TreeLayout::ViewState &view, const NodeTable &table,
+                     const std::vector<quint8> &mask);
+
+// Show every node in `view` again.
+void clearHidden(TreeLayout::ViewState &view);
+
+// Multi-line breakdown of a TreeModel::memoryReport()
+QString formatMemoryReport(const TreeModel::MemoryReport &report);
 
 } // namespace Utils
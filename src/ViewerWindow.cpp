@@ -6,29 +6,71 @@
 #include <QComboBox>
 #include <QCoreApplication>
 #include <QDir>
+#include <QDockWidget>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QIcon>
+#include <QInputDialog>
 #include <QLabel>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QSettings>
+#include <QSlider>
 #include <QStatusBar>
+#include <QTimer>
 #include <QToolBar>
 
+#include "AllocStats.h"
+#include "BatchRenderer.h"
 #include "CanvasWidget.h"
+#include "DiskCheck.h"
+#include "ExtensionStatsWidget.h"
+#include "ExtensionTreemap.h"
+#include "FilterExpression.h"
+#include "OverviewWidget.h"
+#include "NodeTable.h"
 #include "Palette.h"
-#include "TreeLayout.h"
+#include "SearchIndex.h"
+#include "SnapshotPool.h"
+#include "TaskScheduler.h"
+#include "TopItemsWidget.h"
+#include "Trace.h"
+#include "TreeExport.h"
 #include "TreeReader.h"
 #include "Utils.h"
 
 ViewerWindow::ViewerWindow(QWidget *parent)
-    : QMainWindow(parent), canvas(new CanvasWidget(this)) {
+    : QMainWindow(parent), canvas(new CanvasWidget(this)),
+      overview(new OverviewWidget(canvas, this)),
+      topItems(new TopItemsWidget(this)),
+      extensionStats(new ExtensionStatsWidget(this)) {
   setWindowTitle("gpscan_viewer");
   setCentralWidget(canvas);
 
+  auto *overviewDock = new QDockWidget(tr("Overview"), this);
+  overviewDock->setObjectName(QStringLiteral("overviewDock"));
+  overviewDock->setWidget(overview);
+  addDockWidget(Qt::RightDockWidgetArea, overviewDock);
+  overviewDock->hide();
+
+  auto *topItemsDock = new QDockWidget(tr("Largest Items"), this);
+  topItemsDock->setObjectName(QStringLiteral("topItemsDock"));
+  topItemsDock->setWidget(topItems);
+  addDockWidget(Qt::RightDockWidgetArea, topItemsDock);
+  topItemsDock->hide();
+
+  auto *extensionsDock = new QDockWidget(tr("Extensions"), this);
+  extensionsDock->setObjectName(QStringLiteral("extensionsDock"));
+  extensionsDock->setWidget(extensionStats);
+  addDockWidget(Qt::RightDockWidgetArea, extensionsDock);
+  extensionsDock->hide();
+
   // Create toolbar
   toolBar = addToolBar(tr("Main Toolbar"));
   toolBar->setMovable(false);
@@ -59,23 +101,227 @@ ViewerWindow::ViewerWindow(QWidget *parent)
   colorMappingCombo->addItem(tr("Top Folder"));
   colorMappingCombo->addItem(tr("Level"));
   colorMappingCombo->addItem(tr("Nothing"));
+  colorMappingCombo->addItem(tr("Change"));
+  colorMappingCombo->setItemData(
+      colorMappingCombo->count() - 1,
+      tr("Growth since the baseline scan (File > Open Baseline)"),
+      Qt::ToolTipRole);
   colorMappingCombo->setCurrentIndex(0); // Default: Extension
   colorMappingCombo->setToolTip(tr("Color mapping scheme"));
   toolBar->addWidget(colorMappingCombo);
 
+  toolBar->addSeparator();
+
+  // Name search, answered from a trigram index built after each load
+  searchEdit = new QLineEdit(this);
+  searchEdit->setPlaceholderText(tr("Search names (e.g. *.core)"));
+  searchEdit->setToolTip(
+      tr("Substring, or glob with * ? [...] matching whole names"));
+  searchEdit->setClearButtonEnabled(true);
+  searchEdit->setMaximumWidth(240);
+  toolBar->addWidget(searchEdit);
+
+  previousMatchAction = new QAction(
+      style()->standardIcon(QStyle::SP_ArrowUp), tr("Previous Match"), this);
+  previousMatchAction->setShortcut(QKeySequence::FindPrevious);
+  toolBar->addAction(previousMatchAction);
+  nextMatchAction = new QAction(
+      style()->standardIcon(QStyle::SP_ArrowDown), tr("Next Match"), this);
+  nextMatchAction->setShortcut(QKeySequence::FindNext);
+  toolBar->addAction(nextMatchAction);
+
+  searchStatus = new QLabel(this);
+  searchStatus->setContentsMargins(6, 0, 6, 0);
+  toolBar->addWidget(searchStatus);
+
+  // Filter expressions over size, depth, name, extension and type
+  addToolBarBreak();
+  QToolBar *filterBar = addToolBar(tr("Filter"));
+  filterBar->setMovable(false);
+  filterBar->addWidget(new QLabel(tr("Filter: "), this));
+  filterEdit = new QLineEdit(this);
+  filterEdit->setPlaceholderText(
+      tr("e.g. size > 1G && ext == \"iso\", depth <= 4 && !isDir"));
+  filterEdit->setToolTip(
+      tr("Fields: size, depth, name, ext, isDir, isFile. Operators: == != < "
+         "<= > >= ~ (glob), && || ! and parentheses. Press Enter to apply."));
+  filterEdit->setClearButtonEnabled(true);
+  filterBar->addWidget(filterEdit);
+  filterModeCombo = new QComboBox(this);
+  filterModeCombo->addItem(tr("Highlight"));
+  filterModeCombo->addItem(tr("Hide"));
+  filterModeCombo->setToolTip(tr("What to do with matching items"));
+  filterBar->addWidget(filterModeCombo);
+  filterStatus = new QLabel(this);
+  filterStatus->setContentsMargins(6, 0, 6, 0);
+  filterBar->addWidget(filterStatus);
+
+  // Timeline over the scans of File > Open Timeline
+  addToolBarBreak();
+  timelineBar = addToolBar(tr("Timeline"));
+  timelineBar->setObjectName(QStringLiteral("timelineBar"));
+  timelineBar->setMovable(false);
+  timelineBar->addWidget(new QLabel(tr("Timeline: "), this));
+  timelineSlider = new QSlider(Qt::Horizontal, this);
+  timelineSlider->setTracking(false);
+  timelineSlider->setPageStep(1);
+  timelineSlider->setTickPosition(QSlider::TicksBelow);
+  timelineSlider->setToolTip(tr("Scan shown in the treemap"));
+  timelineBar->addWidget(timelineSlider);
+  timelineLabel = new QLabel(this);
+  timelineLabel->setContentsMargins(6, 0, 6, 0);
+  timelineBar->addWidget(timelineLabel);
+  timelineBar->hide();
+
+  searchTimer = new QTimer(this);
+  searchTimer->setSingleShot(true);
+  searchTimer->setInterval(200);
+  indexWatcher =
+      new QFutureWatcher<std::shared_ptr<const SearchIndex>>(this);
+  diffWatcher = new QFutureWatcher<BaselineDiff>(this);
+  timelineWatcher = new QFutureWatcher<TimelineLoad>(this);
+  snapshotWatcher = new QFutureWatcher<std::shared_ptr<TreeModel>>(this);
+  editWatcher = new QFutureWatcher<ModelEdit>(this);
+  reloadWatcher = new QFutureWatcher<ScanLoad>(this);
+  scanWatcher = new QFileSystemWatcher(this);
+  // Scanners write for a while; reload once the file has been quiet.
+  reloadTimer = new QTimer(this);
+  reloadTimer->setSingleShot(true);
+  reloadTimer->setInterval(1000);
+  diskCheckWatcher =
+      new QFutureWatcher<std::shared_ptr<const DiskCheck>>(this);
+  deletionWatcher = new QFutureWatcher<FileRemover::Result>(this);
+  deletionTimer = new QTimer(this);
+  deletionTimer->setInterval(200);
+  exportWatcher = new QFutureWatcher<ListingExport>(this);
+  exportTimer = new QTimer(this);
+  exportTimer->setInterval(200);
+
   // Menus
   auto *fileMenu = menuBar()->addMenu(tr("&File"));
   fileMenu->addAction(openAction);
   fileMenu->addAction(reloadAction);
+  autoReloadAction = fileMenu->addAction(tr("Reload &Automatically"));
+  autoReloadAction->setCheckable(true);
+  autoReloadAction->setToolTip(
+      tr("Reload the scan in the background whenever its file is rewritten"));
+  QAction *openBaselineAction =
+      fileMenu->addAction(tr("Open &Baseline..."));
+  openBaselineAction->setToolTip(
+      tr("Compare with an earlier scan of the same volume"));
+  clearBaselineAction = fileMenu->addAction(tr("&Clear Baseline"));
+  clearBaselineAction->setEnabled(false);
+  QAction *openTimelineAction =
+      fileMenu->addAction(tr("Open &Timeline..."));
+  openTimelineAction->setToolTip(
+      tr("Load several scans of one volume and step through them"));
+  fileMenu->addSeparator();
+  QAction *exportAction = fileMenu->addAction(tr("&Export Image..."));
+  exportAction->setToolTip(tr("Save the current view as a PNG image"));
+  QAction *exportListingAction =
+      fileMenu->addAction(tr("Export &Listing..."));
+  exportListingAction->setToolTip(
+      tr("Save path, size, type and depth of every item as CSV or NDJSON"));
   fileMenu->addSeparator();
   QAction *quitAction = fileMenu->addAction(tr("&Quit"));
   quitAction->setShortcut(QKeySequence::Quit);
 
+  auto *settings = new QSettings("GrandPerspective", "gpscan_viewer", this);
+  autoReloadAction->setChecked(settings->value("autoReload", true).toBool());
+  connect(autoReloadAction, &QAction::toggled, this,
+          [this, settings](bool checked) {
+            settings->setValue("autoReload", checked);
+            watchScanFile(watchedPath);
+          });
+
+  auto *viewMenu = menuBar()->addMenu(tr("&View"));
+  QAction *progressiveAction =
+      viewMenu->addAction(tr("&Progressive Rendering"));
+  progressiveAction->setCheckable(true);
+  progressiveAction->setToolTip(
+      tr("Refine large treemaps over several frames to stay responsive"));
+  progressiveAction->setChecked(
+      settings->value("progressiveRendering", false).toBool());
+  connect(progressiveAction, &QAction::toggled, this,
+          [this, settings](bool checked) {
+            canvas->setProgressiveRendering(checked);
+            settings->setValue("progressiveRendering", checked);
+          });
+  canvas->setProgressiveRendering(progressiveAction->isChecked());
+
+  QAction *highDpiAction = viewMenu->addAction(tr("&High-DPI Rendering"));
+  highDpiAction->setCheckable(true);
+  highDpiAction->setToolTip(
+      tr("Render the treemap at the screen's native resolution"));
+  highDpiAction->setChecked(
+      settings->value("highDpiRendering", true).toBool());
+  connect(highDpiAction, &QAction::toggled, this,
+          [this, settings](bool checked) {
+            canvas->setHighDpiRendering(checked);
+            settings->setValue("highDpiRendering", checked);
+          });
+  canvas->setHighDpiRendering(highDpiAction->isChecked());
+
+  QAction *threadsAction = viewMenu->addAction(tr("Worker &Threads..."));
+  threadsAction->setToolTip(
+      tr("Threads used for indexing, analysis and batch work"));
+  connect(threadsAction, &QAction::triggered, this, [this, settings]() {
+    bool ok = false;
+    const int count = QInputDialog::getInt(
+        this, tr("Worker Threads"),
+        tr("Threads for parallel work (0 = one per CPU):"),
+        settings->value("threads", 0).toInt(), 0, 1024, 1, &ok);
+    if (ok) {
+      settings->setValue("threads", count);
+      TaskScheduler::setThreadCount(count);
+    }
+  });
+
+  QAction *hudAction = viewMenu->addAction(tr("Performance &HUD"));
+  hudAction->setCheckable(true);
+  hudAction->setShortcut(QKeySequence(Qt::Key_F12));
+  hudAction->setToolTip(
+      tr("Show frame timings, hit-test latency and model size on the canvas"));
+  connect(hudAction, &QAction::toggled, canvas, &CanvasWidget::setHudVisible);
+
+  extensionViewAction = viewMenu->addAction(tr("Arrange by &Extension"));
+  extensionViewAction->setCheckable(true);
+  extensionViewAction->setToolTip(
+      tr("Show one rectangle per extension instead of the folder tree"));
+  diskCheckAction = viewMenu->addAction(tr("Check Items on &Disk"));
+  diskCheckAction->setCheckable(true);
+  diskCheckAction->setToolTip(
+      tr("Gray out items of the scan that no longer exist on disk"));
+  diskSizesAction = viewMenu->addAction(tr("Compare &Sizes on Disk"));
+  diskSizesAction->setCheckable(true);
+  diskSizesAction->setToolTip(
+      tr("Also mark files whose size changed; reads every file's size"));
+
+  viewMenu->addSeparator();
+  QAction *zoomInAction = viewMenu->addAction(tr("Zoom &In"));
+  zoomInAction->setShortcut(QKeySequence::ZoomIn);
+  zoomInAction->setToolTip(tr("Show only the selected folder"));
+  QAction *zoomOutAction = viewMenu->addAction(tr("Zoom &Out"));
+  zoomOutAction->setShortcut(QKeySequence::ZoomOut);
+  zoomOutAction->setToolTip(tr("Show the parent of the current folder"));
+  QAction *resetZoomAction = viewMenu->addAction(tr("&Reset Zoom"));
+  resetZoomAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_0));
+
+  viewMenu->addSeparator();
+  findAction = viewMenu->addAction(tr("&Find..."));
+  findAction->setShortcut(QKeySequence::Find);
+  viewMenu->addAction(nextMatchAction);
+  viewMenu->addAction(previousMatchAction);
+
+  viewMenu->addSeparator();
+  viewMenu->addAction(overviewDock->toggleViewAction());
+  viewMenu->addAction(topItemsDock->toggleViewAction());
+  viewMenu->addAction(extensionsDock->toggleViewAction());
+
   auto *paletteMenu = menuBar()->addMenu(tr("&Palette"));
   auto *paletteGroup = new QActionGroup(this);
   paletteGroup->setExclusive(true);
 
-  auto *settings = new QSettings("GrandPerspective", "gpscan_viewer", this);
   const QString initialPalette = palettes::canonicalNameOrDefault(
       settings->value("paletteName", palettes::defaultPaletteName())
           .toString());
@@ -90,6 +336,7 @@ ViewerWindow::ViewerWindow(QWidget *parent)
       const QString chosen =
           palettes::canonicalNameOrDefault(action->data().toString());
       canvas->setPaletteName(chosen);
+      overview->invalidate();
       settings->setValue("paletteName", canvas->paletteName());
     });
 
@@ -99,12 +346,61 @@ ViewerWindow::ViewerWindow(QWidget *parent)
   }
 
   auto *helpMenu = menuBar()->addMenu(tr("&Help"));
+  QAction *statisticsAction = helpMenu->addAction(tr("&Statistics"));
+  statisticsAction->setToolTip(
+      tr("Show the memory taken by the model and allocations per phase"));
   QAction *aboutAction = helpMenu->addAction(tr("&About"));
 
   // Connections
   connect(openAction, &QAction::triggered, this, &ViewerWindow::openFile);
   connect(reloadAction, &QAction::triggered, this, &ViewerWindow::reloadFile);
+  connect(openBaselineAction, &QAction::triggered, this,
+          &ViewerWindow::openBaseline);
+  connect(clearBaselineAction, &QAction::triggered, this,
+          &ViewerWindow::clearBaseline);
+  connect(diffWatcher, &QFutureWatcher<BaselineDiff>::finished, this,
+          &ViewerWindow::diffReady);
+  connect(openTimelineAction, &QAction::triggered, this,
+          &ViewerWindow::openTimeline);
+  connect(timelineWatcher, &QFutureWatcher<TimelineLoad>::finished, this,
+          &ViewerWindow::timelineLoaded);
+  connect(snapshotWatcher,
+          &QFutureWatcher<std::shared_ptr<TreeModel>>::finished, this,
+          &ViewerWindow::snapshotReady);
+  connect(editWatcher, &QFutureWatcher<ModelEdit>::finished, this,
+          &ViewerWindow::modelEdited);
+  connect(reloadWatcher, &QFutureWatcher<ScanLoad>::finished, this,
+          &ViewerWindow::reloadReady);
+  connect(scanWatcher, &QFileSystemWatcher::fileChanged, this,
+          &ViewerWindow::scanFileChanged);
+  connect(scanWatcher, &QFileSystemWatcher::directoryChanged, this,
+          &ViewerWindow::scanFileChanged);
+  connect(reloadTimer, &QTimer::timeout, this,
+          [this]() { startReload(false); });
+  connect(deletionWatcher, &QFutureWatcher<FileRemover::Result>::finished,
+          this, &ViewerWindow::deletionFinished);
+  connect(deletionTimer, &QTimer::timeout, this,
+          &ViewerWindow::updateDeletionProgress);
+  connect(exportWatcher, &QFutureWatcher<ListingExport>::finished, this,
+          &ViewerWindow::exportFinished);
+  connect(exportTimer, &QTimer::timeout, this,
+          &ViewerWindow::updateExportProgress);
+  connect(timelineSlider, &QSlider::valueChanged, this,
+          &ViewerWindow::showSnapshot);
+  connect(timelineSlider, &QSlider::sliderMoved, this, [this](int index) {
+    if (timeline && index >= 0 &&
+        index < static_cast<int>(timeline->snapshots().size())) {
+      timelineLabel->setText(QFileInfo(timeline->snapshots()[index].label)
+                                 .fileName());
+    }
+  });
+  connect(exportAction, &QAction::triggered, this,
+          &ViewerWindow::exportImage);
+  connect(exportListingAction, &QAction::triggered, this,
+          &ViewerWindow::exportListing);
   connect(quitAction, &QAction::triggered, this, &ViewerWindow::close);
+  connect(statisticsAction, &QAction::triggered, this,
+          &ViewerWindow::showStatistics);
   connect(aboutAction, &QAction::triggered, this, &ViewerWindow::showAbout);
   connect(canvas, &CanvasWidget::selectedNodeChanged, this,
           &ViewerWindow::updateSelection);
@@ -113,6 +409,66 @@ ViewerWindow::ViewerWindow(QWidget *parent)
   connect(colorMappingCombo,
           QOverload<int>::of(&QComboBox::currentIndexChanged), this,
           &ViewerWindow::changeColorMapping);
+  connect(zoomInAction, &QAction::triggered, this, &ViewerWindow::zoomIn);
+  connect(zoomOutAction, &QAction::triggered, this, &ViewerWindow::zoomOut);
+  connect(resetZoomAction, &QAction::triggered, this,
+          &ViewerWindow::resetZoom);
+  connect(canvas, &CanvasWidget::focusNodeChanged, overview,
+          &OverviewWidget::setFocusNode);
+  connect(overview, &OverviewWidget::navigateRequested, canvas,
+          &CanvasWidget::setFocusNode);
+  connect(topItems, &TopItemsWidget::nodeActivated, canvas,
+          &CanvasWidget::setSelectedNode);
+  connect(extensionStats, &ExtensionStatsWidget::filterRequested, this,
+          [this](const QString &expression) {
+            filterEdit->setText(expression);
+            if (extensionViewAction->isChecked()) {
+              statusBar()->showMessage(
+                  tr("The filter applies once the folder tree is shown."));
+            }
+            applyFilter();
+          });
+  connect(extensionViewAction, &QAction::toggled, this,
+          &ViewerWindow::updateExtensionView);
+  connect(diskCheckAction, &QAction::toggled, this,
+          &ViewerWindow::startDiskCheck);
+  connect(diskSizesAction, &QAction::toggled, this,
+          &ViewerWindow::startDiskCheck);
+  connect(diskCheckWatcher,
+          &QFutureWatcher<std::shared_ptr<const DiskCheck>>::finished, this,
+          &ViewerWindow::diskCheckReady);
+
+  connect(findAction, &QAction::triggered, this, [this]() {
+    searchEdit->setFocus();
+    searchEdit->selectAll();
+  });
+  connect(searchEdit, &QLineEdit::textChanged, searchTimer,
+          qOverload<>(&QTimer::start));
+  connect(searchEdit, &QLineEdit::returnPressed, this, [this]() {
+    if (searchTimer->isActive()) {
+      runSearch();
+    } else {
+      showNextMatch();
+    }
+  });
+  connect(searchTimer, &QTimer::timeout, this, &ViewerWindow::runSearch);
+  connect(nextMatchAction, &QAction::triggered, this,
+          &ViewerWindow::showNextMatch);
+  connect(previousMatchAction, &QAction::triggered, this,
+          &ViewerWindow::showPreviousMatch);
+  connect(filterEdit, &QLineEdit::returnPressed, this,
+          &ViewerWindow::applyFilter);
+  connect(filterEdit, &QLineEdit::textChanged, this, [this](const QString &t) {
+    if (t.isEmpty()) {
+      applyFilter();
+    }
+  });
+  connect(filterModeCombo,
+          QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+          &ViewerWindow::applyFilter);
+  connect(indexWatcher,
+          &QFutureWatcher<std::shared_ptr<const SearchIndex>>::finished, this,
+          &ViewerWindow::searchIndexReady);
 
   canvas->setPaletteName(initialPalette);
 
@@ -129,6 +485,12 @@ void ViewerWindow::openFile() {
   openFilePath(path);
 }
 
+ViewerWindow::~ViewerWindow() {
+  // Stop a running deletion or export rather than let it continue unseen.
+  cancelDeletions();
+  exportCancel.cancel();
+}
+
 bool ViewerWindow::openFilePath(const QString &path) {
   if (path.isEmpty()) {
     return false;
@@ -141,7 +503,210 @@ void ViewerWindow::reloadFile() {
     statusBar()->showMessage(tr("No file to reload"));
     return;
   }
-  loadModelFromPath(currentPath, tr("Failed to reload file."));
+  startReload(true);
+}
+
+void ViewerWindow::watchScanFile(const QString &path) {
+  watchedPath = path;
+  reloadTimer->stop();
+  const QStringList watched = scanWatcher->files() + scanWatcher->directories();
+  if (!watched.isEmpty()) {
+    scanWatcher->removePaths(watched);
+  }
+  if (path.isEmpty() || !autoReloadAction->isChecked()) {
+    return;
+  }
+  // Writers that replace the file drop it from the watcher; the folder
+  // still reports the new one.
+  scanWatcher->addPath(path);
+  scanWatcher->addPath(QFileInfo(path).absolutePath());
+}
+
+void ViewerWindow::scanFileChanged(const QString &changed) {
+  if (watchedPath.isEmpty()) {
+    return;
+  }
+  // Other files in the folder do not matter, unless the scan itself was
+  // replaced and so is no longer watched.
+  const bool replaced = !scanWatcher->files().contains(watchedPath);
+  if ((changed != watchedPath && !replaced) ||
+      !QFileInfo::exists(watchedPath)) {
+    return;
+  }
+  if (replaced) {
+    scanWatcher->addPath(watchedPath);
+  }
+  reloadTimer->start();
+}
+
+void ViewerWindow::startReload(bool manual) {
+  if (currentPath.isEmpty()) {
+    return;
+  }
+  // The current version stays on screen until the new one is ready.
+  statusBar()->showMessage(tr("Reloading %1...").arg(currentPath));
+  const QString path = currentPath;
+  auto job = [path, manual]() {
+    ScanLoad result;
+    result.path = path;
+    result.manual = manual;
+    result.model = TaskScheduler::destroyInBackground(
+        TreeReader::readFromFile(path, &result.error));
+    return result;
+  };
+  reloadWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Normal, job));
+}
+
+void ViewerWindow::reloadReady() {
+  if (reloadWatcher->isCanceled()) {
+    return;
+  }
+  const ScanLoad result = reloadWatcher->result();
+  // Dropped if another scan was opened meanwhile.
+  if (result.path != currentPath) {
+    return;
+  }
+  if (!result.model) {
+    // A file caught mid-write fails to parse; the next write retries.
+    if (result.manual) {
+      showError(result.error.isEmpty() ? tr("Failed to reload file.")
+                                       : result.error);
+    } else {
+      statusBar()->showMessage(
+          tr("Could not reload %1 yet: %2").arg(result.path, result.error));
+    }
+    return;
+  }
+  replaceModel(result.model);
+  statusBar()->showMessage(tr("Reloaded: %1").arg(result.path));
+}
+
+void ViewerWindow::exportImage() {
+  if (!currentModel || !currentModel->root()) {
+    statusBar()->showMessage(tr("Nothing to export"));
+    return;
+  }
+
+  const QString defaultSize =
+      QStringLiteral("%1x%2").arg(canvas->width()).arg(canvas->height());
+  bool ok = false;
+  const QString sizeText = QInputDialog::getText(
+      this, tr("Export Image"), tr("Image size (WIDTHxHEIGHT):"),
+      QLineEdit::Normal, defaultSize, &ok);
+  if (!ok) {
+    return;
+  }
+  QSize size;
+  if (!BatchRender::parseSize(sizeText, &size)) {
+    showError(tr("Invalid image size: %1").arg(sizeText));
+    return;
+  }
+
+  const QString path = QFileDialog::getSaveFileName(
+      this, tr("Export Image"), QString(), tr("PNG Images (*.png)"));
+  if (path.isEmpty()) {
+    return;
+  }
+
+  QProgressDialog progress(tr("Exporting image..."), tr("Cancel"), 0,
+                           size.height(), this);
+  progress.setWindowModality(Qt::WindowModal);
+  progress.setMinimumDuration(500);
+
+  QString error;
+  const bool exported =
+      canvas->exportImage(path, size, &error, [&progress](int rowsDone) {
+        progress.setValue(rowsDone);
+        return !progress.wasCanceled();
+      });
+
+  if (exported) {
+    statusBar()->showMessage(tr("Exported: %1").arg(path));
+  } else if (progress.wasCanceled()) {
+    statusBar()->showMessage(tr("Export cancelled"));
+  } else {
+    showError(error.isEmpty() ? tr("Failed to export image.") : error);
+  }
+}
+
+void ViewerWindow::exportListing() {
+  if (!currentModel || !currentModel->root()) {
+    statusBar()->showMessage(tr("Nothing to export"));
+    return;
+  }
+  if (exportProgress) {
+    statusBar()->showMessage(tr("An export is already running"));
+    return;
+  }
+
+  const QString path = QFileDialog::getSaveFileName(
+      this, tr("Export Listing"), QString(),
+      tr("CSV (*.csv *.csv.gz);;NDJSON (*.ndjson *.ndjson.gz)"));
+  if (path.isEmpty()) {
+    return;
+  }
+
+  // The total is unknown up front, so the dialog only shows rows written.
+  exportProgress = new QProgressDialog(this);
+  exportProgress->setWindowTitle(tr("Export Listing"));
+  exportProgress->setWindowModality(Qt::NonModal);
+  exportProgress->setRange(0, 0);
+  exportProgress->setAutoClose(false);
+  exportProgress->setAutoReset(false);
+  connect(exportProgress, &QProgressDialog::canceled, this,
+          [this]() { exportCancel.cancel(); });
+  exportProgress->show();
+  exportTimer->start();
+
+  // The job holds the version shown now; edits made meanwhile create new
+  // models and do not touch it.
+  exportCancel = TaskScheduler::CancelToken();
+  exportRows = std::make_shared<std::atomic<quint64>>(0);
+  const TaskScheduler::CancelToken cancel = exportCancel;
+  const std::shared_ptr<std::atomic<quint64>> rows = exportRows;
+  const std::shared_ptr<const TreeModel> model = currentModel;
+  auto job = [path, cancel, rows, model]() {
+    ListingExport result;
+    result.path = path;
+    result.exported = TreeExport::exportTree(
+        model->root(), path, TreeExport::formatForPath(path), &result.error,
+        [cancel, rows](quint64 written) {
+          rows->store(written, std::memory_order_relaxed);
+          return !cancel.isCanceled();
+        });
+    return result;
+  };
+  exportWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Normal, job));
+  updateExportProgress();
+}
+
+void ViewerWindow::updateExportProgress() {
+  if (!exportProgress) {
+    return;
+  }
+  exportProgress->setLabelText(
+      tr("Exported %1 items...")
+          .arg(exportRows->load(std::memory_order_relaxed)));
+}
+
+void ViewerWindow::exportFinished() {
+  const ListingExport result = exportWatcher->result();
+  exportTimer->stop();
+  if (exportProgress) {
+    exportProgress->deleteLater();
+    exportProgress = nullptr;
+  }
+
+  if (result.exported) {
+    statusBar()->showMessage(tr("Exported: %1").arg(result.path));
+  } else if (exportCancel.isCanceled()) {
+    statusBar()->showMessage(tr("Export cancelled"));
+  } else {
+    showError(result.error.isEmpty() ? tr("Failed to export listing.")
+                                     : result.error);
+  }
 }
 
 void ViewerWindow::showAbout() {
@@ -205,45 +770,522 @@ void ViewerWindow::showAbout() {
   box.exec();
 }
 
+void ViewerWindow::showStatistics() {
+  QString text;
+  if (currentModel && currentModel->root()) {
+    text = Utils::formatMemoryReport(
+        TreeModel::memoryReport(currentModel->root()));
+    if (currentModel->version() > 0) {
+      text += tr("%n edit(s) since loading\n", "",
+                 static_cast<int>(currentModel->version()));
+    }
+  } else {
+    text = tr("No scan loaded.\n");
+  }
+  text += QStringLiteral("\n") + tr("Allocations per phase:") +
+          QStringLiteral("\n") + AllocStats::toText();
+
+  QMessageBox box(this);
+  box.setWindowTitle(tr("Statistics"));
+  box.setTextFormat(Qt::RichText);
+  box.setText(QStringLiteral("<pre>%1</pre>").arg(text.toHtmlEscaped()));
+  box.exec();
+}
+
 void ViewerWindow::changeColorMapping(int index) {
   CanvasWidget::ColorMappingMode mode =
       static_cast<CanvasWidget::ColorMappingMode>(index);
   canvas->setColorMappingMode(mode);
+  overview->invalidate();
 }
 
 void ViewerWindow::setModel(std::shared_ptr<TreeModel> model,
                             const QString &sourcePath) {
+  Trace::Scope trace("ViewerWindow::setModel");
+  // Models are wrapped by TaskScheduler::destroyInBackground() where they
+  // are built, so whatever drops the last reference to a replaced one (the
+  // canvas, an index, a finished job's result), it is freed on the pool.
   currentModel = std::move(model);
   currentPath = sourcePath;
+  pendingRemovals.clear();
 
-  QRectF bounds(0, 0, canvas->width(), canvas->height());
-  TreeLayout::layout(currentModel->root(), bounds);
+  extensionModel.reset();
   canvas->setModel(currentModel);
+  overview->setModel(currentModel);
+  startIndexing();
 
   statusBar()->showMessage(tr("Loaded: %1").arg(currentPath));
 }
 
+void ViewerWindow::startIndexing() {
+  searchIndex.reset();
+  searchMatches.clear();
+  searchPosition = -1;
+  filterHidesNodes = false;
+  filterStatus->clear();
+  topItems->setNodeTable(nullptr);
+  extensionStats->setNodeTable(nullptr);
+  canvas->setDiff(nullptr);
+  diskCheckCancel.cancel();
+  canvas->setDiskCheck(nullptr);
+  if (!currentModel || !currentModel->root()) {
+    searchStatus->clear();
+    return;
+  }
+
+  // The worker and the table it builds hold their own reference, so
+  // replacing the model mid-build is safe; searchIndexReady() drops results
+  // for a model no longer shown.
+  searchStatus->setText(tr("Indexing..."));
+  std::shared_ptr<const TreeModel> model = currentModel;
+  indexWatcher->setFuture(TaskScheduler::run(
+      TaskScheduler::Priority::Background,
+      [model]() -> std::shared_ptr<const SearchIndex> {
+        Trace::Scope trace("ViewerWindow::buildSearchIndex");
+        return std::make_shared<SearchIndex>(NodeTable::build(model));
+      }));
+}
+
+void ViewerWindow::searchIndexReady() {
+  if (indexWatcher->isCanceled()) {
+    return;
+  }
+  std::shared_ptr<const SearchIndex> index = indexWatcher->result();
+  if (!index || !currentModel || index->nodeTable()->model != currentModel) {
+    return;
+  }
+  searchIndex = std::move(index);
+  searchStatus->clear();
+  topItems->setNodeTable(searchIndex->nodeTable());
+  extensionStats->setNodeTable(searchIndex->nodeTable());
+  if (extensionViewAction->isChecked()) {
+    updateExtensionView();
+  }
+  if (!baselinePath.isEmpty()) {
+    startDiff();
+  }
+  if (diskCheckAction->isChecked()) {
+    startDiskCheck();
+  }
+  if (!searchEdit->text().trimmed().isEmpty()) {
+    runSearch();
+  }
+  if (!filterEdit->text().trimmed().isEmpty()) {
+    applyFilter();
+  }
+}
+
+void ViewerWindow::openBaseline() {
+  const QString path = QFileDialog::getOpenFileName(
+      this, tr("Open Baseline Scan"), QString(),
+      tr("GrandPerspective Scan Data (*.gpscan *.xml);;All Files (*)"));
+  if (path.isEmpty()) {
+    return;
+  }
+  baselinePath = path;
+  baselineModel.reset();
+  clearBaselineAction->setEnabled(true);
+  colorMappingCombo->setCurrentIndex(
+      static_cast<int>(CanvasWidget::ColorMappingMode::Change));
+  startDiff();
+}
+
+void ViewerWindow::clearBaseline() {
+  baselinePath.clear();
+  baselineModel.reset();
+  clearBaselineAction->setEnabled(false);
+  canvas->setDiff(nullptr);
+  overview->invalidate();
+}
+
+void ViewerWindow::startDiff() {
+  canvas->setDiff(nullptr);
+  // Started again by searchIndexReady() once the current scan is indexed.
+  if (baselinePath.isEmpty() || !searchIndex) {
+    return;
+  }
+
+  statusBar()->showMessage(tr("Comparing with %1...").arg(baselinePath));
+  std::shared_ptr<const NodeTable> table = searchIndex->nodeTable();
+  std::shared_ptr<TreeModel> baseline = baselineModel;
+  const QString path = baselinePath;
+  auto job = [table, baseline, path]() {
+    BaselineDiff result;
+    result.baseline = baseline;
+    if (!result.baseline) {
+      result.baseline = TaskScheduler::destroyInBackground(
+          TreeReader::readFromFile(path, &result.error));
+    }
+    if (result.baseline) {
+      result.diff = TreeDiff::compute(table, result.baseline->root());
+    }
+    return result;
+  };
+  diffWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Background, job));
+}
+
+void ViewerWindow::diffReady() {
+  if (diffWatcher->isCanceled() || baselinePath.isEmpty()) {
+    return;
+  }
+  const BaselineDiff result = diffWatcher->result();
+  if (!result.baseline) {
+    const QString path = baselinePath;
+    clearBaseline();
+    showError(result.error.isEmpty()
+                  ? tr("Failed to load baseline %1.").arg(path)
+                  : result.error);
+    return;
+  }
+  baselineModel = result.baseline;
+  // A diff against a table that is no longer shown is dropped.
+  if (!searchIndex || result.diff->nodeTable() != searchIndex->nodeTable()) {
+    return;
+  }
+  canvas->setDiff(result.diff);
+  overview->invalidate();
+
+  const qint64 delta = result.diff->deltaOf(currentModel->root());
+  const quint64 magnitude = static_cast<quint64>(delta < 0 ? -delta : delta);
+  statusBar()->showMessage(tr("Compared with %1: %2%3")
+                               .arg(baselinePath)
+                               .arg(delta < 0 ? QLatin1Char('-')
+                                              : QLatin1Char('+'))
+                               .arg(Utils::formatSize(magnitude)));
+}
+
+void ViewerWindow::startDiskCheck() {
+  diskCheckCancel.cancel();
+  canvas->setDiskCheck(nullptr);
+  // Started again by searchIndexReady() once the current scan is indexed.
+  if (!diskCheckAction->isChecked() || !searchIndex) {
+    return;
+  }
+
+  statusBar()->showMessage(tr("Checking items on disk..."));
+  diskCheckCancel = TaskScheduler::CancelToken();
+  const TaskScheduler::CancelToken cancel = diskCheckCancel;
+  std::shared_ptr<const NodeTable> table = searchIndex->nodeTable();
+  const bool compareSizes = diskSizesAction->isChecked();
+  diskCheckWatcher->setFuture(TaskScheduler::run(
+      TaskScheduler::Priority::Background, [table, compareSizes, cancel]() {
+        return DiskCheck::run(table, compareSizes, cancel);
+      }));
+}
+
+void ViewerWindow::diskCheckReady() {
+  if (diskCheckWatcher->isCanceled()) {
+    return;
+  }
+  std::shared_ptr<const DiskCheck> check = diskCheckWatcher->result();
+  // Cancelled checks and checks of a table no longer shown are dropped.
+  if (!check || !diskCheckAction->isChecked() || !searchIndex ||
+      check->nodeTable() != searchIndex->nodeTable()) {
+    return;
+  }
+  canvas->setDiskCheck(check);
+  QString message = tr("%n item(s) gone from disk (%1)", "",
+                       static_cast<int>(check->missingItems()))
+                        .arg(Utils::formatSize(check->missingBytes()));
+  if (diskSizesAction->isChecked()) {
+    message += tr(", %n changed size", "",
+                  static_cast<int>(check->resizedItems()));
+  }
+  statusBar()->showMessage(message);
+}
+
+void ViewerWindow::openTimeline() {
+  QStringList paths = QFileDialog::getOpenFileNames(
+      this, tr("Open Timeline"), QString(),
+      tr("GrandPerspective Scan Data (*.gpscan *.xml);;All Files (*)"));
+  if (paths.isEmpty()) {
+    return;
+  }
+  // Daily dumps are usually named by date, so name order is time order.
+  paths.sort();
+
+  statusBar()->showMessage(tr("Loading %n scan(s)...", "", paths.size()));
+  timelineCancel.cancel();
+  timelineCancel = TaskScheduler::CancelToken();
+  const TaskScheduler::CancelToken cancel = timelineCancel;
+  auto job = [paths, cancel]() {
+    auto pool = std::make_shared<SnapshotPool>();
+    TimelineLoad result;
+    for (const QString &path : paths) {
+      if (cancel.isCanceled()) {
+        break;
+      }
+      QString error;
+      if (!pool->addFile(path, &error)) {
+        result.errors.push_back(QStringLiteral("%1: %2").arg(path, error));
+      }
+    }
+    result.pool = std::move(pool);
+    return result;
+  };
+  timelineWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Background, job));
+}
+
+void ViewerWindow::timelineLoaded() {
+  // A scan opened since the load started replaced what it would show.
+  if (timelineWatcher->isCanceled() || timelineCancel.isCanceled()) {
+    return;
+  }
+  const TimelineLoad result = timelineWatcher->result();
+  if (!result.errors.isEmpty()) {
+    showError(result.errors.join(QLatin1Char('\n')));
+  }
+  const int count = static_cast<int>(result.pool->snapshots().size());
+  if (count == 0) {
+    return;
+  }
+
+  timeline = result.pool;
+  quint64 items = 0;
+  for (const SnapshotPool::Snapshot &snapshot : timeline->snapshots()) {
+    items += snapshot.nodeCount;
+  }
+  {
+    // Moving to the last scan below must not load the previous position.
+    const QSignalBlocker blocker(timelineSlider);
+    timelineSlider->setRange(0, count - 1);
+    timelineSlider->setValue(count - 1);
+  }
+  timelineBar->show();
+  showSnapshot(count - 1);
+  statusBar()->showMessage(
+      tr("Timeline of %n scan(s): %1 items stored as %2", "", count)
+          .arg(items)
+          .arg(timeline->uniqueNodeCount()));
+}
+
+void ViewerWindow::showSnapshot(int index) {
+  if (!timeline || index < 0 ||
+      index >= static_cast<int>(timeline->snapshots().size())) {
+    return;
+  }
+  timelineLabel->setText(
+      tr("%1 (%2 of %3)")
+          .arg(QFileInfo(timeline->snapshots()[index].label).fileName())
+          .arg(index + 1)
+          .arg(timeline->snapshots().size()));
+
+  // Only the latest request is shown; setFuture() drops older results.
+  snapshotIndex = index;
+  std::shared_ptr<const SnapshotPool> pool = timeline;
+  snapshotWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Normal, [pool, index]() {
+        return TaskScheduler::destroyInBackground(pool->materialize(index));
+      }));
+}
+
+void ViewerWindow::snapshotReady() {
+  std::shared_ptr<TreeModel> model = snapshotWatcher->result();
+  if (!model || !timeline || snapshotIndex < 0 ||
+      snapshotIndex >= static_cast<int>(timeline->snapshots().size())) {
+    return;
+  }
+  setModel(model, timeline->snapshots()[snapshotIndex].label);
+  watchScanFile(QString());
+}
+
+void ViewerWindow::closeTimeline() {
+  // timelineLoaded() and snapshotReady() drop work still in flight.
+  timelineCancel.cancel();
+  timeline.reset();
+  snapshotIndex = -1;
+  timelineLabel->clear();
+  timelineBar->hide();
+}
+
+void ViewerWindow::updateExtensionView() {
+  // Search, filter and Largest Items point into the folder tree, which the
+  // extension view does not show.
+  const bool treeShown = !extensionViewAction->isChecked();
+  searchEdit->setEnabled(treeShown);
+  findAction->setEnabled(treeShown);
+  previousMatchAction->setEnabled(treeShown);
+  nextMatchAction->setEnabled(treeShown);
+  filterEdit->setEnabled(treeShown);
+  filterModeCombo->setEnabled(treeShown);
+  topItems->setEnabled(treeShown);
+
+  if (treeShown) {
+    if (extensionModel) {
+      extensionModel.reset();
+      canvas->setModel(currentModel);
+      // setModel() dropped the highlights; show them on the tree again.
+      if (!searchEdit->text().trimmed().isEmpty()) {
+        runSearch();
+      }
+      if (!filterEdit->text().trimmed().isEmpty()) {
+        applyFilter();
+      }
+    }
+    return;
+  }
+  // Built once the index is ready; searchIndexReady() calls back.
+  if (!searchIndex) {
+    return;
+  }
+  const std::shared_ptr<const NodeTable> table = searchIndex->nodeTable();
+  extensionModel = TaskScheduler::destroyInBackground(
+      ExtensionTreemap::buildModel(*table, table->extensionTotals(0)));
+  canvas->setModel(extensionModel);
+}
+
+void ViewerWindow::applyFilter() {
+  // Applied once the extension view is left; see updateExtensionView().
+  if (extensionViewAction->isChecked()) {
+    return;
+  }
+  const QString text = filterEdit->text().trimmed();
+  const bool hide = filterModeCombo->currentIndex() == 1;
+  if (!searchIndex) {
+    filterStatus->setText(text.isEmpty() || !currentModel ? QString()
+                                                          : tr("Indexing..."));
+    return;
+  }
+  const NodeTable &table = *searchIndex->nodeTable();
+
+  std::unique_ptr<FilterExpression> expression;
+  if (!text.isEmpty()) {
+    QString error;
+    expression = FilterExpression::parse(text, &error);
+    if (!expression) {
+      filterStatus->setText(error);
+      return;
+    }
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  const std::vector<quint8> mask =
+      expression ? expression->evaluate(table) : std::vector<quint8>();
+
+  QVector<TreeNode *> matches;
+  for (size_t row = 0; row < mask.size(); ++row) {
+    if (mask[row]) {
+      matches.push_back(table.nodes[row]);
+    }
+  }
+
+  const bool wasHiding = filterHidesNodes;
+  if (hide && expression) {
+    canvas->setHiddenMask(table, mask);
+    filterHidesNodes = true;
+  } else if (filterHidesNodes) {
+    canvas->clearHiddenMask();
+    filterHidesNodes = false;
+  }
+
+  canvas->setFilterHighlights(hide ? QVector<TreeNode *>() : matches);
+  if (filterHidesNodes || wasHiding) {
+    overview->invalidate();
+  }
+
+  if (expression) {
+    filterStatus->setText(tr("%1 matches (%2 ms)")
+                              .arg(matches.size())
+                              .arg(timer.elapsed()));
+  } else {
+    filterStatus->clear();
+  }
+}
+
+void ViewerWindow::runSearch() {
+  searchTimer->stop();
+  if (extensionViewAction->isChecked()) {
+    return;
+  }
+  searchMatches.clear();
+  searchPosition = -1;
+
+  const QString query = searchEdit->text().trimmed();
+  if (query.isEmpty() || !searchIndex) {
+    canvas->setSearchHighlights(searchMatches);
+    searchStatus->setText(query.isEmpty() || !currentModel
+                              ? QString()
+                              : tr("Indexing..."));
+    return;
+  }
+
+  searchMatches = searchIndex->find(query);
+  canvas->setSearchHighlights(searchMatches);
+  if (searchMatches.isEmpty()) {
+    searchStatus->setText(tr("No matches"));
+    return;
+  }
+  showMatch(0);
+}
+
+void ViewerWindow::showNextMatch() {
+  if (!searchMatches.isEmpty()) {
+    showMatch((searchPosition + 1) % searchMatches.size());
+  }
+}
+
+void ViewerWindow::showPreviousMatch() {
+  if (!searchMatches.isEmpty()) {
+    const int count = static_cast<int>(searchMatches.size());
+    showMatch((searchPosition + count - 1) % count);
+  }
+}
+
+void ViewerWindow::showMatch(int position) {
+  searchPosition = position;
+  searchStatus->setText(
+      tr("%1 of %2").arg(position + 1).arg(searchMatches.size()));
+  canvas->setSelectedNode(searchMatches[position]);
+}
+
 void ViewerWindow::updateSelection(TreeNode *node) {
+  topItems->setScopeNode(node);
+  extensionStats->setScopeNode(node);
   if (!node) {
     statusBar()->showMessage(tr("No selection"));
     return;
   }
 
-  QString fullPath = Utils::buildFullPath(node);
+  QString fullPath = canvas->pathOf(node);
   QString sizeText = Utils::formatSize(node->size);
   statusBar()->showMessage(tr("%1 | %2").arg(fullPath, sizeText));
 }
 
+void ViewerWindow::zoomIn() {
+  TreeNode *target = canvas->selection();
+  if (target && !target->isDir) {
+    target = canvas->parentOf(target);
+  }
+  if (target) {
+    canvas->setFocusNode(target);
+  }
+}
+
+void ViewerWindow::zoomOut() {
+  if (TreeNode *parent = canvas->parentOf(canvas->focusNode())) {
+    canvas->setFocusNode(parent);
+  }
+}
+
+void ViewerWindow::resetZoom() { canvas->setFocusNode(nullptr); }
+
 void ViewerWindow::showError(const QString &message) {
   QMessageBox::critical(this, tr("Error"), message);
 }
 
 bool ViewerWindow::loadModelFromPath(const QString &path,
                                      const QString &failMessage) {
+  Trace::Scope trace("ViewerWindow::loadModelFromPath");
+  // The scan asked for last wins over a timeline still loading.
+  timelineCancel.cancel();
   QApplication::setOverrideCursor(Qt::WaitCursor);
 
   QString error;
-  std::shared_ptr<TreeModel> model = TreeReader::readFromFile(path, &error);
+  std::shared_ptr<TreeModel> model = TaskScheduler::destroyInBackground(
+      TreeReader::readFromFile(path, &error));
 
   QApplication::restoreOverrideCursor();
 
@@ -252,7 +1294,9 @@ bool ViewerWindow::loadModelFromPath(const QString &path,
     return false;
   }
 
+  closeTimeline();
   setModel(model, path);
+  watchScanFile(path);
   return true;
 }
 
@@ -290,6 +1334,11 @@ void ViewerWindow::deletePath(const QString &path) {
     prompt = tr("Delete file \"%1\"?").arg(cleaned);
   }
 
+  if (cleaned == deletingPath || deletionQueue.contains(cleaned)) {
+    statusBar()->showMessage(tr("Already being deleted: %1").arg(cleaned));
+    return;
+  }
+
   QMessageBox::StandardButton reply = QMessageBox::warning(
       this, tr("Delete"), prompt, QMessageBox::Yes | QMessageBox::Cancel,
       QMessageBox::Cancel);
@@ -298,18 +1347,177 @@ void ViewerWindow::deletePath(const QString &path) {
     return;
   }
 
-  bool ok = false;
-  if (isSymLink || info.isFile()) {
-    ok = QFile::remove(cleaned);
-  } else if (info.isDir()) {
-    QDir dir(cleaned);
-    ok = dir.removeRecursively();
+  deletionQueue.push_back(cleaned);
+  if (!deletingPath.isEmpty()) {
+    updateDeletionProgress();
+    return;
   }
+  startNextDeletion();
+}
 
-  if (!ok) {
-    showError(tr("Failed to delete: %1").arg(cleaned));
+void ViewerWindow::startNextDeletion() {
+  if (!deletionProgress) {
+    deletionProgress = new QProgressDialog(this);
+    deletionProgress->setWindowTitle(tr("Delete"));
+    deletionProgress->setWindowModality(Qt::NonModal);
+    deletionProgress->setRange(0, 0);
+    deletionProgress->setAutoClose(false);
+    deletionProgress->setAutoReset(false);
+    connect(deletionProgress, &QProgressDialog::canceled, this,
+            &ViewerWindow::cancelDeletions);
+    deletionProgress->show();
+    deletionTimer->start();
+  }
+
+  // The worker only touches the counters and the token it was given, so it
+  // may outlive the window.
+  deletingPath = deletionQueue.takeFirst();
+  deletionCancel = TaskScheduler::CancelToken();
+  deletionCounters = std::make_shared<DeletionCounters>();
+  const QString path = deletingPath;
+  const TaskScheduler::CancelToken cancel = deletionCancel;
+  const std::shared_ptr<DeletionCounters> counters = deletionCounters;
+  auto job = [path, cancel, counters]() {
+    return FileRemover::remove(
+        path, [cancel, counters](const FileRemover::Progress &progress) {
+          counters->items.store(progress.items, std::memory_order_relaxed);
+          counters->bytes.store(progress.bytes, std::memory_order_relaxed);
+          return !cancel.isCanceled();
+        });
+  };
+  deletionWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Normal, job));
+  updateDeletionProgress();
+}
+
+void ViewerWindow::updateDeletionProgress() {
+  if (!deletionProgress || deletingPath.isEmpty()) {
+    return;
+  }
+  const quint64 items = deletionSummary.removed.items +
+                        deletionCounters->items.load(std::memory_order_relaxed);
+  const quint64 bytes = deletionSummary.removed.bytes +
+                        deletionCounters->bytes.load(std::memory_order_relaxed);
+  QString text = tr("Deleting %1").arg(deletingPath) + QLatin1Char('\n') +
+                 tr("%1 items removed, %2 freed")
+                     .arg(items)
+                     .arg(Utils::formatSize(bytes));
+  if (!deletionQueue.isEmpty()) {
+    text += QLatin1Char('\n') +
+            tr("%n more waiting", "", static_cast<int>(deletionQueue.size()));
+  }
+  deletionProgress->setLabelText(text);
+}
+
+void ViewerWindow::cancelDeletions() {
+  // Whatever is queued has not been touched yet and is simply dropped.
+  deletionQueue.clear();
+  deletionCancel.cancel();
+}
+
+void ViewerWindow::deletionFinished() {
+  const FileRemover::Result result = deletionWatcher->result();
+  const QString path = deletingPath;
+  deletingPath.clear();
+  deletionSummary.removed.items += result.removed.items;
+  deletionSummary.removed.bytes += result.removed.bytes;
+  deletionSummary.errors += result.errors;
+  deletionSummary.canceled |= result.canceled;
+
+  // A partly deleted folder stays in the view until the scan is reloaded.
+  const QFileInfo info(path);
+  if (!info.exists() && !info.isSymLink()) {
+    removeFromModel(path);
+  }
+  if (!deletionQueue.isEmpty()) {
+    startNextDeletion();
+    return;
+  }
+
+  deletionTimer->stop();
+  deletionProgress->deleteLater();
+  deletionProgress = nullptr;
+  const FileRemover::Result summary = deletionSummary;
+  deletionSummary = FileRemover::Result();
+
+  const QString totals = tr("%1 items removed, %2 freed")
+                             .arg(summary.removed.items)
+                             .arg(Utils::formatSize(summary.removed.bytes));
+  statusBar()->showMessage(summary.canceled
+                               ? tr("Deletion cancelled: %1").arg(totals)
+                               : tr("Deleted: %1").arg(totals));
+  if (summary.errors.isEmpty()) {
+    return;
+  }
+  constexpr qsizetype kShownErrors = 20;
+  QString details = summary.errors.mid(0, kShownErrors).join(QLatin1Char('\n'));
+  if (summary.errors.size() > kShownErrors) {
+    details += QLatin1Char('\n') +
+               tr("...and %1 more").arg(summary.errors.size() - kShownErrors);
+  }
+  showError(tr("%n item(s) could not be deleted (%1):", "",
+               static_cast<int>(summary.errors.size()))
+                .arg(totals) +
+            QLatin1Char('\n') + details);
+}
+
+void ViewerWindow::removeFromModel(const QString &path) {
+  if (!currentModel || !Utils::findNode(*currentModel, path)) {
+    return;
+  }
+  // The shown version stays as it is for jobs still reading it; the view
+  // moves to an edited copy once that is built. Each new job covers every
+  // pending path, so dropping an older one loses nothing.
+  pendingRemovals.push_back(path);
+  std::shared_ptr<const TreeModel> base = currentModel;
+  const QStringList paths = pendingRemovals;
+  auto job = [base, paths]() {
+    std::vector<const TreeNode *> removed;
+    for (const QString &removedPath : paths) {
+      if (const TreeNode *node = Utils::findNode(*base, removedPath)) {
+        removed.push_back(node);
+      }
+    }
+    ModelEdit result;
+    result.base = base;
+    result.model = TaskScheduler::destroyInBackground(
+        TreeModel::withoutSubtrees(*base, removed));
+    return result;
+  };
+  editWatcher->setFuture(
+      TaskScheduler::run(TaskScheduler::Priority::Interactive, job));
+}
+
+void ViewerWindow::modelEdited() {
+  if (editWatcher->isCanceled()) {
+    return;
+  }
+  const ModelEdit result = editWatcher->result();
+  // Dropped if another scan was loaded meanwhile.
+  if (!result.model || result.base != currentModel) {
     return;
   }
+  const QStringList removed = pendingRemovals;
+  replaceModel(result.model);
+  statusBar()->showMessage(
+      tr("Deleted: %1").arg(removed.join(QStringLiteral(", "))));
+}
+
+void ViewerWindow::replaceModel(std::shared_ptr<TreeModel> model) {
+  // The folders above an edit are copies in the new version, so the view is
+  // carried over by path; a zoomed folder that is gone falls back to its
+  // nearest remaining ancestor.
+  const QString focusPath = canvas->pathOf(canvas->focusNode());
+  const QString selectionPath = canvas->pathOf(canvas->selection());
+  setModel(std::move(model), currentPath);
 
-  statusBar()->showMessage(tr("Deleted: %1").arg(cleaned));
+  TreeNode *focus = nullptr;
+  for (QString path = focusPath; currentModel && !focus && !path.isEmpty();
+       path.truncate(path.lastIndexOf(QLatin1Char('/')))) {
+    focus = Utils::findNode(*currentModel, path);
+  }
+  canvas->setFocusNode(focus);
+  if (currentModel && !selectionPath.isEmpty()) {
+    canvas->setSelectedNode(Utils::findNode(*currentModel, selectionPath));
+  }
 }
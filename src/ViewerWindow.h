@@ -1,37 +1,215 @@
 #pragma once
 
+#include <QFutureWatcher>
 #include <QMainWindow>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
 #include <memory>
 
+#include "FileRemover.h"
+#include "TaskScheduler.h"
+#include "TreeDiff.h"
 #include "TreeModel.h"
 
 class CanvasWidget;
+class DiskCheck;
+class ExtensionStatsWidget;
+class OverviewWidget;
+class TopItemsWidget;
+class QAction;
 class QToolBar;
 class QComboBox;
+class QFileSystemWatcher;
+class QLabel;
+class QLineEdit;
+class QProgressDialog;
+class QTimer;
+class SearchIndex;
+class SnapshotPool;
+class QSlider;
 
 class ViewerWindow : public QMainWindow {
   Q_OBJECT
 
 public:
   explicit ViewerWindow(QWidget *parent = nullptr);
+  ~ViewerWindow() override;
   bool openFilePath(const QString &path);
 
 private slots:
   void openFile();
   void reloadFile();
+  void scanFileChanged(const QString &changed);
+  void startReload(bool manual = false);
+  void reloadReady();
+  void exportImage();
+  void exportListing();
   void showAbout();
+  void showStatistics();
   void updateSelection(TreeNode *node);
   void changeColorMapping(int index);
   void deletePath(const QString &path);
+  void zoomIn();
+  void zoomOut();
+  void resetZoom();
+  void runSearch();
+  void showNextMatch();
+  void showPreviousMatch();
+  void searchIndexReady();
+  void applyFilter();
+  void updateExtensionView();
+  void openBaseline();
+  void clearBaseline();
+  void diffReady();
+  void startDiskCheck();
+  void diskCheckReady();
+  void openTimeline();
+  void timelineLoaded();
+  void showSnapshot(int index);
+  void snapshotReady();
+  void modelEdited();
+  void deletionFinished();
+  void exportFinished();
 
 private:
+  // Result of loading a baseline scan and comparing the current one to it.
+  struct BaselineDiff {
+    std::shared_ptr<TreeModel> baseline;
+    std::shared_ptr<const TreeDiff> diff;
+    QString error;
+  };
+
+  // The scan at `path` read again off the GUI thread.
+  struct ScanLoad {
+    QString path;
+    std::shared_ptr<TreeModel> model;
+    QString error;
+    bool manual = false; // From File > Reload rather than a file change
+  };
+
+  // A new version of `base` with deleted items removed.
+  struct ModelEdit {
+    std::shared_ptr<const TreeModel> base;
+    std::shared_ptr<TreeModel> model;
+  };
+
+  // Totals of the running deletion, written by its worker.
+  struct DeletionCounters {
+    std::atomic<quint64> items{0};
+    std::atomic<quint64> bytes{0};
+  };
+
+  // Outcome of writing a listing of one model version.
+  struct ListingExport {
+    QString path;
+    bool exported = false;
+    QString error;
+  };
+
+  // Scans of one volume loaded into a shared pool for the timeline.
+  struct TimelineLoad {
+    std::shared_ptr<const SnapshotPool> pool;
+    QStringList errors;
+  };
+
   void setModel(std::shared_ptr<TreeModel> model, const QString &sourcePath);
+  // Show a new version of the current scan, keeping zoom and selection.
+  void replaceModel(std::shared_ptr<TreeModel> model);
+  void removeFromModel(const QString &path);
+  // Reload `path` whenever it changes, if enabled; empty stops watching.
+  void watchScanFile(const QString &path);
+  // Forget the timeline, e.g. when a single scan is opened instead.
+  void closeTimeline();
+  void startNextDeletion();
+  void updateDeletionProgress();
+  void cancelDeletions();
+  void updateExportProgress();
   void showError(const QString &message);
   bool loadModelFromPath(const QString &path, const QString &failMessage);
+  void startIndexing();
+  void startDiff();
+  void showMatch(int position);
 
   CanvasWidget *canvas = nullptr;
+  OverviewWidget *overview = nullptr;
+  TopItemsWidget *topItems = nullptr;
+  ExtensionStatsWidget *extensionStats = nullptr;
   QToolBar *toolBar = nullptr;
   QComboBox *colorMappingCombo = nullptr;
   std::shared_ptr<TreeModel> currentModel;
   QString currentPath;
+
+  // The scan file the view was opened from, reloaded in the background
+  // once writes to it have settled.
+  QAction *autoReloadAction = nullptr;
+  QFileSystemWatcher *scanWatcher = nullptr;
+  QTimer *reloadTimer = nullptr;
+  QString watchedPath;
+  QFutureWatcher<ScanLoad> *reloadWatcher = nullptr;
+
+  QLineEdit *searchEdit = nullptr;
+  QAction *findAction = nullptr;
+  QAction *previousMatchAction = nullptr;
+  QAction *nextMatchAction = nullptr;
+  QLabel *searchStatus = nullptr;
+  QTimer *searchTimer = nullptr;
+  std::shared_ptr<const SearchIndex> searchIndex;
+  QFutureWatcher<std::shared_ptr<const SearchIndex>> *indexWatcher = nullptr;
+  QVector<TreeNode *> searchMatches;
+  int searchPosition = -1;
+
+  QLineEdit *filterEdit = nullptr;
+  QComboBox *filterModeCombo = nullptr;
+  QLabel *filterStatus = nullptr;
+  bool filterHidesNodes = false;
+
+  // Shown on the canvas instead of currentModel while "Arrange by
+  // Extension" is checked.
+  QAction *extensionViewAction = nullptr;
+  std::shared_ptr<TreeModel> extensionModel;
+
+  // Earlier scan the current one is compared with; loaded on first use.
+  QString baselinePath;
+  std::shared_ptr<TreeModel> baselineModel;
+  QFutureWatcher<BaselineDiff> *diffWatcher = nullptr;
+  QAction *clearBaselineAction = nullptr;
+
+  // Which items of the shown scan are still on disk; checked again whenever
+  // the scan is reindexed while enabled.
+  QAction *diskCheckAction = nullptr;
+  QAction *diskSizesAction = nullptr;
+  TaskScheduler::CancelToken diskCheckCancel;
+  QFutureWatcher<std::shared_ptr<const DiskCheck>> *diskCheckWatcher = nullptr;
+
+  std::shared_ptr<const SnapshotPool> timeline;
+  QToolBar *timelineBar = nullptr;
+  QSlider *timelineSlider = nullptr;
+  QLabel *timelineLabel = nullptr;
+  TaskScheduler::CancelToken timelineCancel; // Canceled by closeTimeline()
+  QFutureWatcher<TimelineLoad> *timelineWatcher = nullptr;
+  QFutureWatcher<std::shared_ptr<TreeModel>> *snapshotWatcher = nullptr;
+  int snapshotIndex = -1; // Snapshot the pending materialization is for
+
+  // Paths deleted on disk that the shown version still contains.
+  QStringList pendingRemovals;
+  QFutureWatcher<ModelEdit> *editWatcher = nullptr;
+
+  // Confirmed deletions run one at a time on the pool while the window
+  // stays usable; the dialog exists while any are queued or running.
+  QStringList deletionQueue;
+  QString deletingPath;
+  TaskScheduler::CancelToken deletionCancel;
+  std::shared_ptr<DeletionCounters> deletionCounters;
+  QFutureWatcher<FileRemover::Result> *deletionWatcher = nullptr;
+  QProgressDialog *deletionProgress = nullptr;
+  QTimer *deletionTimer = nullptr;
+  FileRemover::Result deletionSummary; // Since the queue was last empty
+
+  // One listing export at a time runs on the pool; its worker counts rows.
+  TaskScheduler::CancelToken exportCancel;
+  std::shared_ptr<std::atomic<quint64>> exportRows;
+  QFutureWatcher<ListingExport> *exportWatcher = nullptr;
+  QProgressDialog *exportProgress = nullptr;
+  QTimer *exportTimer = nullptr;
 };
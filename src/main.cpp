@@ -3,10 +3,233 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
 #include <QString>
 
+#include <iostream>
+
+#include "AllocStats.h"
+#include "BatchRenderer.h"
+#include "Palette.h"
+#include "ScanStats.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include "TreeExport.h"
+#include "TreeReader.h"
+#include "TreeRenderer.h"
+#include "Utils.h"
 #include "ViewerWindow.h"
 
+namespace {
+
+// What loading `path` as a viewer model costs, for --stats --memory.
+bool measureModel(const QString &path, QJsonObject *json, QString *text,
+                  QString *errorOut) {
+  const AllocStats::Counts before = AllocStats::threadCounts();
+  std::shared_ptr<TreeModel> model = TreeReader::readFromFile(path, errorOut);
+  const AllocStats::Counts after = AllocStats::threadCounts();
+  if (!model) {
+    return false;
+  }
+
+  const TreeModel::MemoryReport report =
+      TreeModel::memoryReport(model->root());
+  QJsonObject memory;
+  memory.insert(QStringLiteral("nodes"), static_cast<qint64>(report.nodes));
+  memory.insert(QStringLiteral("nodeBytes"),
+                static_cast<qint64>(report.nodeBytes));
+  memory.insert(QStringLiteral("childBytes"),
+                static_cast<qint64>(report.childBytes));
+  memory.insert(QStringLiteral("nameBytes"),
+                static_cast<qint64>(report.nameBytes));
+  memory.insert(QStringLiteral("totalBytes"),
+                static_cast<qint64>(report.totalBytes()));
+  json->insert(QStringLiteral("memory"), memory);
+  *text = QStringLiteral("\n") + Utils::formatMemoryReport(report);
+
+  if (AllocStats::isEnabled()) {
+    const quint64 allocations = after.allocations - before.allocations;
+    const quint64 bytes = after.bytes - before.bytes;
+    QJsonObject load;
+    load.insert(QStringLiteral("allocations"),
+                static_cast<qint64>(allocations));
+    load.insert(QStringLiteral("bytes"), static_cast<qint64>(bytes));
+    json->insert(QStringLiteral("loadAllocations"), load);
+    *text += QObject::tr("Allocations while loading: %1, %2\n")
+                 .arg(allocations)
+                 .arg(Utils::formatSize(bytes));
+  }
+  return true;
+}
+
+// --trace wins over GPSCAN_VIEWER_TRACE; no path leaves tracing off.
+void startTrace(const QCommandLineParser &parser) {
+  const QString path = parser.isSet(QStringLiteral("trace"))
+                           ? parser.value(QStringLiteral("trace"))
+                           : qEnvironmentVariable("GPSCAN_VIEWER_TRACE");
+  QString error;
+  if (!path.isEmpty() && !Trace::start(path, &error)) {
+    std::cerr << qPrintable(error) << "\n";
+  }
+}
+
+// --threads, then GPSCAN_VIEWER_THREADS, then `fallback` (0 = one per CPU).
+bool configureThreads(const QCommandLineParser &parser, int fallback) {
+  QString text = parser.value(QStringLiteral("threads"));
+  QString source = QStringLiteral("--threads");
+  if (text.isEmpty()) {
+    text = qEnvironmentVariable("GPSCAN_VIEWER_THREADS");
+    source = QStringLiteral("GPSCAN_VIEWER_THREADS");
+  }
+  int count = fallback;
+  if (!text.isEmpty() && !TaskScheduler::parseThreadCount(text, &count)) {
+    std::cerr << qPrintable(
+                     QObject::tr("Invalid %1, expected a number of threads.")
+                         .arg(source))
+              << "\n";
+    return false;
+  }
+  TaskScheduler::setThreadCount(count);
+  return true;
+}
+
+int renderFromCommandLine(const QCommandLineParser &parser) {
+  BatchRender::Options options;
+  options.inputs = parser.positionalArguments();
+  options.output = parser.value(QStringLiteral("render"));
+  options.paletteName = parser.value(QStringLiteral("palette"));
+  options.baseline = parser.value(QStringLiteral("baseline"));
+
+  auto fail = [](const QString &message) {
+    std::cerr << qPrintable(message) << "\n";
+    return 1;
+  };
+
+  if (options.output.isEmpty()) {
+    return fail(QObject::tr("--render needs an output path."));
+  }
+  if (!BatchRender::parseSize(parser.value(QStringLiteral("size")),
+                              &options.size)) {
+    return fail(QObject::tr("Invalid --size, expected WIDTHxHEIGHT."));
+  }
+  if (!TreeRenderer::parseColorMappingMode(
+          parser.value(QStringLiteral("color-mode")), &options.colorMode)) {
+    return fail(QObject::tr("Unknown --color-mode: %1")
+                    .arg(parser.value(QStringLiteral("color-mode"))));
+  }
+  if (options.colorMode == TreeRenderer::ColorMappingMode::Change &&
+      options.baseline.isEmpty()) {
+    return fail(QObject::tr("--color-mode change needs --baseline."));
+  }
+  if (!palettes::builtInPaletteNames().contains(options.paletteName,
+                                                Qt::CaseInsensitive)) {
+    return fail(
+        QObject::tr("Unknown --palette: %1").arg(options.paletteName));
+  }
+  if (parser.isSet(QStringLiteral("jobs"))) {
+    bool ok = false;
+    options.jobs = parser.value(QStringLiteral("jobs")).toInt(&ok);
+    if (!ok || options.jobs <= 0) {
+      return fail(QObject::tr("Invalid --jobs, expected a positive number."));
+    }
+  }
+
+  for (QString &input : options.inputs) {
+    input = QFileInfo(input).absoluteFilePath();
+  }
+  return BatchRender::run(options);
+}
+
+int statsFromCommandLine(const QCommandLineParser &parser) {
+  const QStringList inputs = parser.positionalArguments();
+  if (inputs.isEmpty()) {
+    std::cerr << qPrintable(QObject::tr("No input files for --stats.")) << "\n";
+    return 1;
+  }
+
+  int topCount = 10;
+  if (parser.isSet(QStringLiteral("top"))) {
+    bool ok = false;
+    topCount = parser.value(QStringLiteral("top")).toInt(&ok);
+    if (!ok || topCount < 0) {
+      std::cerr << qPrintable(
+                       QObject::tr("Invalid --top, expected a number."))
+                << "\n";
+      return 1;
+    }
+  }
+  const bool json = parser.isSet(QStringLiteral("json"));
+  const bool memory = parser.isSet(QStringLiteral("memory"));
+
+  int failures = 0;
+  QStringList reports;
+  for (const QString &input : inputs) {
+    ScanStats stats(topCount);
+    QString error;
+    if (!TreeReader::parseFile(input, stats, &error)) {
+      ++failures;
+      std::cerr << qPrintable(QStringLiteral("%1: %2").arg(input, error))
+                << "\n";
+      continue;
+    }
+    QJsonObject object = stats.toJsonObject();
+    QString memoryText;
+    if (memory && !measureModel(input, &object, &memoryText, &error)) {
+      ++failures;
+      std::cerr << qPrintable(QStringLiteral("%1: %2").arg(input, error))
+                << "\n";
+      continue;
+    }
+    if (json) {
+      const QByteArray document =
+          QJsonDocument(object).toJson(QJsonDocument::Indented);
+      reports.push_back(QString::fromUtf8(document).trimmed());
+    } else {
+      reports.push_back(input + QStringLiteral("\n") + stats.toText() +
+                        memoryText);
+    }
+  }
+
+  // Several inputs in JSON mode form one array so the output stays valid.
+  if (json && reports.size() > 1) {
+    std::cout << "[\n"
+              << qPrintable(reports.join(QStringLiteral(",\n"))) << "\n]\n";
+  } else if (json) {
+    std::cout << qPrintable(reports.join(QString())) << "\n";
+  } else {
+    std::cout << qPrintable(reports.join(QStringLiteral("\n")));
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+int exportFromCommandLine(const QCommandLineParser &parser) {
+  const QStringList inputs = parser.positionalArguments();
+  const QString output = parser.value(QStringLiteral("export"));
+  if (inputs.size() != 1 || output.isEmpty()) {
+    std::cerr << qPrintable(
+                     QObject::tr("--export needs one input file and an output "
+                                 "path."))
+              << "\n";
+    return 1;
+  }
+
+  QString error;
+  std::shared_ptr<TreeModel> model =
+      TreeReader::readFromFile(inputs.first(), &error);
+  if (!model || !TreeExport::exportTree(model->root(), output,
+                                        TreeExport::formatForPath(output),
+                                        &error)) {
+    std::cerr << qPrintable(QStringLiteral("%1: %2").arg(inputs.first(), error))
+              << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
+
 int main(int argc, char *argv[]) {
   auto setupParser = [](QCommandLineParser &parser) {
     parser.setApplicationDescription(
@@ -15,10 +238,74 @@ int main(int argc, char *argv[]) {
     parser.addVersionOption();
     parser.addPositionalArgument(QObject::tr("file"),
                                  QObject::tr("Path to .gpscan or .xml file."));
+
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("render"),
+        QObject::tr("Render the given files to PNG without a display. <out> "
+                    "is the image path for one file, otherwise a directory."),
+        QObject::tr("out")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("size"), QObject::tr("Image size for --render."),
+        QObject::tr("WxH"), QStringLiteral("1920x1080")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("color-mode"),
+        QObject::tr("Color mapping for --render: %1.")
+            .arg(TreeRenderer::colorMappingModeNames().join(
+                QStringLiteral(", "))),
+        QObject::tr("mode"), QStringLiteral("extension")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("palette"),
+        QObject::tr("Palette for --render: %1.")
+            .arg(palettes::builtInPaletteNames().join(QStringLiteral(", "))),
+        QObject::tr("name"), palettes::defaultPaletteName()));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("baseline"),
+        QObject::tr("Earlier scan that --render compares against for "
+                    "--color-mode change."),
+        QObject::tr("file")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("jobs"),
+        QObject::tr("Files rendered in parallel by --render (default: "
+                    "--threads)."),
+        QObject::tr("n")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("threads"),
+        QObject::tr("Threads for parallel work; 0 means one per CPU. Also "
+                    "set by GPSCAN_VIEWER_THREADS."),
+        QObject::tr("n")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("export"),
+        QObject::tr("Write path, size, type and depth of every item of the "
+                    "given file to <out>. \".ndjson\" selects NDJSON, "
+                    "otherwise CSV; a \".gz\" suffix compresses."),
+        QObject::tr("out")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("stats"),
+        QObject::tr("Print totals, the largest files and folders and the size "
+                    "per extension of the given files without loading them "
+                    "into memory.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("json"),
+                                        QObject::tr("Print --stats as JSON.")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("top"),
+        QObject::tr("Entries in the largest-item lists of --stats."),
+        QObject::tr("n"), QStringLiteral("10")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("memory"),
+        QObject::tr("With --stats, also load each file as the viewer does and "
+                    "report the memory its model takes.")));
+    parser.addOption(QCommandLineOption(
+        QStringLiteral("trace"),
+        QObject::tr("Write a Chrome trace of loading, layout and painting to "
+                    "<file> on exit. Also set by GPSCAN_VIEWER_TRACE."),
+        QObject::tr("file")));
   };
 
   bool wantsHelp = false;
   bool wantsVersion = false;
+  bool wantsRender = false;
+  bool wantsStats = false;
+  bool wantsExport = false;
   for (int i = 1; i < argc; ++i) {
     const QString arg = QString::fromLocal8Bit(argv[i]);
     if (arg == QStringLiteral("-h") || arg == QStringLiteral("--help")) {
@@ -26,10 +313,20 @@ int main(int argc, char *argv[]) {
     } else if (arg == QStringLiteral("-v") ||
                arg == QStringLiteral("--version")) {
       wantsVersion = true;
+    } else if (arg == QStringLiteral("--render") ||
+               arg.startsWith(QStringLiteral("--render="))) {
+      wantsRender = true;
+    } else if (arg == QStringLiteral("--stats")) {
+      wantsStats = true;
+    } else if (arg == QStringLiteral("--export") ||
+               arg.startsWith(QStringLiteral("--export="))) {
+      wantsExport = true;
     }
   }
 
-  if (wantsHelp || wantsVersion) {
+  if (wantsHelp || wantsVersion || wantsRender || wantsStats ||
+      wantsExport) {
+    // No display is needed, so stay on QCoreApplication.
     QCoreApplication app(argc, argv);
 
     QCoreApplication::setApplicationName("gpscan_viewer");
@@ -48,7 +345,17 @@ int main(int argc, char *argv[]) {
     if (wantsVersion) {
       parser.showVersion();
     }
-    return 0;
+    startTrace(parser);
+    if (!configureThreads(parser, 0)) {
+      return 1;
+    }
+    if (wantsStats) {
+      return statsFromCommandLine(parser);
+    }
+    if (wantsExport) {
+      return exportFromCommandLine(parser);
+    }
+    return renderFromCommandLine(parser);
   }
 
   QApplication app(argc, argv);
@@ -62,6 +369,11 @@ int main(int argc, char *argv[]) {
   QCommandLineParser parser;
   setupParser(parser);
   parser.process(app);
+  startTrace(parser);
+  const QSettings settings("GrandPerspective", "gpscan_viewer");
+  if (!configureThreads(parser, settings.value("threads", 0).toInt())) {
+    return 1;
+  }
 
   ViewerWindow window;
   window.resize(1200, 800);
@@ -1,15 +1,39 @@
 #include <QCoreApplication>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTemporaryDir>
+#include <QThread>
 
+#include <atomic>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 
 #include <zlib.h>
 
+#include "DiskCheck.h"
+#include "ExtensionTreemap.h"
+#include "FileRemover.h"
+#include "TreeDiff.h"
+#include "TreeExport.h"
 #include "TreeLayout.h"
 #include "TreeModel.h"
 #include "TreeReader.h"
+#include "FilterExpression.h"
+#include "FrameStats.h"
+#include "NodeTable.h"
+#include "ScanStats.h"
+#include "ScanGenerator.h"
+#include "SearchIndex.h"
+#include "SnapshotPool.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+#include "TreeRenderer.h"
 #include "Utils.h"
 
 namespace {
@@ -48,6 +72,23 @@ QString writeTempFile(const QTemporaryDir &dir, const QString &name,
   return path;
 }
 
+TreeNode *makeRoot(const QString &name) {
+  auto *root = new TreeNode();
+  root->name = name;
+  root->isDir = true;
+  return root;
+}
+
+TreeNode *addChild(TreeNode *parent, const QString &name, bool isDir,
+                   quint64 size) {
+  auto *node = new TreeNode();
+  node->name = name;
+  node->isDir = isDir;
+  node->size = size;
+  parent->children.push_back(node);
+  return node;
+}
+
 QByteArray gzipCompress(const QByteArray &data) {
   z_stream stream;
   std::memset(&stream, 0, sizeof(stream));
@@ -92,36 +133,178 @@ bool testTreeLayout() {
   childA->name = "A";
   childA->size = 60;
   childA->isDir = false;
-  childA->parent = root;
+  childA->id = 1;
 
   auto *childB = new TreeNode();
   childB->name = "B";
   childB->size = 40;
   childB->isDir = false;
-  childB->parent = root;
+  childB->id = 2;
 
   root->children = {childA, childB};
-  TreeLayout::layout(root, QRectF(0, 0, 100, 100));
+  TreeLayout::ViewState view;
+  TreeLayout::layout(root, QRectF(0, 0, 100, 100), view);
+
+  const QRectF rootRect = view.rect(root);
+  QRectF rectA = view.rect(childA);
+  QRectF rectB = view.rect(childB);
 
   bool ok = true;
-  ok &= expectTrue(childA->rect.width() > 0.0, "childA width > 0");
-  ok &= expectTrue(childA->rect.height() > 0.0, "childA height > 0");
-  ok &= expectTrue(childB->rect.width() > 0.0, "childB width > 0");
-  ok &= expectTrue(childB->rect.height() > 0.0, "childB height > 0");
-  ok &= expectTrue(!childA->rect.intersects(childB->rect),
-                   "children do not overlap");
-  ok &= expectTrue(root->rect.contains(childA->rect), "root contains childA");
-  ok &= expectTrue(root->rect.contains(childB->rect), "root contains childB");
+  ok &= expectTrue(rectA.width() > 0.0, "childA width > 0");
+  ok &= expectTrue(rectA.height() > 0.0, "childA height > 0");
+  ok &= expectTrue(rectB.width() > 0.0, "childB width > 0");
+  ok &= expectTrue(rectB.height() > 0.0, "childB height > 0");
+  ok &= expectTrue(!rectA.intersects(rectB), "children do not overlap");
+  ok &= expectTrue(rootRect.contains(rectA), "root contains childA");
+  ok &= expectTrue(rootRect.contains(rectB), "root contains childB");
 
   // Orientation check (GrandPerspective-compatible): larger item should be
   // placed towards the top-left compared to smaller items.
-  ok &= expectTrue(childA->rect.center().x() < childB->rect.center().x(),
-                   "A is left of B");
+  ok &= expectTrue(rectA.center().x() < rectB.center().x(), "A is left of B");
 
   // Vertical split case: larger item should be above smaller item.
-  TreeLayout::layout(root, QRectF(0, 0, 50, 100));
-  ok &= expectTrue(childA->rect.center().y() < childB->rect.center().y(),
-                   "A is above B");
+  TreeLayout::layout(root, QRectF(0, 0, 50, 100), view);
+  rectA = view.rect(childA);
+  rectB = view.rect(childB);
+  ok &= expectTrue(rectA.center().y() < rectB.center().y(), "A is above B");
+
+  TreeModel::deleteSubtree(root);
+  return ok;
+}
+
+bool testTreeLayoutVisit() {
+  auto *root = new TreeNode();
+  root->name = "/";
+  root->isDir = true;
+
+  auto *childA = new TreeNode();
+  childA->name = "A";
+  childA->size = 60;
+  childA->id = 1;
+
+  auto *childB = new TreeNode();
+  childB->name = "B";
+  childB->size = 40;
+  childB->id = 2;
+
+  root->children = {childA, childB};
+  TreeLayout::ViewState view;
+  TreeLayout::layout(root, QRectF(0, 0, 100, 100), view);
+  const QRectF rectA = view.rect(childA);
+  const QRectF rectB = view.rect(childB);
+
+  QVector<TreeNode *> visited;
+  QVector<QRectF> rects;
+  QVector<int> depths;
+  TreeLayout::visit(root, QRectF(0, 0, 100, 100), 0.0,
+                    [&](TreeNode *node, const QRectF &rect, int depth) {
+                      visited.push_back(node);
+                      rects.push_back(rect);
+                      depths.push_back(depth);
+                    });
+
+  bool ok = true;
+  ok &= expectTrue(visited.size() == 3, "visit reaches every node");
+  ok &= expectTrue(!visited.isEmpty() && visited.first() == root,
+                   "visit starts at root");
+  for (int i = 0; i < visited.size(); ++i) {
+    if (visited[i] == childA) {
+      ok &= expectTrue(rects[i] == rectA, "visit matches layout for A");
+      ok &= expectTrue(depths[i] == 1, "A depth == 1");
+    } else if (visited[i] == childB) {
+      ok &= expectTrue(rects[i] == rectB, "visit matches layout for B");
+    }
+  }
+
+  // visit() must leave the stored layout alone.
+  TreeLayout::visit(root, QRectF(0, 0, 10, 10), 0.0,
+                    [](TreeNode *, const QRectF &, int) {});
+  ok &= expectTrue(view.rect(childA) == rectA, "visit does not modify rects");
+
+  // Children narrower than minSize are pruned.
+  int count = 0;
+  TreeLayout::visit(root, QRectF(0, 0, 100, 100), 50.0,
+                    [&](TreeNode *, const QRectF &, int) { ++count; });
+  ok &= expectTrue(count == 2, "minSize prunes the smaller child");
+
+  TreeModel::deleteSubtree(root);
+  return ok;
+}
+
+bool testTreeRenderer() {
+  auto *root = new TreeNode();
+  root->name = "/";
+  root->isDir = true;
+
+  auto *childA = new TreeNode();
+  childA->name = "a.txt";
+  childA->size = 50;
+  childA->id = 1;
+
+  auto *childB = new TreeNode();
+  childB->name = "b.iso";
+  childB->size = 50;
+  childB->id = 2;
+
+  root->children = {childA, childB};
+
+  TreeRenderer renderer;
+  renderer.setPalette({QColor(Qt::red), QColor(Qt::blue)});
+  renderer.setColorMappingMode(TreeRenderer::ColorMappingMode::Level);
+
+  const QImage image = renderer.render(root, QSize(40, 20));
+  bool ok = true;
+  ok &= expectTrue(image.size() == QSize(40, 20), "render size");
+  ok &= expectTrue(image.pixel(10, 10) != qRgb(0, 0, 0),
+                   "left half is painted");
+  ok &= expectTrue(image.pixel(30, 10) != qRgb(0, 0, 0),
+                   "right half is painted");
+  TreeLayout::ViewState view;
+  renderer.render(root, QSize(40, 20), nullptr, &view);
+  ok &= expectTrue(view.rects.empty(), "render does not touch rects");
+
+  TreeLayout::layout(root, QRectF(0, 0, 40, 40), view);
+  std::vector<TreeRenderer::DisplayItem> items;
+  renderer.buildDisplayList(root, view, 1.0, items);
+  ok &= expectTrue(items.size() == 3, "display list has three rectangles");
+  ok &= expectTrue(!items.empty() && items.front().node == root,
+                   "display list starts at root");
+  ok &= expectTrue(items.size() == 3 && items[1].depth == 1 &&
+                       items[1].paletteIndex == 1,
+                   "child depth and level color");
+
+  // At this scale the root covers one pixel but its children do not.
+  size_t culled = 0;
+  renderer.buildDisplayList(root, view, 0.03, items, &culled);
+  ok &= expectTrue(items.size() == 1 && culled == 2,
+                   "sub-pixel children are culled");
+
+  TreeRenderer::ColorMappingMode mode = TreeRenderer::ColorMappingMode::Name;
+  ok &= expectTrue(TreeRenderer::parseColorMappingMode("Top-Folder", &mode) &&
+                       mode == TreeRenderer::ColorMappingMode::TopFolder,
+                   "parse color mapping mode");
+  ok &= expectTrue(!TreeRenderer::parseColorMappingMode("bogus", &mode),
+                   "reject unknown color mapping mode");
+
+  // Strip-wise PNG export must match the single-pass render exactly.
+  QTemporaryDir dir;
+  const QString pngPath = dir.filePath("strips.png");
+  QString error;
+  int lastRows = 0;
+  ok &= expectTrue(dir.isValid() &&
+                       renderer.renderToPng(
+                           root, QSize(37, 23), pngPath, &error,
+                           [&lastRows](int rows) {
+                             lastRows = rows;
+                             return true;
+                           },
+                           5),
+                   "render to PNG in strips");
+  ok &= expectTrue(lastRows == 23, "progress reaches last row");
+  const QImage expected = renderer.render(root, QSize(37, 23));
+  const QImage exported =
+      QImage(pngPath).convertToFormat(QImage::Format_RGB32);
+  ok &= expectTrue(exported == expected, "PNG strips match render");
 
   TreeModel::deleteSubtree(root);
   return ok;
@@ -170,6 +353,966 @@ bool testTreeReaderGzip() {
   return ok;
 }
 
+bool testScanStats() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+
+  QString error;
+  ScanStats stats(1);
+  bool ok = expectTrue(
+      TreeReader::parseFile(writeTempFile(dir, "sample.xml", sampleXml()),
+                            stats, &error),
+      "stream sample xml");
+  ok &= expectTrue(stats.totalSize() == 100, "stats total size");
+  ok &= expectTrue(stats.fileCount() == 2 && stats.folderCount() == 1,
+                   "stats file and folder counts");
+  const QVector<ScanStats::Entry> files = stats.largestFiles();
+  ok &= expectTrue(files.size() == 1 && files[0].path == "/fileA" &&
+                       files[0].size == 60,
+                   "top-N keeps largest file");
+  const QVector<ScanStats::Entry> folders = stats.largestFolders();
+  ok &= expectTrue(folders.size() == 1 && folders[0].size == 100,
+                   "folder size derived from children");
+
+  // Large enough to span several read and inflate chunks.
+  QByteArray xml("<GrandPerspectiveScanDump>\n"
+                 "<ScanInfo volumePath=\"/data\">\n<Folder name=\"/\">\n");
+  const int fileCount = 20000;
+  for (int i = 0; i < fileCount; ++i) {
+    xml += QStringLiteral("<File name=\"file%1.bin\" size=\"%2\" />\n")
+               .arg(i)
+               .arg(i + 1)
+               .toUtf8();
+  }
+  xml += "</Folder>\n</ScanInfo>\n</GrandPerspectiveScanDump>\n";
+  const quint64 expectedTotal =
+      static_cast<quint64>(fileCount) * (fileCount + 1) / 2;
+
+  ScanStats largeStats(3);
+  ok &= expectTrue(
+      TreeReader::parseFile(
+          writeTempFile(dir, "large.gpscan", gzipCompress(xml)), largeStats,
+          &error),
+      "stream chunked gzip");
+  ok &= expectTrue(largeStats.fileCount() == static_cast<quint64>(fileCount) &&
+                       largeStats.totalSize() == expectedTotal,
+                   "chunked gzip totals");
+  const QVector<ScanStats::Entry> largest = largeStats.largestFiles();
+  ok &= expectTrue(largest.size() == 3 &&
+                       largest[0].path == "/data/file19999.bin",
+                   "chunked gzip largest file");
+  const QVector<ScanStats::ExtensionTotal> extensions =
+      largeStats.extensions();
+  ok &= expectTrue(extensions.size() == 1 &&
+                       extensions[0].extension == "bin" &&
+                       extensions[0].files == static_cast<quint64>(fileCount),
+                   "size per extension");
+
+  auto model =
+      TreeReader::readFromFile(writeTempFile(dir, "large.xml", xml), &error);
+  ok &= expectTrue(model && model->root()->children.size() == fileCount &&
+                       model->root()->size == expectedTotal,
+                   "chunked xml model");
+  return ok;
+}
+
+bool testTreeExport() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+
+  TreeNode *root = makeRoot("/");
+  root->size = 30;
+
+  auto *folder = new TreeNode();
+  folder->name = "a,b";
+  folder->isDir = true;
+  folder->size = 10;
+
+  auto *file = new TreeNode();
+  file->name = "x\"y.txt";
+  file->size = 10;
+  folder->children = {file};
+
+  auto *other = new TreeNode();
+  other->name = "z";
+  other->size = 20;
+  root->children = {folder, other};
+
+  auto readAll = [](const QString &path) {
+    QFile in(path);
+    return in.open(QIODevice::ReadOnly) ? in.readAll() : QByteArray();
+  };
+
+  bool ok = true;
+  QString error;
+  const QString csvPath = dir.filePath("listing.csv");
+  ok &= expectTrue(TreeExport::formatForPath(csvPath) ==
+                       TreeExport::Format::Csv,
+                   "csv format from path");
+  ok &= expectTrue(TreeExport::exportTree(root, csvPath,
+                                          TreeExport::Format::Csv, &error),
+                   "export csv");
+  ok &= expectTrue(readAll(csvPath) == "path,size,type,depth\n"
+                                       "/,30,folder,0\n"
+                                       "\"/a,b\",10,folder,1\n"
+                                       "\"/a,b/x\"\"y.txt\",10,file,2\n"
+                                       "/z,20,file,1\n",
+                   "csv rows in depth-first order");
+
+  const QString jsonPath = dir.filePath("listing.ndjson");
+  ok &= expectTrue(TreeExport::formatForPath(jsonPath + ".gz") ==
+                       TreeExport::Format::NdJson,
+                   "ndjson format from path");
+  ok &= expectTrue(TreeExport::exportTree(folder, jsonPath,
+                                          TreeExport::Format::NdJson, &error),
+                   "export ndjson");
+  ok &= expectTrue(
+      readAll(jsonPath) ==
+          "{\"path\":\"a,b\",\"size\":10,\"type\":\"folder\",\"depth\":0}\n"
+          "{\"path\":\"a,b/x\\\"y.txt\",\"size\":10,\"type\":\"file\","
+          "\"depth\":1}\n",
+      "ndjson rows escape quotes");
+
+  const QString gzipPath = dir.filePath("listing.csv.gz");
+  ok &= expectTrue(TreeExport::exportTree(root, gzipPath,
+                                          TreeExport::Format::Csv, &error),
+                   "export gzip csv");
+  const QByteArray gzipData = readAll(gzipPath);
+  ok &= expectTrue(gzipData.size() > 2 &&
+                       static_cast<unsigned char>(gzipData[0]) == 0x1f &&
+                       static_cast<unsigned char>(gzipData[1]) == 0x8b,
+                   "gzip output");
+
+  TreeModel::deleteSubtree(root);
+  return ok;
+}
+
+bool testSearchIndex() {
+  TreeNode *root = makeRoot("/");
+
+  TreeNode *project = addChild(root, "project", true, 0);
+  TreeNode *modules = addChild(project, "node_modules", true, 0);
+  TreeNode *dump = addChild(project, "app.CORE", false, 0);
+  TreeNode *other = addChild(root, "core.txt", false, 0);
+  TreeNode *oldDump = addChild(modules, "old.core", false, 0);
+
+  const SearchIndex index(NodeTable::build(root));
+  bool ok = true;
+  ok &= expectTrue(index.nodeCount() == 6, "index covers every node");
+
+  QVector<TreeNode *> matches = index.find("core");
+  ok &= expectTrue(matches == QVector<TreeNode *>({oldDump, dump, other}),
+                   "substring ignores case, depth-first order");
+
+  matches = index.find("*.core");
+  ok &= expectTrue(matches == QVector<TreeNode *>({oldDump, dump}),
+                   "glob matches whole names");
+
+  matches = index.find("node_mod*");
+  ok &= expectTrue(matches == QVector<TreeNode *>({modules}),
+                   "glob with prefix literal");
+
+  matches = index.find("[ao]*");
+  ok &= expectTrue(matches == QVector<TreeNode *>({oldDump, dump}),
+                   "glob bracket expression");
+
+  ok &= expectTrue(index.find("j").size() == 1, "short query scans names");
+  ok &= expectTrue(index.find("zzz").isEmpty(), "missing trigram");
+  ok &= expectTrue(index.find("  ").isEmpty(), "empty query");
+
+  TreeModel::deleteSubtree(root);
+  return ok;
+}
+
+bool testFilterExpression() {
+  TreeNode *root = makeRoot("/");
+
+  const quint64 gib = 1024ull * 1024 * 1024;
+  TreeNode *images = addChild(root, "images", true, 0);
+  TreeNode *iso = addChild(images, "disk.ISO", false, 2 * gib);
+  addChild(images, "small.iso", false, 1000);
+  TreeNode *log = addChild(root, "app.log", false, 3000);
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+
+  auto table = NodeTable::build(root);
+  bool ok = expectTrue(table->rowCount() == 5, "table has a row per node");
+  ok &= expectTrue(table->subtreeEnd[0] == 5 && table->subtreeEnd[1] == 4 &&
+                       table->depths[2] == 2,
+                   "subtree ranges and depths");
+
+  auto rowsMatching = [&](const char *text) {
+    QString error;
+    auto expression = FilterExpression::parse(text, &error);
+    QVector<TreeNode *> nodes;
+    if (!expression) {
+      return nodes;
+    }
+    const std::vector<quint8> mask = expression->evaluate(*table);
+    for (size_t row = 0; row < mask.size(); ++row) {
+      if (mask[row]) {
+        nodes.push_back(table->nodes[row]);
+      }
+    }
+    return nodes;
+  };
+
+  ok &= expectTrue(rowsMatching("size > 1G && ext == \"iso\"") ==
+                       QVector<TreeNode *>({iso}),
+                   "size suffix and extension");
+  ok &= expectTrue(rowsMatching("depth <= 1 && !isDir") ==
+                       QVector<TreeNode *>({log}),
+                   "depth and negated flag");
+  ok &= expectTrue(rowsMatching("name ~ \"*.log\" || (isDir && depth == 1)") ==
+                       QVector<TreeNode *>({images, log}),
+                   "glob, grouping and or");
+
+  QString error;
+  ok &= expectTrue(!FilterExpression::parse("size >", &error) &&
+                       !error.isEmpty(),
+                   "reports missing operand");
+  ok &= expectTrue(!FilterExpression::parse("colour == 1", &error),
+                   "rejects unknown field");
+
+  // Hiding the large image shrinks its folder for the layout.
+  QString parseError;
+  auto hideIso = FilterExpression::parse("ext == iso && size > 1M",
+                                         &parseError);
+  TreeLayout::ViewState view;
+  Utils::applyHiddenMask(view, *table, hideIso->evaluate(*table));
+  ok &= expectTrue(view.isHidden(iso) && view.visibleSize(iso) == 0,
+                   "node hidden");
+  ok &= expectTrue(view.visibleSize(images) == 1000 &&
+                       view.visibleSize(root) == 4000,
+                   "ancestors lose hidden bytes");
+  TreeLayout::layout(root, QRectF(0, 0, 40, 40), view);
+  const QRectF logRect = view.rect(log);
+  ok &= expectTrue(logRect.width() * logRect.height() > 40 * 40 / 2,
+                   "layout re-flows around hidden nodes");
+
+  Utils::clearHidden(view);
+  ok &= expectTrue(!view.isHidden(iso) && view.visibleSize(root) == root->size,
+                   "clear hidden");
+  return ok;
+}
+
+bool testLargestItems() {
+  TreeNode *root = makeRoot("/");
+
+  // Enough files to span several reduction chunks.
+  TreeNode *bulk = addChild(root, "bulk", true, 0);
+  for (int i = 0; i < 70000; ++i) {
+    addChild(bulk, QString("f%1").arg(i), false, quint64(i));
+  }
+  TreeNode *other = addChild(root, "other", true, 0);
+  TreeNode *huge = addChild(other, "huge.bin", false, 1000000);
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+
+  auto table = NodeTable::build(root);
+  bool ok = expectTrue(table->rowOf(huge) >= 0 &&
+                           table->nodes[table->rowOf(huge)] == huge,
+                       "rowOf finds a node's row");
+  TreeNode stranger;
+  ok &= expectTrue(table->rowOf(&stranger) == -1,
+                   "rowOf rejects nodes of other tables");
+
+  const NodeTable::TopItems top = table->largestItems(0, 3);
+  ok &= expectTrue(top.files.size() == 3 && top.folders.size() == 2,
+                   "largest items are bounded by the count");
+  ok &= expectTrue(top.files.size() == 3 &&
+                       table->nodes[top.files[0]] == huge &&
+                       table->sizes[top.files[1]] == 69999 &&
+                       table->sizes[top.files[2]] == 69998,
+                   "largest files are sorted by size");
+  ok &= expectTrue(top.folders.size() == 2 &&
+                       table->nodes[top.folders[0]] == bulk,
+                   "largest folders are sorted by size");
+
+  const NodeTable::TopItems scoped =
+      table->largestItems(quint32(table->rowOf(other)), 5);
+  ok &= expectTrue(scoped.files.size() == 1 && scoped.folders.empty() &&
+                       table->nodes[scoped.files[0]] == huge,
+                   "largest items are scoped to the subtree");
+  return ok;
+}
+
+bool testExtensionTotals() {
+  TreeNode *root = makeRoot("/");
+
+  // Enough files to span several reduction chunks.
+  TreeNode *logs = addChild(root, "logs", true, 0);
+  for (int i = 0; i < 100000; ++i) {
+    addChild(logs, QString("f%1.log").arg(i), false, 2);
+  }
+  TreeNode *media = addChild(root, "media", true, 0);
+  addChild(media, "a.ISO", false, 500000);
+  addChild(media, "b.iso", false, 1);
+  addChild(media, "README", false, 7);
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+
+  auto table = NodeTable::build(root);
+  const std::vector<NodeTable::ExtensionTotal> totals =
+      table->extensionTotals(0);
+  bool ok = expectTrue(totals.size() == 3, "one total per extension");
+  ok &= expectTrue(totals.size() == 3 &&
+                       table->extensionNames[totals[0].extension] == "iso" &&
+                       totals[0].bytes == 500001 && totals[0].files == 2,
+                   "extension totals ignore case and sort by size");
+  ok &= expectTrue(totals.size() == 3 && totals[1].bytes == 200000 &&
+                       totals[1].files == 100000,
+                   "extension totals add up across chunks");
+  ok &= expectTrue(totals.size() == 3 && totals[2].extension == 0 &&
+                       totals[2].bytes == 7,
+                   "files without an extension are totalled");
+
+  const std::vector<NodeTable::ExtensionTotal> scoped =
+      table->extensionTotals(quint32(table->rowOf(media)));
+  ok &= expectTrue(scoped.size() == 2 && scoped[0].files == 2,
+                   "extension totals are scoped to the subtree");
+
+  std::shared_ptr<TreeModel> byExtension =
+      ExtensionTreemap::buildModel(*table, totals);
+  TreeNode *top = byExtension->root();
+  ok &= expectTrue(top && top->children.size() == 3 &&
+                       top->size == 200000 + 500001 + 7,
+                   "extension treemap has one item per extension");
+  ok &= expectTrue(top && top->children.size() == 3 &&
+                       top->children[0]->name == "*.iso" &&
+                       top->children[2]->name == "(no extension)",
+                   "extension treemap items are labelled");
+  ok &= expectTrue(top && top->children.size() == 3 &&
+                       !Utils::buildFullPath(*byExtension, top->children[0])
+                            .startsWith(QLatin1Char('/')),
+                   "extension treemap paths are not absolute");
+  return ok;
+}
+
+bool testTreeDiff() {
+  // The baseline was scanned under another volume name; roots still pair.
+  TreeNode *oldRoot = makeRoot("/old");
+  TreeNode *oldDocs = addChild(oldRoot, "docs", true, 0);
+  addChild(oldDocs, "a.txt", false, 100);
+  addChild(oldDocs, "b.txt", false, 50);
+  addChild(oldDocs, "gone.txt", false, 30);
+  addChild(oldRoot, "swap", false, 10);
+  TreeNode *oldCache = addChild(oldRoot, "cache", true, 0);
+  addChild(oldCache, "x.bin", false, 500);
+  TreeModel baseline;
+  baseline.setRoot(oldRoot);
+  baseline.computeDerivedSizes();
+
+  TreeNode *root = makeRoot("/new");
+  TreeNode *docs = addChild(root, "docs", true, 0);
+  TreeNode *a = addChild(docs, "a.txt", false, 150);
+  TreeNode *b = addChild(docs, "b.txt", false, 20);
+  TreeNode *fresh = addChild(docs, "new.txt", false, 5);
+  TreeNode *swap = addChild(root, "swap", true, 0); // Was a file
+  TreeNode *inSwap = addChild(swap, "page", false, 10);
+  TreeNode *cache = addChild(root, "cache", true, 0);
+  TreeNode *x = addChild(cache, "x.bin", false, 500);
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+
+  using Change = TreeDiff::Change;
+  auto diff = TreeDiff::compute(NodeTable::build(root), oldRoot);
+  bool ok = expectTrue(diff->changeOf(a) == Change::Grew &&
+                           diff->deltaOf(a) == 50,
+                       "grown file");
+  ok &= expectTrue(diff->changeOf(b) == Change::Shrank &&
+                       diff->deltaOf(b) == -30,
+                   "shrunk file");
+  ok &= expectTrue(diff->changeOf(fresh) == Change::Added &&
+                       diff->deltaOf(fresh) == 5,
+                   "new file");
+  ok &= expectTrue(diff->changeOf(x) == Change::Unchanged &&
+                       diff->changeOf(cache) == Change::Unchanged,
+                   "unchanged items");
+  ok &= expectTrue(diff->changeOf(swap) == Change::Added &&
+                       diff->changeOf(inSwap) == Change::Added,
+                   "an item that changed type is new");
+  ok &= expectTrue(diff->removedBytesOf(docs) == 30 &&
+                       diff->changeOf(docs) == Change::Removed &&
+                       diff->deltaOf(docs) == -5,
+                   "folder that lost items");
+  ok &= expectTrue(diff->removedBytesOf(root) == 10 &&
+                       diff->deltaOf(root) == 685 - 690,
+                   "removed bytes count direct children only");
+
+  TreeNode stranger;
+  ok &= expectTrue(diff->changeOf(&stranger) == Change::Unchanged &&
+                       diff->deltaOf(&stranger) == 0,
+                   "nodes of other trees are unchanged");
+
+  TreeRenderer renderer;
+  TreeRenderer::ColorMappingMode mode = TreeRenderer::ColorMappingMode::Name;
+  ok &= expectTrue(TreeRenderer::parseColorMappingMode("change", &mode) &&
+                       mode == TreeRenderer::ColorMappingMode::Change,
+                   "change color mode parses");
+  renderer.setColorMappingMode(mode);
+  renderer.setDiff(diff);
+  ok &= expectTrue(renderer.paletteIndexForNode(a, 2) !=
+                           renderer.paletteIndexForNode(b, 2) &&
+                       renderer.paletteIndexForNode(x, 2) !=
+                           renderer.paletteIndexForNode(a, 2),
+                   "change mode colors by change");
+  return ok;
+}
+
+bool testSnapshotPool() {
+  // One day's scan: a large folder that never changes and a log that grows.
+  auto makeDay = [&](quint64 logSize) {
+    TreeNode *root = makeRoot("/");
+    TreeNode *archive = addChild(root, "archive", true, 0);
+    for (int i = 0; i < 100; ++i) {
+      addChild(archive, QString("part%1").arg(i), false, quint64(i + 1));
+    }
+    TreeNode *logs = addChild(root, "logs", true, 0);
+    addChild(logs, "app.log", false, logSize);
+    auto model = std::make_unique<TreeModel>();
+    model->setRoot(root);
+    model->computeDerivedSizes();
+    return model;
+  };
+  std::function<QString(const TreeNode *)> dump =
+      [&dump](const TreeNode *node) {
+        QString text = QString("%1:%2:%3(")
+                           .arg(node->name)
+                           .arg(node->size)
+                           .arg(node->isDir ? 'd' : 'f');
+        for (const TreeNode *child : node->children) {
+          text += dump(child) + ",";
+        }
+        return text + ")";
+      };
+
+  SnapshotPool pool;
+  const auto day1 = makeDay(10);
+  const auto day2 = makeDay(20);
+  const auto day3 = makeDay(10);
+  pool.addTree(day1->root(), "day1");
+  const size_t afterOne = pool.uniqueNodeCount();
+  pool.addTree(day2->root(), "day2");
+  pool.addTree(day3->root(), "day3");
+
+  bool ok = expectTrue(pool.snapshots().size() == 3 &&
+                           pool.snapshots()[1].nodeCount == 104,
+                       "pool keeps every snapshot");
+  // A changed log re-stores only the log, its folder and the root.
+  ok &= expectTrue(afterOne == 104 && pool.uniqueNodeCount() == 104 + 3,
+                   "identical subtrees are stored once");
+  ok &= expectTrue(pool.snapshotHash(0) == pool.snapshotHash(2) &&
+                       pool.snapshotHash(0) != pool.snapshotHash(1),
+                   "snapshot hashes follow content");
+
+  const std::shared_ptr<TreeModel> restored = pool.materialize(1);
+  ok &= expectTrue(restored && restored->root() &&
+                       dump(restored->root()) == dump(day2->root()),
+                   "materialized snapshot matches its scan");
+  ok &= expectTrue(restored && restored->root() &&
+                       restored->parentOf(restored->root()->children[0]) ==
+                           restored->root(),
+                   "materialized nodes have parents");
+  ok &= expectTrue(!pool.materialize(3), "unknown snapshot");
+
+  QTemporaryDir dir;
+  const QString path = writeTempFile(dir, "day4.xml", sampleXml());
+  // Cut off after a nested folder was already interned.
+  QByteArray truncated = sampleXml();
+  truncated.truncate(truncated.indexOf("<File name=\"fileB\""));
+  truncated.replace("<File name=\"fileA\" size=\"60\" />",
+                    "<Folder name=\"sub\"><File name=\"z\" size=\"7\" />"
+                    "</Folder>");
+  const QString broken = writeTempFile(dir, "broken.xml", truncated);
+  QString error;
+  ok &= expectTrue(pool.addFile(path, &error) &&
+                       pool.snapshots().size() == 4 &&
+                       pool.snapshots()[3].nodeCount == 3,
+                   "scan file streamed into the pool");
+  const size_t before = pool.uniqueNodeCount();
+  ok &= expectTrue(!pool.addFile(broken, &error) &&
+                       pool.snapshots().size() == 4 &&
+                       pool.uniqueNodeCount() == before,
+                   "failed scan leaves the pool unchanged");
+  ok &= expectTrue(pool.materialize(3) &&
+                       pool.materialize(3)->root()->size == 100,
+                   "streamed folder sizes are derived");
+  return ok;
+}
+
+bool testScanGenerator() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+
+  auto countNodes = [](const TreeNode *root) {
+    quint64 count = 0;
+    int maxDepth = 0;
+    std::vector<std::pair<const TreeNode *, int>> pending{{root, 0}};
+    while (!pending.empty()) {
+      const auto [node, depth] = pending.back();
+      pending.pop_back();
+      ++count;
+      maxDepth = std::max(maxDepth, depth);
+      for (const TreeNode *child : node->children) {
+        pending.push_back({child, depth + 1});
+      }
+    }
+    return std::make_pair(count, maxDepth);
+  };
+
+  bool ok = true;
+  const std::pair<const char *, ScanGenerator::Shape> shapes[] = {
+      {"realistic", ScanGenerator::Shape::Realistic},
+      {"wide", ScanGenerator::Shape::Wide},
+      {"deep", ScanGenerator::Shape::Deep},
+  };
+  for (const auto &[name, shape] : shapes) {
+    ScanGenerator::Options options;
+    ScanGenerator::Shape parsed = ScanGenerator::Shape::Wide;
+    ok &= expectTrue(ScanGenerator::parseShape(name, &parsed) &&
+                         parsed == shape,
+                     "generator shape parses");
+    options.shape = shape;
+    options.nodes = 5000;
+    options.depth = 40;
+    options.gzip = shape == ScanGenerator::Shape::Realistic;
+    const QString path = dir.filePath(QString("%1.xml").arg(name));
+    QString error;
+    ok &= expectTrue(ScanGenerator::write(path, options, &error),
+                     "generator writes a scan");
+    auto model = TreeReader::readFromFile(path, &error);
+    ok &= expectTrue(model && model->root(), "generated scan loads");
+    if (!model || !model->root()) {
+      continue;
+    }
+    const auto [count, depth] = countNodes(model->root());
+    ok &= expectTrue(count == 5000, "generated scan has the requested size");
+    if (shape == ScanGenerator::Shape::Wide) {
+      ok &= expectTrue(depth == 1, "wide scan is flat");
+    } else if (shape == ScanGenerator::Shape::Deep) {
+      ok &= expectTrue(depth == 41, "deep scan nests to the chain length");
+    }
+  }
+  return ok;
+}
+
+bool testFrameStats() {
+  FrameStats stats(100);
+  bool ok = expectTrue(stats.count() == 0 && stats.last() == 0.0 &&
+                           stats.percentile95() == 0.0,
+                       "empty stats are zero");
+  for (int i = 1; i <= 200; ++i) {
+    stats.add(i);
+  }
+  // Only the last 100 samples, 101..200, remain.
+  ok &= expectTrue(stats.count() == 100, "window is bounded");
+  ok &= expectTrue(stats.last() == 200.0 && stats.min() == 101.0,
+                   "oldest samples are dropped");
+  ok &= expectTrue(stats.average() == 150.5, "average of the window");
+  ok &= expectTrue(stats.percentile95() == 195.0, "nearest-rank p95");
+  stats.clear();
+  stats.add(3.0);
+  ok &= expectTrue(stats.count() == 1 && stats.min() == 3.0 &&
+                       stats.percentile95() == 3.0,
+                   "clear restarts the window");
+  return ok;
+}
+
+bool testMemoryReport() {
+  TreeModel model;
+  TreeNode *root = new TreeNode();
+  root->isDir = true;
+  TreeNode *child = new TreeNode();
+  child->name = "child";
+  root->children.push_back(child);
+  model.setRoot(root);
+  const TreeModel::MemoryReport memory = TreeModel::memoryReport(model.root());
+  bool ok = expectTrue(memory.nodes == 2 &&
+                           memory.nodeBytes == 2 * sizeof(TreeNode),
+                       "memory report covers every node");
+  ok &= expectTrue(memory.childBytes >= sizeof(TreeNode *) &&
+                       memory.nameBytes >= 5 * sizeof(QChar),
+                   "memory report counts children and names");
+  ok &= expectTrue(memory.totalBytes() ==
+                       memory.nodeBytes + memory.childBytes +
+                           memory.nameBytes,
+                   "memory total is the sum of its parts");
+  ok &= expectTrue(TreeModel::memoryReport(nullptr).totalBytes() == 0,
+                   "empty memory report");
+  return ok;
+}
+
+bool testModelEdit() {
+  TreeNode *root = makeRoot("/data");
+  TreeNode *logs = addChild(root, "logs", true, 0);
+  TreeNode *old = addChild(logs, "old.log", false, 30);
+  TreeNode *newLog = addChild(logs, "new.log", false, 20);
+  TreeNode *cache = addChild(root, "cache", true, 0);
+  TreeNode *blob = addChild(cache, "blob", false, 100);
+  auto model = std::make_shared<TreeModel>();
+  model->setRoot(root);
+  model->computeDerivedSizes();
+
+  bool ok = expectTrue(Utils::findNode(*model, "/data/logs/old.log") == old &&
+                           Utils::findNode(*model, "/data") == root &&
+                           !Utils::findNode(*model, "/data/missing") &&
+                           !Utils::findNode(*model, "/other/logs"),
+                       "findNode resolves full paths");
+
+  std::shared_ptr<const NodeTable> table = NodeTable::build(model);
+  std::shared_ptr<TreeModel> edited =
+      TreeModel::withoutSubtrees(*model, {old, cache, blob});
+  model.reset();
+  // The table still holds the old version, which the edit left untouched.
+  ok &= expectTrue(table->model && table->rowCount() == 6 &&
+                       root->size == 150 && logs->children.size() == 2,
+                   "edits leave the shared version intact");
+
+  TreeNode *top = edited->root();
+  ok &= expectTrue(edited->version() == 1 && top && top != root &&
+                       top->size == 20 && top->children.size() == 1,
+                   "edited version drops removed subtrees");
+  TreeNode *newLogs = Utils::findNode(*edited, "/data/logs");
+  ok &= expectTrue(newLogs && newLogs->size == 20 &&
+                       newLogs->children.size() == 1 &&
+                       edited->parentOf(newLog) == newLogs &&
+                       Utils::buildFullPath(*edited, newLog) ==
+                           "/data/logs/new.log",
+                   "edited version keeps the rest of the tree");
+  // Only the ancestors of removed nodes are copied.
+  ok &= expectTrue(newLogs && newLogs != logs &&
+                       newLogs->children.size() == 1 &&
+                       newLogs->children[0] == newLog,
+                   "untouched subtrees are shared between versions");
+  ok &= expectTrue(edited->contains(newLog) && !edited->contains(logs) &&
+                       !edited->contains(old) && !edited->contains(blob),
+                   "edited version contains only its own nodes");
+  table.reset();
+  ok &= expectTrue(newLog->refs == 1 && newLog->name == "new.log",
+                   "shared nodes outlive the old version");
+  return ok;
+}
+
+bool testFileRemover() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+  QDir(dir.path()).mkpath("victim/sub/deeper");
+  QDir(dir.path()).mkpath("keep");
+  writeTempFile(dir, "victim/a.bin", QByteArray(100, 'a'));
+  writeTempFile(dir, "victim/sub/b.bin", QByteArray(20, 'b'));
+  writeTempFile(dir, "victim/sub/deeper/.hidden", QByteArray(3, 'c'));
+  const QString kept = writeTempFile(dir, "keep/target.bin", "xyz");
+  QFile::link(dir.filePath("keep"), dir.filePath("victim/link"));
+
+  quint64 reports = 0;
+  const FileRemover::Result result = FileRemover::remove(
+      dir.filePath("victim"), [&reports](const FileRemover::Progress &) {
+        ++reports;
+        return true;
+      });
+  // Three files, the link and three folders.
+  bool ok = expectTrue(result.errors.isEmpty() && !result.canceled &&
+                           result.removed.items == 7 &&
+                           result.removed.bytes == 123,
+                       "folder removed with totals");
+  ok &= expectTrue(reports > 0 && !QFileInfo::exists(dir.filePath("victim")),
+                   "removal reports progress and finishes");
+  ok &= expectTrue(QFileInfo::exists(kept), "link targets are not followed");
+
+  const FileRemover::Result missing =
+      FileRemover::remove(dir.filePath("victim"));
+  ok &= expectTrue(missing.errors.size() == 1 && missing.removed.items == 0,
+                   "missing path is reported");
+
+  QDir(dir.path()).mkpath("many");
+  for (int i = 0; i < 1000; ++i) {
+    writeTempFile(dir, QString("many/%1").arg(i), "x");
+  }
+  const FileRemover::Result stopped = FileRemover::remove(
+      dir.filePath("many"),
+      [](const FileRemover::Progress &) { return false; });
+  ok &= expectTrue(stopped.canceled && stopped.removed.items < 1000 &&
+                       QFileInfo::exists(dir.filePath("many")),
+                   "removal stops when cancelled");
+  return ok;
+}
+
+bool testDiskCheck() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+  QDir(dir.path()).mkpath("gone/inner");
+  QDir(dir.path()).mkpath("kept");
+  writeTempFile(dir, "same.bin", QByteArray(10, 's'));
+  writeTempFile(dir, "grown.bin", QByteArray(10, 'g'));
+  writeTempFile(dir, "gone/inner/old.bin", QByteArray(5, 'o'));
+  writeTempFile(dir, "kept/deleted.bin", QByteArray(7, 'd'));
+
+  TreeNode *root = makeRoot(dir.path());
+  TreeNode *same = addChild(root, "same.bin", false, 10);
+  TreeNode *grown = addChild(root, "grown.bin", false, 10);
+  TreeNode *gone = addChild(root, "gone", true, 0);
+  TreeNode *inner = addChild(gone, "inner", true, 0);
+  TreeNode *old = addChild(inner, "old.bin", false, 5);
+  TreeNode *kept = addChild(root, "kept", true, 0);
+  TreeNode *deleted = addChild(kept, "deleted.bin", false, 7);
+  auto model = std::make_shared<TreeModel>();
+  model->setRoot(root);
+  model->computeDerivedSizes();
+  auto table = NodeTable::build(model);
+
+  // Change the disk after the "scan".
+  writeTempFile(dir, "grown.bin", QByteArray(25, 'g'));
+  QDir(dir.filePath("gone")).removeRecursively();
+  QFile::remove(dir.filePath("kept/deleted.bin"));
+
+  using Status = DiskCheck::Status;
+  std::shared_ptr<const DiskCheck> check = DiskCheck::run(table, true);
+  bool ok = expectTrue(check != nullptr, "disk check completes");
+  if (!check) {
+    return ok;
+  }
+  ok &= expectTrue(check->statusOf(same) == Status::Present &&
+                       check->statusOf(kept) == Status::Present &&
+                       check->statusOf(root) == Status::Present,
+                   "items still on disk are present");
+  ok &= expectTrue(check->statusOf(gone) == Status::Missing &&
+                       check->statusOf(inner) == Status::Missing &&
+                       check->statusOf(old) == Status::Missing &&
+                       check->statusOf(deleted) == Status::Missing,
+                   "vanished items and their contents are missing");
+  ok &= expectTrue(check->statusOf(grown) == Status::Resized &&
+                       check->resizedItems() == 1,
+                   "size changes are detected");
+  ok &= expectTrue(check->missingItems() == 4 && check->missingBytes() == 12,
+                   "missing bytes count each vanished folder once");
+
+  std::shared_ptr<const DiskCheck> namesOnly = DiskCheck::run(table, false);
+  ok &= expectTrue(namesOnly &&
+                       namesOnly->statusOf(grown) == Status::Present &&
+                       namesOnly->resizedItems() == 0,
+                   "sizes are only compared on request");
+
+  // Allocated sizes come in whole 512-byte blocks, never 10 bytes.
+  QByteArray xml = sampleXml();
+  xml.replace("fileSizeMeasure=\"logical\"", "fileSizeMeasure=\"physical\"");
+  QString error;
+  std::shared_ptr<TreeModel> physical = TreeReader::readFromFile(
+      writeTempFile(dir, "physical.xml", xml), &error);
+  ok &= expectTrue(physical && physical->sizeMeasure() ==
+                                   TreeModel::SizeMeasure::Physical,
+                   "reader keeps the scan's size measure");
+#ifdef Q_OS_UNIX
+  model->setSizeMeasure(TreeModel::SizeMeasure::Physical);
+  std::shared_ptr<const DiskCheck> blocks =
+      DiskCheck::run(NodeTable::build(model), true);
+  ok &= expectTrue(blocks && blocks->statusOf(same) == Status::Resized,
+                   "physical scans are compared by allocated size");
+#endif
+
+  TaskScheduler::CancelToken cancel;
+  cancel.cancel();
+  ok &= expectTrue(DiskCheck::run(table, false, cancel) == nullptr,
+                   "cancelled check returns nothing");
+  return ok;
+}
+
+bool testTrace() {
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    return expectTrue(false, "temporary directory valid");
+  }
+  const QString scanPath = writeTempFile(dir, "sample.xml", sampleXml());
+  const QString tracePath = dir.filePath("trace.json");
+
+  bool ok = expectTrue(!Trace::isEnabled(), "tracing starts disabled");
+  QString error;
+  TreeReader::readFromFile(scanPath, &error);
+  ok &= expectTrue(Trace::start(tracePath, &error) && Trace::isEnabled(),
+                   "trace starts");
+  ok &= expectTrue(TreeReader::readFromFile(scanPath, &error) != nullptr,
+                   "traced read");
+  ok &= expectTrue(Trace::finish(&error) && !Trace::isEnabled(),
+                   "trace written");
+  {
+    Trace::Scope late("late");
+  }
+
+  QFile file(tracePath);
+  ok &= expectTrue(file.open(QIODevice::ReadOnly), "trace file exists");
+  const QJsonArray events = QJsonDocument::fromJson(file.readAll())
+                                .object()
+                                .value("traceEvents")
+                                .toArray();
+  QStringList spans;
+  qint64 nodes = -1;
+  bool named = false;
+  for (const QJsonValue &value : events) {
+    const QJsonObject event = value.toObject();
+    const QString name = event.value("name").toString();
+    const QString phase = event.value("ph").toString();
+    if (phase == "X") {
+      spans.append(name);
+      ok &= expectTrue(event.value("dur").toDouble() >= 0,
+                       "span duration is set");
+    }
+    if (phase == "X" && name == "TreeReader::parseFile") {
+      nodes = event.value("args").toObject().value("nodes").toInteger();
+    }
+    if (phase == "M" && name == "thread_name") {
+      named = event.value("args").toObject().value("name").toString() ==
+              "main";
+    }
+  }
+  // One read was traced; the one before start() and the late scope were not.
+  ok &= expectTrue(spans.count("TreeReader::readFromFile") == 1 &&
+                       spans.count("TreeModel::computeDerivedSizes") == 1,
+                   "load phases traced once");
+  ok &= expectTrue(!spans.contains("late"), "no spans after finish");
+  ok &= expectTrue(nodes == 3, "parse span carries the node count");
+  ok &= expectTrue(named, "main thread named");
+  return ok;
+}
+
+bool testTaskScheduler() {
+  bool ok = true;
+  std::vector<std::atomic<int>> visits(10000);
+  ok &= expectTrue(TaskScheduler::parallelFor(
+                       visits.size(), 64,
+                       [&visits](size_t begin, size_t end) {
+                         for (size_t i = begin; i < end; ++i) {
+                           visits[i].fetch_add(1);
+                         }
+                       }),
+                   "parallel loop completes");
+  bool once = true;
+  for (const std::atomic<int> &count : visits) {
+    once &= count.load() == 1;
+  }
+  ok &= expectTrue(once, "parallel loop visits every index once");
+
+  TaskScheduler::CancelToken cancel;
+  cancel.cancel();
+  std::atomic<int> chunks{0};
+  ok &= expectTrue(!TaskScheduler::parallelFor(
+                       1000, 10, [&chunks](size_t, size_t) { ++chunks; },
+                       TaskScheduler::Priority::Normal, cancel) &&
+                       chunks.load() == 0,
+                   "canceled loop skips its chunks");
+
+  QFuture<int> answer = TaskScheduler::run(
+      TaskScheduler::Priority::Background, [] { return 42; });
+  ok &= expectTrue(answer.result() == 42, "task result reaches the future");
+
+  // Interactive jobs start even while a background loop holds every shared
+  // worker; the loop only lets go once the interactive job has run.
+  std::atomic<bool> released{false};
+  std::atomic<bool> timedOut{false};
+  QFuture<bool> busy = TaskScheduler::run(
+      TaskScheduler::Priority::Background, [&released, &timedOut] {
+        return TaskScheduler::parallelFor(
+            TaskScheduler::threadCount() * 4, 1,
+            [&released, &timedOut](size_t, size_t) {
+              for (int waited = 0; !released.load(); ++waited) {
+                if (waited == 500) {
+                  timedOut.store(true);
+                  return;
+                }
+                QThread::msleep(10);
+              }
+            },
+            TaskScheduler::Priority::Background);
+      });
+  QFuture<void> urgent = TaskScheduler::run(
+      TaskScheduler::Priority::Interactive,
+      [&released] { released.store(true); });
+  urgent.waitForFinished();
+  ok &= expectTrue(busy.result() && !timedOut.load(),
+                   "interactive job runs beside a background loop");
+
+  // Records the thread that destroys it.
+  struct Probe {
+    std::atomic<QThread *> *destroyedOn = nullptr;
+    ~Probe() { destroyedOn->store(QThread::currentThread()); }
+  };
+  std::atomic<QThread *> destroyedOn{nullptr};
+  auto probe = std::make_shared<Probe>();
+  probe->destroyedOn = &destroyedOn;
+  std::shared_ptr<Probe> handle =
+      TaskScheduler::destroyInBackground(std::move(probe));
+  std::shared_ptr<Probe> copy = handle;
+  handle.reset();
+  ok &= expectTrue(destroyedOn.load() == nullptr,
+                   "background release waits for the last copy");
+  copy.reset();
+  TaskScheduler::reservedPool()->waitForDone();
+  ok &= expectTrue(destroyedOn.load() != nullptr &&
+                       destroyedOn.load() != QThread::currentThread(),
+                   "last copy is destroyed on the pool");
+
+  int parsed = -1;
+  ok &= expectTrue(TaskScheduler::parseThreadCount("8", &parsed) &&
+                       parsed == 8 &&
+                       !TaskScheduler::parseThreadCount("-1", &parsed) &&
+                       !TaskScheduler::parseThreadCount("many", &parsed),
+                   "thread counts parse");
+
+  // Reductions must not depend on how many threads share the work.
+  TreeNode *root = makeRoot("/");
+  for (int d = 0; d < 50; ++d) {
+    auto *dir = new TreeNode();
+    dir->name = QString("d%1").arg(d);
+    dir->isDir = true;
+    root->children.push_back(dir);
+    for (int f = 0; f < 2000; ++f) {
+      auto *file = new TreeNode();
+      file->name = QString("f%1.e%2").arg(f).arg(f % 7);
+      file->size = quint64((f * 7919 + d * 104729) % 100003);
+      dir->children.push_back(file);
+    }
+  }
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+  auto table = NodeTable::build(root);
+
+  TaskScheduler::setThreadCount(1);
+  const NodeTable::TopItems serialTop = table->largestItems(0, 50);
+  const std::vector<NodeTable::ExtensionTotal> serialTotals =
+      table->extensionTotals(0);
+  TaskScheduler::setThreadCount(4);
+  const NodeTable::TopItems parallelTop = table->largestItems(0, 50);
+  const std::vector<NodeTable::ExtensionTotal> parallelTotals =
+      table->extensionTotals(0);
+  TaskScheduler::setThreadCount(0);
+
+  ok &= expectTrue(serialTop.files == parallelTop.files &&
+                       serialTop.folders == parallelTop.folders,
+                   "largest items match across thread counts");
+  bool sameTotals = serialTotals.size() == parallelTotals.size();
+  for (size_t i = 0; sameTotals && i < serialTotals.size(); ++i) {
+    sameTotals = serialTotals[i].extension == parallelTotals[i].extension &&
+                 serialTotals[i].bytes == parallelTotals[i].bytes &&
+                 serialTotals[i].files == parallelTotals[i].files;
+  }
+  ok &= expectTrue(sameTotals, "extension totals match across thread counts");
+  return ok;
+}
+
 bool testFormatSize() {
   bool ok = true;
   ok &= expectTrue(Utils::formatSize(0) == "0 B", "formatSize(0)");
@@ -183,30 +1326,32 @@ bool testFormatSize() {
 }
 
 bool testBuildFullPath() {
-  auto *root = new TreeNode();
-  root->name = "/";
-  root->isDir = true;
+  TreeNode *root = makeRoot("/");
 
   auto *home = new TreeNode();
   home->name = "home";
   home->isDir = true;
-  home->parent = root;
   root->children = {home};
 
   auto *file = new TreeNode();
   file->name = "test.txt";
   file->isDir = false;
-  file->parent = home;
   home->children = {file};
 
+  TreeModel model;
+  model.setRoot(root);
+  model.computeDerivedSizes();
+
   bool ok = true;
-  ok &= expectTrue(Utils::buildFullPath(root) == "/", "buildFullPath(root)");
-  ok &=
-      expectTrue(Utils::buildFullPath(home) == "/home", "buildFullPath(home)");
-  ok &= expectTrue(Utils::buildFullPath(file) == "/home/test.txt",
+  ok &= expectTrue(Utils::buildFullPath(model, root) == "/",
+                   "buildFullPath(root)");
+  ok &= expectTrue(Utils::buildFullPath(model, home) == "/home",
+                   "buildFullPath(home)");
+  ok &= expectTrue(Utils::buildFullPath(model, file) == "/home/test.txt",
                    "buildFullPath(file)");
-
-  TreeModel::deleteSubtree(root);
+  ok &= expectTrue(Utils::buildFullPath(*NodeTable::build(root), 2) ==
+                       "/home/test.txt",
+                   "buildFullPath(table, row)");
   return ok;
 }
 
@@ -217,8 +1362,26 @@ int main(int argc, char **argv) {
 
   bool ok = true;
   ok &= testTreeLayout();
+  ok &= testTreeLayoutVisit();
+  ok &= testTreeRenderer();
   ok &= testTreeReaderXml();
   ok &= testTreeReaderGzip();
+  ok &= testScanStats();
+  ok &= testTreeExport();
+  ok &= testSearchIndex();
+  ok &= testFilterExpression();
+  ok &= testLargestItems();
+  ok &= testExtensionTotals();
+  ok &= testTreeDiff();
+  ok &= testSnapshotPool();
+  ok &= testScanGenerator();
+  ok &= testFrameStats();
+  ok &= testMemoryReport();
+  ok &= testModelEdit();
+  ok &= testFileRemover();
+  ok &= testDiskCheck();
+  ok &= testTrace();
+  ok &= testTaskScheduler();
   ok &= testFormatSize();
   ok &= testBuildFullPath();
 